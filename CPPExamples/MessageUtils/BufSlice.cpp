@@ -0,0 +1,360 @@
+///
+///   BufSlice.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "BufSlice.h"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+std::atomic<unsigned long> BufSlice::m_Allocs(0);
+std::atomic<unsigned long> BufSlice::m_Copies(0);
+std::atomic<unsigned long long> BufSlice::m_CopyBytes(0);
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Constructors
+//   Description:
+///   \brief Constructor routines
+//   Parameters:
+//   Return:
+//   Notes:
+///   Building from bytes allocates one chunk and copies them in once,
+///   everything else shares an existing chunk
+//----------------------------------------------------------------------------
+///
+
+BufSlice::BufSlice() : m_Chunk(0), m_Offset(0), m_Len(0) {}
+
+BufSlice::BufSlice(const char *ptr, size_t len)
+    : m_Chunk(0), m_Offset(0), m_Len(0) {
+  if (len == 0)
+    return;
+
+  void *mem = malloc(offsetof(Chunk, data) + len);
+  if (!mem)
+    throw std::bad_alloc();
+
+  m_Chunk = (Chunk *)mem;
+  new (&m_Chunk->refs) std::atomic<int>(1);
+  m_Chunk->size = len;
+  memcpy(m_Chunk->data, ptr, len);
+  m_Len = len;
+
+  m_Allocs++;
+  Counted(len);
+}
+
+BufSlice::BufSlice(const BufSlice &val)
+    : m_Chunk(val.m_Chunk), m_Offset(val.m_Offset), m_Len(val.m_Len) {
+  if (m_Chunk)
+    m_Chunk->refs++;
+}
+
+BufSlice::BufSlice(BufSlice &&val) noexcept
+    : m_Chunk(val.m_Chunk), m_Offset(val.m_Offset), m_Len(val.m_Len) {
+  val.m_Chunk = 0;
+  val.m_Offset = 0;
+  val.m_Len = 0;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Destructors
+//   Description:
+///   \brief Destructors routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+BufSlice::~BufSlice() { Release(); }
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Overrides
+//   Description:
+///   \brief Operator overrides routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+// Overloading the = operator
+BufSlice &BufSlice::operator=(const BufSlice &val) {
+  if (this == &val)
+    return *this;
+
+  if (val.m_Chunk)
+    val.m_Chunk->refs++;
+  Release();
+  m_Chunk = val.m_Chunk;
+  m_Offset = val.m_Offset;
+  m_Len = val.m_Len;
+  return *this;
+}
+
+BufSlice &BufSlice::operator=(BufSlice &&val) noexcept {
+  if (this == &val)
+    return *this;
+
+  Release();
+  m_Chunk = val.m_Chunk;
+  m_Offset = val.m_Offset;
+  m_Len = val.m_Len;
+  val.m_Chunk = 0;
+  val.m_Offset = 0;
+  val.m_Len = 0;
+  return *this;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   clear
+//   Description:
+///   \brief Let go of the chunk
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void BufSlice::clear() {
+  Release();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Release
+//   Description:
+///   \brief Drop my reference, freeing the chunk with the last one
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void BufSlice::Release(void) {
+  if (m_Chunk && --m_Chunk->refs == 0) {
+    m_Chunk->refs.~atomic<int>();
+    free(m_Chunk);
+  }
+  m_Chunk = 0;
+  m_Offset = 0;
+  m_Len = 0;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Sub
+//   Description:
+///   \brief Slice of this slice, sharing the chunk
+//   Parameters:
+///   @param size_t pos
+///   @param size_t len - npos for the rest
+//   Return:
+///   @return BufSlice
+//   Notes:
+///   Clamped to this slice, like std::string::substr but without throwing
+//----------------------------------------------------------------------------
+///
+
+BufSlice BufSlice::Sub(size_t pos, size_t len) const {
+  BufSlice slice(*this);
+
+  if (pos > m_Len)
+    pos = m_Len;
+  if (len > m_Len - pos)
+    len = m_Len - pos;
+
+  slice.m_Offset += pos;
+  slice.m_Len = len;
+  return slice;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Find
+//   Description:
+///   \brief Find a string or character in the slice
+//   Parameters:
+///   @param const char *str / char c
+///   @param size_t pos - where to start
+//   Return:
+///   @return size_t - offset in the slice, npos if not found
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+size_t BufSlice::Find(const char *str, size_t pos) const {
+  size_t len = strlen(str);
+  if (len == 0 || pos > m_Len || len > m_Len - pos)
+    return npos;
+
+  const char *base = data();
+  const char *end = base + m_Len - len + 1;
+  for (const char *ptr = base + pos; ptr < end; ptr++) {
+    ptr = (const char *)memchr(ptr, str[0], end - ptr);
+    if (!ptr)
+      break;
+    if (memcmp(ptr, str, len) == 0)
+      return ptr - base;
+  }
+  return npos;
+}
+
+size_t BufSlice::Find(char c, size_t pos) const {
+  if (pos >= m_Len)
+    return npos;
+
+  const char *ptr = (const char *)memchr(data() + pos, c, m_Len - pos);
+  return (ptr) ? ptr - data() : npos;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   StartsWith
+//   Description:
+///   \brief Does the slice start with a string?
+//   Parameters:
+///   @param const char *str
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool BufSlice::StartsWith(const char *str) const {
+  size_t len = strlen(str);
+  return (len <= m_Len && memcmp(data(), str, len) == 0);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   IsToken
+//   Description:
+///   \brief Is the first word of the slice a given one?
+//   Parameters:
+///   @param const char *str
+//   Return:
+///   @return bool
+//   Notes:
+///   For protocol commands and chat commands, "BYE" matches "BYE x\r\n"
+///   and "BYE" but not "BYES"
+//----------------------------------------------------------------------------
+///
+
+bool BufSlice::IsToken(const char *str) const {
+  size_t len = strlen(str);
+  if (!StartsWith(str))
+    return false;
+  return (len == m_Len || isspace((unsigned char)data()[len]));
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Trim
+//   Description:
+///   \brief The slice without leading and trailing white space
+//   Parameters:
+//   Return:
+///   @return BufSlice
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+BufSlice BufSlice::Trim(void) const {
+  const char *ptr = data();
+  size_t start = 0;
+  size_t end = m_Len;
+
+  while (start < end && isspace((unsigned char)ptr[start]))
+    start++;
+  while (end > start && isspace((unsigned char)ptr[end - 1]))
+    end--;
+  return Sub(start, end - start);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   str
+//   Description:
+///   \brief Copy the bytes out, for callers that keep them
+//   Parameters:
+///   @param std::string &out (CopyTo)
+//   Return:
+///   @return std::string
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+std::string BufSlice::str(void) const {
+  Counted(m_Len);
+  return std::string(data(), m_Len);
+}
+
+void BufSlice::CopyTo(std::string &out) const {
+  Counted(m_Len);
+  out.assign(data(), m_Len);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ResetStats
+//   Description:
+///   \brief Zero the allocation and copy counts
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void BufSlice::ResetStats(void) {
+  m_Allocs = 0;
+  m_Copies = 0;
+  m_CopyBytes = 0;
+  return;
+}
+
+void BufSlice::Counted(size_t len) {
+  if (len == 0)
+    return;
+  m_Copies++;
+  m_CopyBytes += len;
+  return;
+}
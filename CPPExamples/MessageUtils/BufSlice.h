@@ -0,0 +1,85 @@
+///
+///   BufSlice.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __bufslice_h_
+#define __bufslice_h_
+
+#include <atomic>
+#include <cstring>
+#include <string>
+
+///
+/// Read only view of part of a reference counted chunk of received data.
+/// Copying a slice, or taking a slice of it, shares the chunk rather than
+/// the bytes, so a frame can go from the receive buffer through parsing
+/// to the chat callback without being copied. The bytes are only copied
+/// (str) when somebody wants to keep them.
+///
+class BufSlice {
+
+public:
+  static const size_t npos = std::string::npos;
+
+  ///
+  /// Public interface
+  ///
+  BufSlice();
+  BufSlice(const char *, size_t);
+  BufSlice(const BufSlice &);
+  BufSlice(BufSlice &&) noexcept;
+  ~BufSlice();
+
+  inline const char *data() const {
+    return (m_Chunk) ? m_Chunk->data + m_Offset : "";
+  }
+  inline size_t size() const { return m_Len; }
+  inline bool empty() const { return (m_Len == 0); }
+  inline int GetRefs() const { return (m_Chunk) ? m_Chunk->refs.load() : 0; }
+
+  BufSlice Sub(size_t, size_t len = npos) const;
+  size_t Find(const char *, size_t pos = 0) const;
+  size_t Find(char, size_t pos = 0) const;
+  bool StartsWith(const char *) const;
+  bool IsToken(const char *) const;
+  BufSlice Trim(void) const;
+
+  std::string str(void) const;
+  void CopyTo(std::string &) const;
+
+  void clear();
+
+  /// Overloading the = operator
+  BufSlice &operator=(const BufSlice &other);
+  BufSlice &operator=(BufSlice &&other) noexcept;
+
+  /// Process wide chunk allocations and bytes copied in and out
+  static unsigned long GetAllocs(void) { return m_Allocs.load(); }
+  static unsigned long GetCopies(void) { return m_Copies.load(); }
+  static unsigned long long GetCopyBytes(void) { return m_CopyBytes.load(); }
+  static void ResetStats(void);
+
+private:
+  struct Chunk {
+    std::atomic<int> refs;
+    size_t size;
+    char data[1];
+  };
+
+  void Release(void);
+  static void Counted(size_t);
+
+  Chunk *m_Chunk;
+  size_t m_Offset;
+  size_t m_Len;
+
+  static std::atomic<unsigned long> m_Allocs;
+  static std::atomic<unsigned long> m_Copies;
+  static std::atomic<unsigned long long> m_CopyBytes;
+};
+
+#endif
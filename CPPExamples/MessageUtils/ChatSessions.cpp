@@ -18,9 +18,9 @@ namespace {
 //   Name:
 ///   DefaultUserCallbackFunc
 //   Description:
-///   \brief Default user callback
+///   \brief Default user callback, and the same on a view
 //   Parameters:
-///   @param std::string &in
+///   @param std::string &in (or const BufSlice &)
 ///   @param std::string &out
 ///   @param int *retCode
 //   Return:
@@ -38,6 +38,15 @@ DefaultUserCallbackFunc(std::string &in, std::string &out, int *retCode) {
   return true;
 }
 
+CHATVIEWCALLBACKFUNC
+DefaultUserViewFunc(const BufSlice &in, std::string &out, int *retCode) {
+  out = "This is a default response for the message '";
+  out.append(in.data(), in.size());
+  out += "'";
+  *retCode = 0;
+  return true;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -46,7 +55,7 @@ DefaultUserCallbackFunc(std::string &in, std::string &out, int *retCode) {
 //   Description:
 ///   \brief Default system callback
 //   Parameters:
-///   @param std::string &in
+///   @param const BufSlice &in
 ///   @param std::string &out
 ///   @param int protocol
 ///   @param void *ptr
@@ -57,7 +66,7 @@ DefaultUserCallbackFunc(std::string &in, std::string &out, int *retCode) {
 ///
 
 CHATCALLBACKSYSFUNC
-SystemCallbackFunc(std::string &in, std::string &out, int *retCode,
+SystemCallbackFunc(const BufSlice &in, std::string &out, int *retCode,
                    int protocol, void *ptr) {
   if (protocol == MSN) {
     MsnChatSessions *chat = (MsnChatSessions *)ptr;
@@ -65,18 +74,17 @@ SystemCallbackFunc(std::string &in, std::string &out, int *retCode,
       return false;
 
     // Only need the first node given...
-    size_t pos1 = in.find(" ");
-    std::string command = StrUtils::SubStr(in, 0, pos1);
-    StrUtils::Trim(command);
-    std::string option = StrUtils::SubStr(in, pos1, in.length());
+    BufSlice command = in.Trim();
 
     /// Process commands
-    if (command == "help") {
+    if (command.IsToken("help")) {
       out = "Supported commands are: getfile, help."
             "\ngetfile - This command will get a file"
             "\nhelp    - This command will produce this message";
       *retCode = 1;
-    } else if (command == "getfile") {
+    } else if (command.IsToken("getfile")) {
+      /// Copied, as the request outlives the message
+      std::string option = command.Sub(strlen("getfile")).Trim().str();
       if (option.empty())
         out = "getfile <fileName> - You must specify a file to process";
       else {
@@ -118,21 +126,9 @@ ChatSessions::ChatSessions(const std::string *hostName, CALLBACKFUNCPTR val) {
   GetNetOps()->SetHostName(hostName);
 }
 
-ChatSessions::ChatSessions(const ChatSessions &val) {
+ChatSessions::ChatSessions(ChatSessions &&val) noexcept {
   init();
-  m_SessionId = val.m_SessionId;
-  m_Net = val.m_Net;
-  m_Thread = val.m_Thread;
-  m_Debug = val.m_Debug;
-  m_DryRun = val.m_DryRun;
-  m_Reply2RemoteChat = val.m_Reply2RemoteChat;
-  m_Started = val.m_Started;
-  m_ErrorStr = val.m_ErrorStr;
-  m_WhoAlias = val.m_WhoAlias;
-  m_Who = val.m_Who;
-  m_WhoAmI = val.m_WhoAmI;
-  m_UserCallback = val.m_UserCallback;
-  m_SystemCallback = val.m_SystemCallback;
+  Take(val);
 }
 
 ///
@@ -159,7 +155,8 @@ bool ChatSessions::operator==(const ChatSessions &val) const {
           !m_WhoAmI.compare(val.m_WhoAmI) &&
           !m_WhoAmIAlias.compare(val.m_WhoAmIAlias) &&
           m_SystemCallback == val.m_SystemCallback &&
-          m_UserCallback == val.m_UserCallback);
+          m_UserCallback == val.m_UserCallback &&
+          m_ViewCallback == val.m_ViewCallback);
 }
 
 /// Overloading the != operator
@@ -168,25 +165,13 @@ bool ChatSessions::operator!=(const ChatSessions &other) const {
 }
 
 /// Overloading the = operator
-ChatSessions &ChatSessions::operator=(const ChatSessions &val) {
+ChatSessions &ChatSessions::operator=(ChatSessions &&val) noexcept {
   if (this == &val)
     return *this;
 
-  m_Net = val.m_Net;
-  m_Thread = val.m_Thread;
-  m_Debug = val.m_Debug;
-  m_DryRun = val.m_DryRun;
-  m_Reply2RemoteChat = val.m_Reply2RemoteChat;
-  m_Started = val.m_Started;
-  m_ErrorStr = val.m_ErrorStr;
-  m_WhoAlias = val.m_WhoAlias;
-  m_Who = val.m_Who;
-  m_WhoAmI = val.m_WhoAmI;
-  m_WhoAmIAlias = val.m_WhoAmIAlias;
-  m_UserCallback = val.m_UserCallback;
-  m_SystemCallback = val.m_SystemCallback;
-  m_SessionId = val.m_SessionId;
-
+  (void)m_Thread.Stop();
+  (void)Disconnect();
+  Take(val);
   return *this;
 }
 
@@ -259,6 +244,46 @@ void ChatSessions::init() {
   m_SessionId = 0;
   SetSystemFunction(SystemCallbackFunc);
   SetFunction(DefaultUserCallbackFunc);
+  SetViewFunction(DefaultUserViewFunc);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Take
+//   Description:
+///   \brief Take over another session's connection, thread and details
+//   Parameters:
+///   @param ChatSessions &val
+//   Return:
+//   Notes:
+///   Neither session may be started. The other session is left with no
+///   connection, thread or transfers.
+//----------------------------------------------------------------------------
+///
+
+void ChatSessions::Take(ChatSessions &val) noexcept {
+  m_Net = std::move(val.m_Net);
+  m_Thread = std::move(val.m_Thread);
+  m_SessionId = val.m_SessionId;
+  m_Debug = val.m_Debug;
+  m_DryRun = val.m_DryRun;
+  m_Reply2RemoteChat = val.m_Reply2RemoteChat;
+  m_Started = val.m_Started;
+  m_ErrorStr.swap(val.m_ErrorStr);
+  m_WhoAlias.swap(val.m_WhoAlias);
+  m_Who.swap(val.m_Who);
+  m_WhoAmI.swap(val.m_WhoAmI);
+  m_WhoAmIAlias.swap(val.m_WhoAmIAlias);
+  m_Transfers.swap(val.m_Transfers);
+  m_UserCallback = val.m_UserCallback;
+  m_ViewCallback = val.m_ViewCallback;
+  m_SystemCallback = val.m_SystemCallback;
+
+  val.m_Started = false;
+  val.m_SessionId = 0;
   return;
 }
 
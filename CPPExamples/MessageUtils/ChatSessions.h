@@ -17,8 +17,13 @@
 
 typedef bool (*CHATCALLBACKFUNCPTR)(std::string &, std::string &, int *);
 typedef bool CHATCALLBACKFUNC;
-typedef bool (*CHATCALLBACKSYSFUNCPTR)(std::string &, std::string &, int *, int,
-                                       void *);
+/// As CHATCALLBACKFUNCPTR, but handed a view of the received text, which
+/// is only valid for the call - copy it (str) to keep it
+typedef bool (*CHATVIEWCALLBACKFUNCPTR)(const BufSlice &, std::string &,
+                                        int *);
+typedef bool CHATVIEWCALLBACKFUNC;
+typedef bool (*CHATCALLBACKSYSFUNCPTR)(const BufSlice &, std::string &, int *,
+                                       int, void *);
 typedef bool CHATCALLBACKSYSFUNC;
 
 #define MSN -1
@@ -31,9 +36,17 @@ public:
   ChatSessions();
   ChatSessions(const std::string *);
   ChatSessions(const std::string *, CALLBACKFUNCPTR val);
-  ChatSessions(const ChatSessions &val);
+  ChatSessions(ChatSessions &&val) noexcept;
   virtual ~ChatSessions();
 
+  ///
+  /// Move only - the session owns its connection and thread. A session
+  /// may only be moved before it is started, as its thread and any event
+  /// loop registration point back at it.
+  ///
+  ChatSessions(const ChatSessions &) = delete;
+  ChatSessions &operator=(const ChatSessions &) = delete;
+
   inline bool const IsDebug() { return m_Debug; }
   inline NetworkOps *GetNetOps() { return &m_Net; }
   inline Threads *GetThread() { return &m_Thread; }
@@ -51,7 +64,16 @@ public:
   inline void SetWho(const std::string *val) { m_Who = *val; }
   inline void SetWho(const char *val) { m_Who = val; }
   inline const CHATCALLBACKFUNCPTR GetFunction() { return m_UserCallback; }
-  inline void SetFunction(CHATCALLBACKFUNCPTR val) { m_UserCallback = val; }
+  inline void SetFunction(CHATCALLBACKFUNCPTR val) {
+    m_UserCallback = val;
+    m_ViewCallback = 0;
+  }
+  inline const CHATVIEWCALLBACKFUNCPTR GetViewFunction() {
+    return m_ViewCallback;
+  }
+  inline void SetViewFunction(CHATVIEWCALLBACKFUNCPTR val) {
+    m_ViewCallback = val;
+  }
   inline const CHATCALLBACKSYSFUNCPTR GetSystemFunction() {
     return m_SystemCallback;
   }
@@ -99,7 +121,7 @@ public:
   bool operator!=(const ChatSessions &other) const;
 
   /// Overloading the = operator
-  ChatSessions &operator=(const ChatSessions &other);
+  ChatSessions &operator=(ChatSessions &&other) noexcept;
 
   /// Overloading the > operator
   bool operator>(const ChatSessions &other) const;
@@ -113,6 +135,7 @@ protected:
   ///
   virtual void init();
   virtual void clear();
+  void Take(ChatSessions &) noexcept;
 
   NetworkOps m_Net;
   Threads m_Thread;
@@ -132,6 +155,7 @@ protected:
   FileTransferRequests m_Transfers;
 
   CHATCALLBACKFUNCPTR m_UserCallback;
+  CHATVIEWCALLBACKFUNCPTR m_ViewCallback;
   CHATCALLBACKSYSFUNCPTR m_SystemCallback;
 
 private:
@@ -0,0 +1,375 @@
+///
+///   DnsCache.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "DnsCache.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+
+std::map<std::string, DnsCache::DnsEntry> DnsCache::m_Entries;
+Mutex DnsCache::m_Mutex;
+int DnsCache::m_Ttl = DNSCACHETTL;
+int DnsCache::m_NegativeTtl = DNSNEGATIVETTL;
+unsigned long DnsCache::m_Hits = 0;
+unsigned long DnsCache::m_Misses = 0;
+long long DnsCache::m_LookupMs = 0;
+Threads *DnsCache::m_Prefetcher = 0;
+int DnsCache::m_PrefetchPipe[2] = {-1, -1};
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Lookup
+//   Description:
+///   \brief Resolve a host and service, from the cache where possible
+//   Parameters:
+///   @param const std::string &host
+///   @param const std::string &service - port number or service name
+///   @param std::vector<DnsAddr> &addrs - resolver order, port filled in
+//   Return:
+///   @return int - 0 or a getaddrinfo error code (see gai_strerror)
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int DnsCache::Lookup(const std::string &host, const std::string &service,
+                     std::vector<DnsAddr> &addrs) {
+  int errCode = 0;
+
+  addrs.clear();
+  m_Mutex.Lock();
+  std::map<std::string, DnsEntry>::iterator it = m_Entries.find(host);
+  if (it != m_Entries.end() && it->second.expires > NetworkOps::GetTimeMs()) {
+    m_Hits++;
+    errCode = it->second.errCode;
+    addrs = it->second.addrs;
+    m_Mutex.Unlock();
+  } else {
+    m_Mutex.Unlock();
+    errCode = Refresh(host, addrs);
+  }
+
+  if (errCode == 0 && !SetPort(service, addrs))
+    errCode = EAI_SERVICE;
+  return errCode;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Refresh
+//   Description:
+///   \brief Ask the resolver about a host and cache the answer
+//   Parameters:
+///   @param const std::string &host
+///   @param std::vector<DnsAddr> &addrs
+//   Return:
+///   @return int - 0 or a getaddrinfo error code
+//   Notes:
+///   Name errors (EAI_NONAME, or an empty answer) are cached for the
+///   negative TTL. Anything else, transient resolver failures included,
+///   is not cached at all.
+//----------------------------------------------------------------------------
+///
+
+int DnsCache::Refresh(const std::string &host, std::vector<DnsAddr> &addrs) {
+  struct addrinfo hints;
+  struct addrinfo *res = 0;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+
+  long long start = NetworkOps::GetTimeMs();
+  int errCode = getaddrinfo(host.c_str(), 0, &hints, &res);
+  long long elapsed = NetworkOps::GetTimeMs() - start;
+
+  DnsEntry entry;
+  entry.errCode = errCode;
+  for (struct addrinfo *ai = res; errCode == 0 && ai != 0; ai = ai->ai_next) {
+    DnsAddr dnsAddr;
+    memset(&dnsAddr, 0, sizeof(dnsAddr));
+    memcpy(&dnsAddr.addr, ai->ai_addr, ai->ai_addrlen);
+    dnsAddr.len = (socklen_t)ai->ai_addrlen;
+    entry.addrs.push_back(dnsAddr);
+  }
+  if (res)
+    freeaddrinfo(res);
+  if (errCode == 0 && entry.addrs.empty())
+    entry.errCode = errCode = EAI_NONAME;
+
+  /// A resolver that is down or slow (EAI_AGAIN, EAI_FAIL) says nothing
+  /// about the name, so the next connect asks again
+  bool bCache = (errCode == 0 || errCode == EAI_NONAME);
+
+  m_Mutex.Lock();
+  m_Misses++;
+  m_LookupMs += elapsed;
+  if (bCache) {
+    long long now = NetworkOps::GetTimeMs();
+    if (m_Entries.size() >= DNSCACHEMAX) {
+      std::map<std::string, DnsEntry>::iterator it = m_Entries.begin();
+      while (it != m_Entries.end()) {
+        if (it->second.expires <= now)
+          m_Entries.erase(it++);
+        else
+          ++it;
+      }
+      if (m_Entries.size() >= DNSCACHEMAX)
+        m_Entries.clear();
+    }
+    entry.expires = now + ((errCode == 0) ? m_Ttl : m_NegativeTtl);
+    m_Entries[host] = entry;
+  }
+  m_Mutex.Unlock();
+
+  addrs = entry.addrs;
+  return errCode;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SetPort
+//   Description:
+///   \brief Fill in the port for a service on a set of addresses
+//   Parameters:
+///   @param const std::string &service - empty leaves the port at 0
+///   @param std::vector<DnsAddr> &addrs
+//   Return:
+///   @return bool - false if the service name is unknown
+//   Notes:
+///   Service names are looked up locally, this never goes to the network
+//----------------------------------------------------------------------------
+///
+
+bool DnsCache::SetPort(const std::string &service,
+                       std::vector<DnsAddr> &addrs) {
+  unsigned short port = 0;
+
+  if (!service.empty()) {
+    char *end = 0;
+    long portNo = strtol(service.c_str(), &end, 10);
+    if (*end == '\0' && portNo > 0 && portNo < 65536)
+      port = htons((unsigned short)portNo);
+    else {
+      struct addrinfo hints;
+      struct addrinfo *res = 0;
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_STREAM;
+      hints.ai_flags = AI_PASSIVE;
+      if (getaddrinfo(0, service.c_str(), &hints, &res) != 0 || res == 0)
+        return false;
+      port = ((struct sockaddr_in *)res->ai_addr)->sin_port;
+      freeaddrinfo(res);
+    }
+  }
+
+  for (size_t i = 0; i < addrs.size(); i++) {
+    if (addrs[i].addr.ss_family == AF_INET)
+      ((struct sockaddr_in *)&addrs[i].addr)->sin_port = port;
+    else if (addrs[i].addr.ss_family == AF_INET6)
+      ((struct sockaddr_in6 *)&addrs[i].addr)->sin6_port = port;
+  }
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Prefetch
+//   Description:
+///   \brief Resolve a host in the background ahead of connecting to it
+//   Parameters:
+///   @param const std::string &host - a "host:port" form is accepted
+//   Return:
+//   Notes:
+///   Fresh entries and address literals are skipped. Windows has no
+///   worker, so there hosts are resolved at connect time as before.
+//----------------------------------------------------------------------------
+///
+
+void DnsCache::Prefetch(const std::string &host) {
+#ifndef _WIN32
+  std::string hostName = host;
+  if (hostName.empty() || hostName[0] == '[')
+    return;
+  size_t colon = hostName.find(':');
+  if (colon != std::string::npos &&
+      hostName.find(':', colon + 1) == std::string::npos)
+    hostName = hostName.substr(0, colon);
+
+  struct in6_addr literal;
+  if (hostName.empty() || hostName.length() >= 256 ||
+      inet_pton(AF_INET, hostName.c_str(), &literal) == 1 ||
+      inet_pton(AF_INET6, hostName.c_str(), &literal) == 1)
+    return;
+
+  m_Mutex.Lock();
+  std::map<std::string, DnsEntry>::iterator it = m_Entries.find(hostName);
+  if (it != m_Entries.end() && it->second.expires > NetworkOps::GetTimeMs()) {
+    m_Mutex.Unlock();
+    return;
+  }
+
+  if (!m_Prefetcher && pipe(m_PrefetchPipe) == 0) {
+    int options = fcntl(m_PrefetchPipe[1], F_GETFL, 0);
+    (void)fcntl(m_PrefetchPipe[1], F_SETFL, options | O_NONBLOCK);
+    (void)fcntl(m_PrefetchPipe[0], F_SETFD, FD_CLOEXEC);
+    (void)fcntl(m_PrefetchPipe[1], F_SETFD, FD_CLOEXEC);
+
+    // Lives as long as the process, deleting a running Threads cancels it
+    m_Prefetcher = new Threads(PrefetchThread, 0);
+    if (m_Prefetcher->Start() != 0) {
+      (void)close(m_PrefetchPipe[0]);
+      (void)close(m_PrefetchPipe[1]);
+      m_PrefetchPipe[0] = m_PrefetchPipe[1] = -1;
+    }
+  }
+  int writeId = m_PrefetchPipe[1];
+  m_Mutex.Unlock();
+
+  // A full pipe just drops the hint
+  if (writeId != -1) {
+    std::string line = hostName + "\n";
+    (void)write(writeId, line.c_str(), line.length());
+  }
+#endif
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   PrefetchThread
+//   Description:
+///   \brief Resolve hosts as they are posted by Prefetch
+//   Parameters:
+///   @param void *param - unused
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+CALLBACKFUNC DnsCache::PrefetchThread(void *param) {
+#ifndef _WIN32
+  std::string pending;
+  char buffer[DBLOCK];
+
+  for (;;) {
+    ssize_t num_read = read(m_PrefetchPipe[0], buffer, sizeof(buffer));
+    if (num_read < 0 && errNo == EINTR)
+      continue;
+    if (num_read <= 0)
+      break;
+
+    pending.append(buffer, num_read);
+    size_t eol = 0;
+    while ((eol = pending.find('\n')) != std::string::npos) {
+      std::string hostName = pending.substr(0, eol);
+      pending.erase(0, eol + 1);
+
+      std::vector<DnsAddr> addrs;
+      (void)Refresh(hostName, addrs);
+    }
+  }
+#endif
+  return 0;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Flush
+//   Description:
+///   \brief Forget every cached answer
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void DnsCache::Flush(void) {
+  m_Mutex.Lock();
+  m_Entries.clear();
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SetTtl
+//   Description:
+///   \brief Set how long answers are kept
+//   Parameters:
+///   @param int ttl - successful lookups (ms)
+///   @param int negativeTtl - names that do not exist (ms), 0 disables
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void DnsCache::SetTtl(int ttl, int negativeTtl) {
+  m_Mutex.Lock();
+  m_Ttl = ttl;
+  m_NegativeTtl = negativeTtl;
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Counters
+//   Description:
+///   \brief Cache statistics
+//   Parameters:
+//   Return:
+//   Notes:
+///   Saved time assumes each hit would have cost an average lookup
+//----------------------------------------------------------------------------
+///
+
+unsigned long DnsCache::GetHits(void) {
+  m_Mutex.Lock();
+  unsigned long hits = m_Hits;
+  m_Mutex.Unlock();
+  return hits;
+}
+
+unsigned long DnsCache::GetMisses(void) {
+  m_Mutex.Lock();
+  unsigned long misses = m_Misses;
+  m_Mutex.Unlock();
+  return misses;
+}
+
+long long DnsCache::GetLookupMs(void) {
+  m_Mutex.Lock();
+  long long lookupMs = m_LookupMs;
+  m_Mutex.Unlock();
+  return lookupMs;
+}
+
+long long DnsCache::GetSavedMs(void) {
+  m_Mutex.Lock();
+  long long saved = (m_Misses > 0) ? (m_LookupMs * m_Hits) / m_Misses : 0;
+  m_Mutex.Unlock();
+  return saved;
+}
@@ -0,0 +1,78 @@
+///
+///   DnsCache.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __dnscache_h_
+#define __dnscache_h_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Mutex.h"
+#include "NetworkOps.h"
+#include "Threads.h"
+
+/// How long answers are kept (ms) - getaddrinfo gives no record TTL, so
+/// successful lookups use a fixed one and names that do not exist a much
+/// shorter one
+#define DNSCACHETTL 300000
+#define DNSNEGATIVETTL 30000
+
+/// Most hosts held before expired entries are swept out
+#define DNSCACHEMAX 256
+
+///
+/// Process wide resolver cache shared by every connection. Keyed by host
+/// name, so all services on a host share the one lookup. The resolver is
+/// never called with the cache lock held.
+///
+class DnsCache {
+
+public:
+  ///
+  /// Public interface
+  ///
+  static int Lookup(const std::string &, const std::string &,
+                    std::vector<DnsAddr> &);
+  static void Prefetch(const std::string &);
+  static void Flush(void);
+
+  static void SetTtl(int, int);
+
+  /// Counters - lookups answered from the cache, sent to the resolver,
+  /// total time spent resolving and an estimate of the time hits saved
+  static unsigned long GetHits(void);
+  static unsigned long GetMisses(void);
+  static long long GetLookupMs(void);
+  static long long GetSavedMs(void);
+
+private:
+  struct DnsEntry {
+    std::vector<DnsAddr> addrs;
+    long long expires;
+    int errCode;
+  };
+
+  static int Refresh(const std::string &, std::vector<DnsAddr> &);
+  static bool SetPort(const std::string &, std::vector<DnsAddr> &);
+  static CALLBACKFUNC PrefetchThread(void *);
+
+  static std::map<std::string, DnsEntry> m_Entries;
+  static Mutex m_Mutex;
+  static int m_Ttl;
+  static int m_NegativeTtl;
+  static unsigned long m_Hits;
+  static unsigned long m_Misses;
+  static long long m_LookupMs;
+
+  /// Prefetch worker, fed host names one per line through a pipe
+  static Threads *m_Prefetcher;
+  static int m_PrefetchPipe[2];
+};
+
+#endif
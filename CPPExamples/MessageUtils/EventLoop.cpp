@@ -0,0 +1,1579 @@
+///
+///   EventLoop.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "EventLoop.h"
+#include "UtilityFuncs.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+
+#ifndef _WIN32
+#include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#endif
+
+namespace {
+/// How often idle registrations are checked for timeouts (ms)
+#define EVENTIDLESCAN 250
+
+/// Maximum number of events collected per wakeup
+#define EVENTBATCH 64
+
+/// How often the event rate is checked to turn busy polling on or off (ms)
+#define EVENTSPINWINDOW 1000
+
+/// How long Remove waits for a send the loop has in flight (ms)
+#define EVENTREMOVEWAIT 1000
+
+/// io_uring user data - socket number, registration generation and the
+/// request's kind in the top two bits. The wakeup pipe is the only poll
+/// with generation 0.
+#define EVENTGENMASK 0x3fffffff
+#define EVENTOPPOLL 0
+#define EVENTOPRECV 1
+#define EVENTOPSEND 2
+
+static unsigned long long UringKey(int sockId, unsigned gen,
+                                   unsigned op = EVENTOPPOLL) {
+  return ((unsigned long long)((op << 30) | gen) << 32) | (unsigned)sockId;
+}
+
+/// A multishot receive can complete several times in one wait, so merge
+/// the events of a connection already in the batch
+static void AddReady(std::vector<std::pair<int, int> > &ready, int sockId,
+                     int events) {
+  for (size_t i = 0; i < ready.size(); i++) {
+    if (ready[i].first == sockId) {
+      ready[i].second |= events;
+      return;
+    }
+  }
+  ready.push_back(std::make_pair(sockId, events));
+  return;
+}
+
+/// Spinning only pays when the sender has another CPU to run on, with one
+/// the spinner just delays it. 0 means unknown, so allow it.
+static bool SpareCpu(void) {
+  static const unsigned cpus = std::thread::hardware_concurrency();
+  return (cpus != 1);
+}
+
+static THREADTYPE SelfId(void) {
+#ifndef _WIN32
+  return pthread_self();
+#else
+  return GetCurrentThreadId();
+#endif
+}
+
+} // namespace
+
+///
+/// A gather send the loop has in flight for a connection. It owns the
+/// buffers and the message header, so the kernel never reads memory the
+/// connection has let go of, and it outlives its entry if need be.
+///
+struct EventLoop::SendBatch {
+  std::deque<std::string> m_Bufs;
+  size_t m_Offset;
+  size_t m_Bytes;
+#ifndef _WIN32
+  struct iovec m_Vec[SENDMAXVEC];
+  struct msghdr m_Msg;
+#endif
+};
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Constructors
+//   Description:
+///   \brief Constructor routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+EventLoop::EventLoop() {
+  m_PollId = -1;
+  m_WakeId[0] = -1;
+  m_WakeId[1] = -1;
+  m_Backend = EVENTBACKENDEPOLL;
+  m_SpinUs = 0;
+  m_SpinRate = EVENTSPINRATE;
+  init();
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Destructors
+//   Description:
+///   \brief Destructors routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+EventLoop::~EventLoop() { clear(); }
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   clear
+//   Description:
+///   \brief clear the class
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::clear() {
+  (void)Stop();
+
+  m_Mutex.Lock();
+  for (std::map<int, EventEntry *>::iterator it = m_Entries.begin();
+       it != m_Entries.end(); ++it)
+    delete it->second;
+  m_Entries.clear();
+  m_Mutex.Unlock();
+
+#ifndef _WIN32
+  m_Uring.Close();
+  m_Mutex.Lock();
+  for (std::map<unsigned long long, SendBatch *>::iterator it = m_Sends.begin();
+       it != m_Sends.end(); ++it)
+    delete it->second;
+  m_Sends.clear();
+  m_Mutex.Unlock();
+  if (m_PollId != -1)
+    (void)close(m_PollId);
+  if (m_WakeId[0] != -1)
+    (void)close(m_WakeId[0]);
+  if (m_WakeId[1] != -1)
+    (void)close(m_WakeId[1]);
+#endif
+  m_PollId = -1;
+  m_WakeId[0] = -1;
+  m_WakeId[1] = -1;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   init
+//   Description:
+///   \brief init the class
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::init() {
+  m_Active = 0;
+  m_NextScan = 0;
+  m_NextGen = 1;
+  m_PollerCalls = 0;
+  m_Dispatched = 0;
+  m_Spinning = false;
+  m_WindowStart = 0;
+  m_WindowEvents = 0;
+  m_SpinTime = 0;
+  m_SleepTime = 0;
+  m_SpinHits = 0;
+  m_SpinMisses = 0;
+  m_SpinSwitches = 0;
+  m_Running = false;
+  m_Debug = false;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Start
+//   Description:
+///   \brief Create the poller and start a fixed set of dispatcher threads
+//   Parameters:
+///   @param int threads
+//   Return:
+///   @return bool
+//   Notes:
+///   If io_uring was asked for but cannot be set up the loop runs on epoll,
+///   GetBackend says which one is in use. Without provided buffers (before
+///   5.19) io_uring runs, but loop owned I/O is not offered.
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::Start(int threads) {
+#ifdef _WIN32
+  SetError("- Event loop is not supported on this platform");
+  return false;
+#else
+  if (IsRunning())
+    return true;
+
+  if (threads < 1)
+    threads = 1;
+
+  if (m_WakeId[0] == -1) {
+    if (pipe(m_WakeId) < 0) {
+      SetError("- Unable to create the event loop wakeup pipe");
+      return false;
+    }
+    for (int i = 0; i < 2; i++) {
+      int options = fcntl(m_WakeId[i], F_GETFL, 0);
+      (void)fcntl(m_WakeId[i], F_SETFL, options | O_NONBLOCK);
+      (void)fcntl(m_WakeId[i], F_SETFD, FD_CLOEXEC);
+    }
+  }
+
+#ifdef __linux__
+  if (m_Backend == EVENTBACKENDURING && !m_Uring.IsOpen()) {
+    if (!m_Uring.Open() ||
+        !m_Uring.PollAdd(m_WakeId[0], POLLIN, UringKey(m_WakeId[0], 0), true)) {
+      m_Uring.Close();
+      m_Backend = EVENTBACKENDEPOLL;
+      if (IsDebug())
+        (void)DebugUtils::LogMessage(
+            MSGINFO, "Debug: [%s,%d] io_uring is not available, using epoll",
+            __FILE__, __LINE__);
+    } else if (!m_Uring.OpenRecvBuffers() && IsDebug())
+      (void)DebugUtils::LogMessage(
+          MSGINFO,
+          "Debug: [%s,%d] io_uring can't provide buffers, loop owned I/O "
+          "is off",
+          __FILE__, __LINE__);
+  }
+
+  if (m_Backend == EVENTBACKENDEPOLL && m_PollId == -1) {
+    if ((m_PollId = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+      SetError("- Unable to create the epoll instance");
+      return false;
+    }
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_WakeId[0];
+    (void)epoll_ctl(m_PollId, EPOLL_CTL_ADD, m_WakeId[0], &ev);
+  }
+#else
+  m_Backend = EVENTBACKENDEPOLL;
+#endif
+
+  m_Running = true;
+
+  for (int i = 0; i < threads; i++) {
+    Threads *thread = new Threads(DispatchThread, (void *)this);
+    thread->SetAttribute(PTHREAD_CREATE_DETACHED);
+    if (thread->Start() != 0) {
+      delete thread;
+      break;
+    }
+    m_Mutex.Lock();
+    m_Active++;
+    m_Mutex.Unlock();
+    m_Threads.push_back(thread);
+  }
+
+  if (m_Threads.empty()) {
+    m_Running = false;
+    SetError("- Unable to start any event loop threads");
+    return false;
+  }
+
+  if (IsDebug())
+    (void)DebugUtils::LogMessage(
+        MSGINFO, "Debug: [%s,%d] Event loop started with %d threads on %s",
+        __FILE__, __LINE__, GetThreadCount(),
+        (GetBackend() == EVENTBACKENDURING) ? "io_uring" : "epoll");
+  return true;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Stop
+//   Description:
+///   \brief Stop the dispatcher threads and wait for them to finish
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   Registrations are kept, so the loop can be restarted later
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::Stop(void) {
+  if (!IsRunning())
+    return true;
+
+  m_Running = false;
+  if (IsDebug())
+    ReportSpin();
+
+  ///
+  /// The dispatcher threads are detached, so wait for them to drop out of
+  /// RunOnce rather than joining them. A dispatcher must never stop its
+  /// own loop.
+  ///
+  for (;;) {
+    Wakeup();
+    m_Mutex.Lock();
+    int active = m_Active;
+    m_Mutex.Unlock();
+    if (active <= 0)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  ///
+  /// The threads have exited, so reset them first - deleting a started
+  /// Threads object cancels it.
+  ///
+  for (std::vector<Threads *>::iterator it = m_Threads.begin();
+       it != m_Threads.end(); ++it) {
+    (*it)->clear();
+    (*it)->init();
+    delete *it;
+  }
+  m_Threads.clear();
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   DispatchThread
+//   Description:
+///   \brief Dispatcher thread body - runs the loop until it is stopped
+//   Parameters:
+///   @param void *ptrClass
+//   Return:
+///   @return CALLBACKFUNC
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+CALLBACKFUNC EventLoop::DispatchThread(void *ptrClass) {
+  EventLoop *loop = (EventLoop *)ptrClass;
+  if (loop) {
+    while (loop->IsRunning()) {
+      if (loop->RunOnce(1000) < 0)
+        break;
+    }
+    loop->m_Mutex.Lock();
+    loop->m_Active--;
+    loop->m_Mutex.Unlock();
+  }
+  return 0;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Wakeup
+//   Description:
+///   \brief Kick any dispatcher sitting in a wait
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::Wakeup(void) {
+#ifndef _WIN32
+  if (m_WakeId[1] != -1) {
+    char c = 0;
+    (void)write(m_WakeId[1], &c, 1);
+  }
+#endif
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Arm
+//   Description:
+///   \brief (Re)register interest for an entry with the poller
+//   Parameters:
+///   @param EventEntry *entry
+///   @param bool bNew - first registration
+///   @param bool bDefer - io_uring only, leave the poll to go in with the
+///   calling dispatcher's next wait
+//   Return:
+///   @return bool
+//   Notes:
+///   Must be called with m_Mutex held. Entries are armed edge triggered and
+///   one-shot so a connection is only ever serviced by one thread at a time.
+///   io_uring polls are one-shot too, but check readiness when they are
+///   submitted, so an entry is only ever given one outstanding poll. Loop
+///   owned I/O needs no poll, just its multishot receive kept going.
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::Arm(EventEntry *entry, bool bNew, bool bDefer) {
+#ifdef __linux__
+  if (m_Uring.IsOpen() && entry->m_LoopIO) {
+    if (entry->m_Receiving)
+      return true;
+    if (!m_Uring.RecvMulti(entry->m_SockId,
+                           UringKey(entry->m_SockId, entry->m_Gen, EVENTOPRECV),
+                           !bDefer))
+      return false;
+    entry->m_Receiving = true;
+    return true;
+  }
+
+  if (m_Uring.IsOpen()) {
+    unsigned mask = POLLRDHUP;
+    if (entry->m_Events & EVENTREAD)
+      mask |= POLLIN;
+    if ((entry->m_Events & EVENTWRITE) || entry->m_Ops->WantsWrite())
+      mask |= POLLOUT;
+
+    if (entry->m_Armed) {
+      if (mask == entry->m_ArmedMask)
+        return true;
+      (void)m_Uring.PollRemove(UringKey(entry->m_SockId, entry->m_Gen));
+      entry->m_Armed = false;
+      entry->m_Gen = NewGen();
+    }
+    if (!m_Uring.PollAdd(entry->m_SockId, mask,
+                         UringKey(entry->m_SockId, entry->m_Gen), !bDefer))
+      return false;
+    entry->m_Armed = true;
+    entry->m_ArmedMask = mask;
+    return true;
+  }
+
+  struct epoll_event ev = {0};
+  ev.events = EPOLLET | EPOLLONESHOT | EPOLLRDHUP;
+  if (entry->m_Events & EVENTREAD)
+    ev.events |= EPOLLIN;
+  /// Queued output is resumed as soon as the socket drains, as is a TLS
+  /// read that has to send first
+  if ((entry->m_Events & EVENTWRITE) || entry->m_Ops->WantsWrite())
+    ev.events |= EPOLLOUT;
+  ev.data.fd = entry->m_SockId;
+
+  m_PollerCalls++;
+  if (epoll_ctl(m_PollId, (bNew) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD,
+                entry->m_SockId, &ev) < 0)
+    return false;
+#else
+  /// The poll() fallback rebuilds its set on every pass
+  (void)bNew;
+  (void)bDefer;
+  Wakeup();
+#endif
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Disarm
+//   Description:
+///   \brief Take an entry out of the poller
+//   Parameters:
+///   @param EventEntry *entry
+//   Return:
+//   Notes:
+///   Must be called with m_Mutex held. A send in flight is left to finish,
+///   its batch goes when it completes.
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::Disarm(EventEntry *entry) {
+#ifdef __linux__
+  if (m_Uring.IsOpen()) {
+    if (entry->m_Armed)
+      (void)m_Uring.PollRemove(UringKey(entry->m_SockId, entry->m_Gen), true);
+    entry->m_Armed = false;
+    if (entry->m_Receiving)
+      (void)m_Uring.Cancel(
+          UringKey(entry->m_SockId, entry->m_Gen, EVENTOPRECV), true);
+    entry->m_Receiving = false;
+  } else {
+    m_PollerCalls++;
+    (void)epoll_ctl(m_PollId, EPOLL_CTL_DEL, entry->m_SockId, NULL);
+  }
+#else
+  (void)entry;
+#endif
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Add
+//   Description:
+///   \brief Hand a connection over to the event loop
+//   Parameters:
+///   @param NetworkOps *ops - connection to watch
+///   @param EVENTCALLBACKFUNCPTR func - callback for events
+///   @param void *param - callback parameter
+///   @param int events - EVENTREAD and/or EVENTWRITE, and EVENTLOOPIO
+///   @param int idleMs - if non zero, call back with EVENTTIMEOUT when the
+///   connection has been quiet for this long
+//   Return:
+///   @return bool
+//   Notes:
+///   With EVENTLOOPIO on io_uring, the loop keeps a multishot receive
+///   going and stages the data for the connection's reads, so the
+///   callback finds it waiting. Messages it queues are sent by the loop,
+///   in one batch with every other callback's at the next wait, and
+///   EVENTWRITE is reported as each send finishes. Other threads may
+///   still read and write the connection. Not for TLS or connections
+///   taking receive timestamps, nor on epoll - those are polled as usual.
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::Add(NetworkOps *ops, EVENTCALLBACKFUNCPTR func, void *param,
+                    int events, int idleMs) {
+  if (ops == NULL || func == NULL || !ops->IsConnected()) {
+    SetError("- Invalid connection passed to the event loop");
+    return false;
+  }
+
+#ifdef __linux__
+  if (m_PollId == -1 && !m_Uring.IsOpen()) {
+    SetError("- The event loop has not been started");
+    return false;
+  }
+#endif
+
+  /// Delivery has to be on before the first receive can complete
+  bool bLoopIO = ((events & EVENTLOOPIO) && m_Uring.HasRecvBuffers() &&
+                  ops->StartDelivery(SubmitSend, (void *)this));
+  events &= ~EVENTLOOPIO;
+
+  EventEntry *entry = new EventEntry;
+  entry->m_Ops = ops;
+  entry->m_Callback = func;
+  entry->m_Param = param;
+  entry->m_SockId = ops->GetSockId();
+  entry->m_Events = events;
+  entry->m_IdleMs = idleMs;
+  entry->m_LastEvent = NetworkOps::GetTimeMs();
+  entry->m_Busy = false;
+  entry->m_Removed = false;
+  entry->m_Owner = 0;
+  entry->m_Armed = false;
+  entry->m_ArmedMask = 0;
+  entry->m_LoopIO = bLoopIO;
+  entry->m_Receiving = false;
+  entry->m_Sending = false;
+  entry->m_Pending = 0;
+
+  m_Mutex.Lock();
+  entry->m_Gen = NewGen();
+
+  /// A socket number can be reused once its previous owner closed it
+  std::map<int, EventEntry *>::iterator it = m_Entries.find(entry->m_SockId);
+  if (it != m_Entries.end()) {
+    EventEntry *stale = it->second;
+    m_Entries.erase(it);
+    Disarm(stale);
+    if (stale->m_Busy)
+      stale->m_Removed = true;
+    else
+      delete stale;
+  }
+
+  m_Entries[entry->m_SockId] = entry;
+  bool bRet = Arm(entry, true);
+  if (!bRet) {
+    m_Entries.erase(entry->m_SockId);
+    delete entry;
+    SetError("- Unable to register the connection with the event loop");
+  }
+  m_Mutex.Unlock();
+
+  if (!bRet && bLoopIO)
+    ops->StopDelivery();
+  return bRet;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Modify
+//   Description:
+///   \brief Change the events a connection is interested in
+//   Parameters:
+///   @param NetworkOps *ops
+///   @param int events
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::Modify(NetworkOps *ops, int events) {
+  bool bRet = false;
+
+  m_Mutex.Lock();
+  std::map<int, EventEntry *>::iterator it = m_Entries.find(ops->GetSockId());
+  if (it != m_Entries.end() && it->second->m_Ops == ops) {
+    EventEntry *entry = it->second;
+    entry->m_Events = events;
+    /// A busy entry is re-armed by its dispatcher when the callback returns
+    bRet = (entry->m_Busy) ? true : Arm(entry, false);
+  }
+  m_Mutex.Unlock();
+  return bRet;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Remove
+//   Description:
+///   \brief Take a connection away from the event loop
+//   Parameters:
+///   @param NetworkOps *ops
+//   Return:
+///   @return bool
+//   Notes:
+///   If another thread is in a callback for this connection, wait for it to
+///   return so the caller can safely delete the session afterwards. With
+///   loop owned I/O, a send in flight is given EVENTREMOVEWAIT to finish
+///   so nothing written directly afterwards can overtake it.
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::Remove(NetworkOps *ops) {
+  bool bRet = false;
+  bool bLoopIO = false;
+  long long sendDeadline = 0;
+
+  m_Mutex.Lock();
+  for (;;) {
+    EventEntry *entry = 0;
+    for (std::map<int, EventEntry *>::iterator it = m_Entries.begin();
+         it != m_Entries.end(); ++it) {
+      if (it->second->m_Ops == ops) {
+        entry = it->second;
+        break;
+      }
+    }
+    if (entry == 0)
+      break;
+
+    if (entry->m_Busy && entry->m_Owner != SelfId()) {
+      m_Mutex.Unlock();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      m_Mutex.Lock();
+      continue;
+    }
+
+    if (entry->m_Sending && !entry->m_Busy && IsRunning()) {
+      if (sendDeadline == 0)
+        sendDeadline = NetworkOps::GetTimeMs() + EVENTREMOVEWAIT;
+      if (NetworkOps::GetTimeMs() < sendDeadline) {
+        m_Mutex.Unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        m_Mutex.Lock();
+        continue;
+      }
+    }
+
+    m_Entries.erase(entry->m_SockId);
+    Disarm(entry);
+    bLoopIO = entry->m_LoopIO;
+    if (entry->m_Busy)
+      entry->m_Removed = true;
+    else
+      delete entry;
+    bRet = true;
+    break;
+  }
+  m_Mutex.Unlock();
+
+  if (bLoopIO)
+    ops->StopDelivery();
+  return bRet;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   DropEntry
+//   Description:
+///   \brief Unregister and free an entry whose callback asked to be dropped
+//   Parameters:
+///   @param EventEntry *entry
+//   Return:
+//   Notes:
+///   Must be called with m_Mutex held
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::DropEntry(EventEntry *entry) {
+  std::map<int, EventEntry *>::iterator it = m_Entries.find(entry->m_SockId);
+  if (it != m_Entries.end() && it->second == entry) {
+    m_Entries.erase(it);
+    Disarm(entry);
+  }
+  delete entry;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   NewGen
+//   Description:
+///   \brief Next registration generation, never 0
+//   Parameters:
+//   Return:
+///   @return unsigned
+//   Notes:
+///   Must be called with m_Mutex held
+//----------------------------------------------------------------------------
+///
+
+unsigned EventLoop::NewGen(void) {
+  unsigned gen = m_NextGen;
+  m_NextGen = (m_NextGen + 1) & EVENTGENMASK;
+  if (m_NextGen == 0)
+    m_NextGen = 1;
+  return gen;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SubmitSend
+//   Description:
+///   \brief Send hook given to connections with loop owned I/O
+//   Parameters:
+///   @param NetworkOps *ops
+///   @param void *ptrClass - the loop
+//   Return:
+///   @return bool - false if the loop no longer has the connection
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::SubmitSend(NetworkOps *ops, void *ptrClass) {
+  EventLoop *loop = (EventLoop *)ptrClass;
+  return (loop) ? loop->QueueSend(ops) : false;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   QueueSend
+//   Description:
+///   \brief Take a connection's outbound queue, unless a send is in flight
+//   Parameters:
+///   @param NetworkOps *ops
+//   Return:
+///   @return bool
+//   Notes:
+///   Called with the connection's send side held. A send still in flight
+///   picks the queue up when it completes. From the connection's own
+///   callback the send goes to the kernel with the next wait, together
+///   with those of every other callback in the batch, otherwise straight
+///   away.
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::QueueSend(NetworkOps *ops) {
+  m_Mutex.Lock();
+  std::map<int, EventEntry *>::iterator it = m_Entries.find(ops->GetSockId());
+  if (it == m_Entries.end() || it->second->m_Ops != ops ||
+      !it->second->m_LoopIO) {
+    m_Mutex.Unlock();
+    return false;
+  }
+
+  EventEntry *entry = it->second;
+  if (!entry->m_Sending)
+    StartSend(entry, !(entry->m_Busy && entry->m_Owner == SelfId()));
+  m_Mutex.Unlock();
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   StartSend
+//   Description:
+///   \brief Send everything a connection has queued, in one request
+//   Parameters:
+///   @param EventEntry *entry
+///   @param bool bSubmit - hand it to the kernel now
+//   Return:
+//   Notes:
+///   Must be called with m_Mutex and the connection's send side held. A
+///   send the ring won't take fails the connection, as a write error
+///   would.
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::StartSend(EventEntry *entry, bool bSubmit) {
+  SendBatch *batch = new SendBatch;
+  batch->m_Bytes = entry->m_Ops->TakeQueued(batch->m_Bufs, batch->m_Offset);
+  if (batch->m_Bytes == 0) {
+    delete batch;
+    return;
+  }
+
+  if (!QueueBatch(entry, batch, bSubmit)) {
+    entry->m_Ops->SendDone(batch->m_Bytes);
+    entry->m_Ops->DeliverEnd(ENOBUFS);
+    delete batch;
+  }
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   QueueBatch
+//   Description:
+///   \brief Queue a gather send of what is left of a batch
+//   Parameters:
+///   @param EventEntry *entry
+///   @param SendBatch *batch
+///   @param bool bSubmit
+//   Return:
+///   @return bool
+//   Notes:
+///   Must be called with m_Mutex held. Up to SENDMAXVEC buffers go in
+///   each request, the rest when it completes.
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::QueueBatch(EventEntry *entry, SendBatch *batch,
+                           bool bSubmit) {
+#ifdef __linux__
+  int count = 0;
+  for (std::deque<std::string>::iterator it = batch->m_Bufs.begin();
+       it != batch->m_Bufs.end() && count < SENDMAXVEC; ++it, count++) {
+    size_t offset = (count == 0) ? batch->m_Offset : 0;
+    batch->m_Vec[count].iov_base = (void *)(it->data() + offset);
+    batch->m_Vec[count].iov_len = it->length() - offset;
+  }
+  memset(&batch->m_Msg, 0, sizeof(batch->m_Msg));
+  batch->m_Msg.msg_iov = batch->m_Vec;
+  batch->m_Msg.msg_iovlen = count;
+
+  unsigned long long key =
+      UringKey(entry->m_SockId, entry->m_Gen, EVENTOPSEND);
+  m_Sends[key] = batch;
+  if (!m_Uring.SendMsg(entry->m_SockId, &batch->m_Msg, key, bSubmit)) {
+    m_Sends.erase(key);
+    return false;
+  }
+  entry->m_Sending = true;
+  return true;
+#else
+  (void)entry;
+  (void)batch;
+  (void)bSubmit;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Received
+//   Description:
+///   \brief Hand a multishot receive completion to its connection
+//   Parameters:
+///   @param const UringEvent &ev
+///   @param std::vector<std::pair<int, int> > &ready
+//   Return:
+//   Notes:
+///   Must be called with m_Mutex held. The data is copied out and the
+///   buffer given back straight away, stale completion or not, so the
+///   shared ring only runs dry under a burst bigger than all of it.
+///   Running dry, or the kernel ending the receive, just starts another.
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::Received(const UringEvent &ev,
+                         std::vector<std::pair<int, int> > &ready) {
+#ifdef URINGRECVMULTI
+  int sockId = (int)(ev.userData & 0xffffffff);
+  unsigned gen = (unsigned)(ev.userData >> 32) & EVENTGENMASK;
+
+  std::map<int, EventEntry *>::iterator it = m_Entries.find(sockId);
+  if (it != m_Entries.end() && it->second->m_Gen == gen &&
+      it->second->m_Receiving) {
+    EventEntry *entry = it->second;
+    const char *buf = m_Uring.GetRecvBuffer(ev);
+    int events = 0;
+
+    if (ev.result > 0 && buf) {
+      entry->m_Ops->Deliver(buf, ev.result);
+      events |= EVENTREAD;
+    }
+    if (!(ev.flags & IORING_CQE_F_MORE)) {
+      entry->m_Receiving = false;
+      if (ev.result == 0) {
+        entry->m_Ops->DeliverEnd(0);
+        events |= EVENTREAD | EVENTHANGUP;
+      } else if (ev.result > 0 || ev.result == -ENOBUFS) {
+        if (!Arm(entry, false, true)) {
+          entry->m_Ops->DeliverEnd(ENOBUFS);
+          events |= EVENTREAD | EVENTHANGUP;
+        }
+      } else if (ev.result != -ECANCELED) {
+        entry->m_Ops->DeliverEnd(-ev.result);
+        events |= EVENTREAD | EVENTHANGUP;
+      }
+    }
+    if (events != 0)
+      AddReady(ready, sockId, events);
+  }
+  m_Uring.ReturnRecvBuffer(ev);
+#else
+  (void)ev;
+  (void)ready;
+#endif
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Sent
+//   Description:
+///   \brief Retire a completed send, and carry on with what is left
+//   Parameters:
+///   @param const UringEvent &ev
+///   @param std::vector<std::pair<int, int> > &ready
+//   Return:
+//   Notes:
+///   Must be called with m_Mutex held. The connection is called back with
+///   EVENTWRITE once its batch is all sent, or as a hang up if it failed.
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::Sent(const UringEvent &ev,
+                     std::vector<std::pair<int, int> > &ready) {
+  std::map<unsigned long long, SendBatch *>::iterator bit =
+      m_Sends.find(ev.userData);
+  if (bit == m_Sends.end())
+    return;
+  SendBatch *batch = bit->second;
+  m_Sends.erase(bit);
+
+  int sockId = (int)(ev.userData & 0xffffffff);
+  unsigned gen = (unsigned)(ev.userData >> 32) & EVENTGENMASK;
+  std::map<int, EventEntry *>::iterator it = m_Entries.find(sockId);
+  if (it == m_Entries.end() || it->second->m_Gen != gen ||
+      !it->second->m_Sending) {
+    delete batch;
+    return;
+  }
+  EventEntry *entry = it->second;
+
+  bool bFailed = (ev.result < 0);
+  if (!bFailed) {
+    size_t left = ev.result;
+    while (left > 0 && !batch->m_Bufs.empty()) {
+      size_t front = batch->m_Bufs.front().length() - batch->m_Offset;
+      if (left < front) {
+        batch->m_Offset += left;
+        break;
+      }
+      left -= front;
+      batch->m_Bufs.pop_front();
+      batch->m_Offset = 0;
+    }
+    if (!batch->m_Bufs.empty()) {
+      if (QueueBatch(entry, batch, false))
+        return;
+      bFailed = true;
+    }
+  }
+
+  entry->m_Sending = false;
+  entry->m_Ops->SendDone(batch->m_Bytes);
+  if (bFailed)
+    entry->m_Ops->DeliverEnd((ev.result < 0) ? -ev.result : ENOBUFS);
+  delete batch;
+  AddReady(ready, sockId, (bFailed) ? EVENTREAD | EVENTHANGUP : EVENTWRITE);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Dispatch
+//   Description:
+///   \brief Run the callback for a ready connection
+//   Parameters:
+///   @param int sockId
+///   @param int events
+//   Return:
+//   Notes:
+///   Completions for loop owned I/O are only reported once, so any that
+///   come in while the callback runs are kept, and it is called again.
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::Dispatch(int sockId, int events) {
+  m_Mutex.Lock();
+  std::map<int, EventEntry *>::iterator it = m_Entries.find(sockId);
+  if (it == m_Entries.end() || it->second->m_Busy) {
+    /// Somebody else has it - they re-arm a poll, which re-reports
+    /// readiness, and pick up completions kept for them
+    if (it != m_Entries.end() && it->second->m_LoopIO)
+      it->second->m_Pending |= events;
+    m_Mutex.Unlock();
+    return;
+  }
+
+  EventEntry *entry = it->second;
+  /// Closed without being removed first - io_uring holds the socket open
+  /// until its poll fires, so this is where it finally goes
+  if (!entry->m_Ops->IsConnected() ||
+      entry->m_Ops->GetSockId() != entry->m_SockId) {
+    DropEntry(entry);
+    m_Mutex.Unlock();
+    return;
+  }
+
+  entry->m_Busy = true;
+  m_Dispatched++;
+  entry->m_Owner = SelfId();
+  if (events & (EVENTREAD | EVENTWRITE | EVENTHANGUP))
+    entry->m_LastEvent = NetworkOps::GetTimeMs();
+  m_Mutex.Unlock();
+
+  bool bKeep = true;
+  for (;;) {
+    /// Zero copy completions arrive as errors, don't mistake them for one
+    if ((events & EVENTHANGUP) && !entry->m_Ops->IsHungUp())
+      events &= ~EVENTHANGUP;
+
+    if ((events & EVENTWRITE) && entry->m_Ops->HasQueuedMsgs())
+      (void)entry->m_Ops->FlushMsgs();
+
+    /// A TLS read waiting to send carries on when the socket drains
+    if ((events & EVENTWRITE) && entry->m_Ops->ReadWantsWrite())
+      events |= EVENTREAD;
+
+    bKeep = (*entry->m_Callback)(entry->m_Ops, events, entry->m_Param);
+
+    m_Mutex.Lock();
+    if (!bKeep || entry->m_Removed || entry->m_Pending == 0)
+      break;
+    events = entry->m_Pending;
+    entry->m_Pending = 0;
+    m_Dispatched++;
+    m_Mutex.Unlock();
+  }
+
+  /// Still connected, but the loop can't serve it - give it back its I/O
+  NetworkOps *stopOps = 0;
+  entry->m_Busy = false;
+  entry->m_Owner = 0;
+  if (entry->m_Removed)
+    delete entry;
+  else if (!bKeep || !entry->m_Ops->IsConnected() ||
+           entry->m_Ops->GetSockId() != entry->m_SockId)
+    DropEntry(entry);
+  else if (!Arm(entry, false, true)) {
+    if (entry->m_LoopIO)
+      stopOps = entry->m_Ops;
+    DropEntry(entry);
+  }
+  m_Mutex.Unlock();
+
+  if (stopOps)
+    stopOps->StopDelivery();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ScanIdle
+//   Description:
+///   \brief Call back any registration that has been idle for too long
+//   Parameters:
+///   @param long long now
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::ScanIdle(long long now) {
+  std::vector<int> idle;
+
+  m_Mutex.Lock();
+  if (now < m_NextScan) {
+    m_Mutex.Unlock();
+    return;
+  }
+  m_NextScan = now + EVENTIDLESCAN;
+
+  for (std::map<int, EventEntry *>::iterator it = m_Entries.begin();
+       it != m_Entries.end(); ++it) {
+    EventEntry *entry = it->second;
+    if (entry->m_IdleMs > 0 && !entry->m_Busy &&
+        (now - entry->m_LastEvent) >= entry->m_IdleMs) {
+      entry->m_LastEvent = now;
+      idle.push_back(entry->m_SockId);
+    }
+  }
+  m_Mutex.Unlock();
+
+  for (std::vector<int>::iterator it = idle.begin(); it != idle.end(); ++it)
+    Dispatch(*it, EVENTTIMEOUT);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunOnce
+//   Description:
+///   \brief Wait for one batch of events and dispatch them
+//   Parameters:
+///   @param int timeoutMs - longest time to wait
+//   Return:
+///   @return int - number of events dispatched, -1 on a poller error
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int EventLoop::RunOnce(int timeoutMs) {
+#ifdef _WIN32
+  return -1;
+#else
+  int waitMs = timeoutMs;
+  if (waitMs < 0 || waitMs > EVENTIDLESCAN)
+    waitMs = EVENTIDLESCAN;
+
+  std::vector<std::pair<int, int> > ready;
+
+  int nready = (IsSpinning() && waitMs > 0) ? Spin(ready) : 0;
+  if (nready == 0) {
+    long long start = NetworkOps::GetTimeUs();
+    nready = Collect(ready, waitMs);
+    m_Mutex.Lock();
+    m_SleepTime += NetworkOps::GetTimeUs() - start;
+    m_Mutex.Unlock();
+  }
+  if (nready < 0)
+    return -1;
+
+  for (std::vector<std::pair<int, int> >::iterator it = ready.begin();
+       it != ready.end(); ++it)
+    Dispatch(it->first, it->second);
+
+  long long now = NetworkOps::GetTimeMs();
+  NoteTraffic((int)ready.size(), now);
+  ScanIdle(now);
+
+  return (int)ready.size();
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Collect
+//   Description:
+///   \brief Wait for events and gather them up for dispatch
+//   Parameters:
+///   @param std::vector<std::pair<int, int> > &ready - socket and EVENT*
+///          flags of each ready registration
+///   @param int waitMs - longest time to wait, 0 just to look
+//   Return:
+///   @return int - events gathered, -1 on a poller error
+//   Notes:
+///   Looking costs no system call on io_uring, unless arming is queued
+//----------------------------------------------------------------------------
+///
+
+int EventLoop::Collect(std::vector<std::pair<int, int> > &ready, int waitMs) {
+#ifdef _WIN32
+  return -1;
+#else
+#ifdef __linux__
+  if (m_Uring.IsOpen()) {
+    UringEvent evs[EVENTBATCH];
+    int nready = (waitMs == 0) ? m_Uring.Peek(evs, EVENTBATCH)
+                               : m_Uring.Wait(evs, EVENTBATCH, waitMs);
+    if (nready < 0) {
+      SetError("- Event loop wait failed");
+      return -1;
+    }
+
+    m_Mutex.Lock();
+    for (int i = 0; i < nready; i++) {
+      int sockId = (int)(evs[i].userData & 0xffffffff);
+      unsigned gen = (unsigned)(evs[i].userData >> 32) & EVENTGENMASK;
+      unsigned op = (unsigned)(evs[i].userData >> 62);
+      if (op == EVENTOPRECV) {
+        Received(evs[i], ready);
+        continue;
+      }
+      if (op == EVENTOPSEND) {
+        Sent(evs[i], ready);
+        continue;
+      }
+      if (gen == 0) {
+        char buf[64];
+        while (read(m_WakeId[0], buf, sizeof(buf)) > 0)
+          ;
+        (void)m_Uring.PollAdd(m_WakeId[0], POLLIN, evs[i].userData);
+        continue;
+      }
+
+      /// Completions for removed or re-armed polls are stale
+      std::map<int, EventEntry *>::iterator it = m_Entries.find(sockId);
+      if (it == m_Entries.end() || it->second->m_Gen != gen ||
+          !it->second->m_Armed)
+        continue;
+      it->second->m_Armed = false;
+
+      int events = 0;
+      if (evs[i].result < 0)
+        events = EVENTHANGUP;
+      else {
+        if (evs[i].result & POLLIN)
+          events |= EVENTREAD;
+        if (evs[i].result & POLLOUT)
+          events |= EVENTWRITE;
+        if (evs[i].result & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL))
+          events |= EVENTHANGUP;
+      }
+      AddReady(ready, sockId, events);
+    }
+    m_Mutex.Unlock();
+  } else {
+    struct epoll_event evs[EVENTBATCH];
+    int nready = epoll_wait(m_PollId, evs, EVENTBATCH, waitMs);
+    if (nready < 0) {
+      if (errNo == EINTR)
+        return 0;
+      SetError("- Event loop wait failed");
+      return -1;
+    }
+    m_Mutex.Lock();
+    m_PollerCalls++;
+    m_Mutex.Unlock();
+
+    for (int i = 0; i < nready; i++) {
+      if (evs[i].data.fd == m_WakeId[0]) {
+        char buf[64];
+        while (read(m_WakeId[0], buf, sizeof(buf)) > 0)
+          ;
+        continue;
+      }
+      int events = 0;
+      if (evs[i].events & EPOLLIN)
+        events |= EVENTREAD;
+      if (evs[i].events & EPOLLOUT)
+        events |= EVENTWRITE;
+      if (evs[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        events |= EVENTHANGUP;
+      int sockId = evs[i].data.fd;
+      ready.push_back(std::make_pair(sockId, events));
+    }
+  }
+#else
+  std::vector<struct pollfd> fds;
+  struct pollfd wake = {0};
+  wake.fd = m_WakeId[0];
+  wake.events = POLLIN;
+  fds.push_back(wake);
+
+  m_Mutex.Lock();
+  for (std::map<int, EventEntry *>::iterator it = m_Entries.begin();
+       it != m_Entries.end(); ++it) {
+    if (it->second->m_Busy)
+      continue;
+    struct pollfd pfd = {0};
+    pfd.fd = it->first;
+    if (it->second->m_Events & EVENTREAD)
+      pfd.events |= POLLIN;
+    if ((it->second->m_Events & EVENTWRITE) ||
+        it->second->m_Ops->WantsWrite())
+      pfd.events |= POLLOUT;
+    fds.push_back(pfd);
+  }
+  m_Mutex.Unlock();
+
+  int nready = poll(&fds[0], fds.size(), waitMs);
+  if (nready < 0) {
+    if (errNo == EINTR)
+      return 0;
+    SetError("- Event loop wait failed");
+    return -1;
+  }
+
+  if (fds[0].revents & POLLIN) {
+    char buf[64];
+    while (read(m_WakeId[0], buf, sizeof(buf)) > 0)
+      ;
+  }
+  for (size_t i = 1; i < fds.size() && nready > 0; i++) {
+    if (fds[i].revents == 0)
+      continue;
+    int events = 0;
+    if (fds[i].revents & POLLIN)
+      events |= EVENTREAD;
+    if (fds[i].revents & POLLOUT)
+      events |= EVENTWRITE;
+    if (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+      events |= EVENTHANGUP;
+    ready.push_back(std::make_pair(fds[i].fd, events));
+  }
+#endif
+
+  return (int)ready.size();
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Spin
+//   Description:
+///   \brief Busy poll for events, for up to the spin budget
+//   Parameters:
+///   @param std::vector<std::pair<int, int> > &ready
+//   Return:
+///   @return int - events gathered, 0 if the budget ran out, -1 on error
+//   Notes:
+///   Saves the wakeup from a blocking wait when the next message is close
+///   behind the last, at the cost of a core while it spins
+//----------------------------------------------------------------------------
+///
+
+int EventLoop::Spin(std::vector<std::pair<int, int> > &ready) {
+  long long start = NetworkOps::GetTimeUs();
+  long long now = start;
+  int nready = 0;
+
+  while (nready == 0 && now - start < m_SpinUs && IsRunning()) {
+    nready = Collect(ready, 0);
+    now = NetworkOps::GetTimeUs();
+  }
+
+  m_Mutex.Lock();
+  m_SpinTime += now - start;
+  if (nready > 0)
+    m_SpinHits++;
+  else if (nready == 0)
+    m_SpinMisses++;
+  m_Mutex.Unlock();
+  return nready;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   NoteTraffic
+//   Description:
+///   \brief Turn busy polling on or off with the event rate
+//   Parameters:
+///   @param int events - dispatched by this wait
+///   @param long long now - ms
+//   Return:
+//   Notes:
+///   Decided once a window, so an idle account goes back to blocking
+///   waits within a second and a busy one starts spinning as quickly.
+///   Never spins on a single CPU machine.
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::NoteTraffic(int events, long long now) {
+  if (m_SpinUs <= 0 || !SpareCpu())
+    return;
+
+  m_Mutex.Lock();
+  m_WindowEvents += events;
+  long long elapsed = now - m_WindowStart;
+  if (elapsed >= EVENTSPINWINDOW) {
+    bool bSpin =
+        (m_WindowStart > 0 && m_WindowEvents * 1000 >= m_SpinRate * elapsed);
+    if (bSpin != m_Spinning) {
+      m_Spinning = bSpin;
+      m_SpinSwitches++;
+      if (IsDebug())
+        (void)DebugUtils::LogMessage(
+            MSGINFO, "Debug: [%s,%d] Busy polling %s at %lld events/s",
+            __FILE__, __LINE__, (bSpin) ? "on" : "off",
+            m_WindowEvents * 1000 / elapsed);
+    }
+    m_WindowStart = now;
+    m_WindowEvents = 0;
+  }
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Counters
+//   Description:
+///   \brief Poller statistics
+//   Parameters:
+//   Return:
+//   Notes:
+///   io_uring queues its arming and submits it with the next wait, so its
+///   poller calls are just the waits and immediate submissions
+//----------------------------------------------------------------------------
+///
+
+unsigned long EventLoop::GetPollerCalls(void) {
+  if (m_Uring.IsOpen())
+    return m_Uring.GetEnters();
+  m_Mutex.Lock();
+  unsigned long calls = m_PollerCalls;
+  m_Mutex.Unlock();
+  return calls;
+}
+
+unsigned long EventLoop::GetDispatched(void) {
+  m_Mutex.Lock();
+  unsigned long dispatched = m_Dispatched;
+  m_Mutex.Unlock();
+  return dispatched;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Spin counters
+//   Description:
+///   \brief Busy polling statistics
+//   Parameters:
+//   Return:
+//   Notes:
+///   Spin and sleep times add up over all the dispatcher threads
+//----------------------------------------------------------------------------
+///
+
+bool EventLoop::IsSpinning(void) {
+  m_Mutex.Lock();
+  bool bSpin = (m_Spinning && m_SpinUs > 0);
+  m_Mutex.Unlock();
+  return bSpin;
+}
+
+long long EventLoop::GetSpinTime(void) {
+  m_Mutex.Lock();
+  long long spin = m_SpinTime;
+  m_Mutex.Unlock();
+  return spin;
+}
+
+long long EventLoop::GetSleepTime(void) {
+  m_Mutex.Lock();
+  long long sleep = m_SleepTime;
+  m_Mutex.Unlock();
+  return sleep;
+}
+
+unsigned long EventLoop::GetSpinHits(void) {
+  m_Mutex.Lock();
+  unsigned long hits = m_SpinHits;
+  m_Mutex.Unlock();
+  return hits;
+}
+
+unsigned long EventLoop::GetSpinMisses(void) {
+  m_Mutex.Lock();
+  unsigned long misses = m_SpinMisses;
+  m_Mutex.Unlock();
+  return misses;
+}
+
+unsigned long EventLoop::GetSpinSwitches(void) {
+  m_Mutex.Lock();
+  unsigned long switches = m_SpinSwitches;
+  m_Mutex.Unlock();
+  return switches;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReportSpin
+//   Description:
+///   \brief Log the CPU spent spinning against the time spent blocked
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void EventLoop::ReportSpin(void) {
+  if (m_SpinUs <= 0)
+    return;
+
+  m_Mutex.Lock();
+  (void)DebugUtils::LogMessage(
+      MSGINFO,
+      "Debug: [%s,%d] Busy poll %dus: spun %lldms (%lu hits, %lu misses), "
+      "slept %lldms, switched %lu times",
+      __FILE__, __LINE__, m_SpinUs, m_SpinTime / 1000, m_SpinHits,
+      m_SpinMisses, m_SleepTime / 1000, m_SpinSwitches);
+  m_Mutex.Unlock();
+  return;
+}
@@ -0,0 +1,195 @@
+///
+///   EventLoop.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __eventloop_h_
+#define __eventloop_h_
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Mutex.h"
+#include "NetworkOps.h"
+#include "Threads.h"
+#include "UringPoller.h"
+
+/// Event flags handed to (and requested by) event callbacks
+#define EVENTREAD 0x01
+#define EVENTWRITE 0x02
+#define EVENTHANGUP 0x04
+#define EVENTTIMEOUT 0x08
+
+///
+/// Add only - on io_uring the loop receives for the connection and sends
+/// its outbound queue itself, see Add
+///
+#define EVENTLOOPIO 0x10
+
+/// Default number of dispatcher threads
+#define EVENTTHREADS 2
+
+/// Pollers - io_uring falls back to epoll where the kernel lacks it
+#define EVENTBACKENDEPOLL 0
+#define EVENTBACKENDURING 1
+
+/// Busy polling stays on while at least this many events a second arrive
+#define EVENTSPINRATE 100
+
+///
+/// Event callback. Return false to drop the registration, e.g. once the
+/// session has been closed.
+///
+typedef bool (*EVENTCALLBACKFUNCPTR)(NetworkOps *, int, void *);
+
+class EventLoop {
+
+public:
+  ///
+  /// Public interface
+  ///
+  EventLoop();
+  ~EventLoop();
+
+  inline bool const IsRunning() { return m_Running; }
+  inline bool const IsDebug() { return m_Debug; }
+  inline void SetDebug(bool val) { m_Debug = val; }
+  inline const std::string *GetError() { return &m_ErrorStr; }
+  inline int const GetThreadCount() { return (int)m_Threads.size(); }
+  inline int const GetBackend() { return m_Backend; }
+  inline void SetBackend(int val) { m_Backend = val; }
+
+  ///
+  /// Low latency mode - spin for up to spinUs before each blocking wait,
+  /// while the event rate stays at or above spinRate a second. Off with a
+  /// budget of 0.
+  ///
+  inline int const GetSpinUs() { return m_SpinUs; }
+  inline void SetSpinUs(int val) { m_SpinUs = val; }
+  inline int const GetSpinRate() { return m_SpinRate; }
+  inline void SetSpinRate(int val) { m_SpinRate = val; }
+  bool IsSpinning(void);
+
+  bool Start(int threads = EVENTTHREADS);
+  bool Stop(void);
+
+  bool Add(NetworkOps *, EVENTCALLBACKFUNCPTR, void *, int events = EVENTREAD,
+           int idleMs = 0);
+  bool Modify(NetworkOps *, int);
+  bool Remove(NetworkOps *);
+
+  int RunOnce(int);
+
+  /// Counters - system calls made on the poller (waits and arming) and
+  /// events dispatched
+  unsigned long GetPollerCalls(void);
+  unsigned long GetDispatched(void);
+
+  /// Busy polling - time spent spinning and blocked (us), spins that found
+  /// events and those that ran out, and times it was turned on or off
+  long long GetSpinTime(void);
+  long long GetSleepTime(void);
+  unsigned long GetSpinHits(void);
+  unsigned long GetSpinMisses(void);
+  unsigned long GetSpinSwitches(void);
+  void ReportSpin(void);
+
+protected:
+  ///
+  /// Protected interface
+  ///
+  void init();
+  void clear();
+
+  inline void SetError(const char *err) { m_ErrorStr = err; }
+
+private:
+  struct EventEntry {
+    NetworkOps *m_Ops;
+    EVENTCALLBACKFUNCPTR m_Callback;
+    void *m_Param;
+    int m_SockId;
+    int m_Events;
+    int m_IdleMs;
+    long long m_LastEvent;
+    bool m_Busy;
+    bool m_Removed;
+    /// io_uring only - the poll outstanding for the entry. The generation
+    /// tells its completion apart from one for an earlier user of the
+    /// socket number.
+    bool m_Armed;
+    unsigned m_ArmedMask;
+    unsigned m_Gen;
+    THREADTYPE m_Owner;
+    /// Loop owned I/O - the multishot receive is outstanding, a send is in
+    /// flight, and what completed while the callback was running
+    bool m_LoopIO;
+    bool m_Receiving;
+    bool m_Sending;
+    int m_Pending;
+  };
+
+  struct SendBatch;
+
+  static CALLBACKFUNC DispatchThread(void *);
+  static bool SubmitSend(NetworkOps *, void *);
+
+  bool Arm(EventEntry *, bool, bool bDefer = false);
+  void Disarm(EventEntry *);
+  int Collect(std::vector<std::pair<int, int> > &, int);
+  int Spin(std::vector<std::pair<int, int> > &);
+  void NoteTraffic(int, long long);
+  void Dispatch(int, int);
+  void DropEntry(EventEntry *);
+  void ScanIdle(long long);
+  void Wakeup(void);
+  unsigned NewGen(void);
+
+  /// Loop owned I/O
+  bool QueueSend(NetworkOps *);
+  void StartSend(EventEntry *, bool);
+  bool QueueBatch(EventEntry *, SendBatch *, bool);
+  void Received(const UringEvent &, std::vector<std::pair<int, int> > &);
+  void Sent(const UringEvent &, std::vector<std::pair<int, int> > &);
+
+  std::map<int, EventEntry *> m_Entries;
+  std::vector<Threads *> m_Threads;
+
+  Mutex m_Mutex;
+  std::string m_ErrorStr;
+
+  int m_Backend;
+  UringPoller m_Uring;
+  /// Sends in flight, by user data. Guarded by m_Mutex.
+  std::map<unsigned long long, SendBatch *> m_Sends;
+  unsigned m_NextGen;
+  unsigned long m_PollerCalls;
+  unsigned long m_Dispatched;
+
+  /// Busy polling, guarded by m_Mutex
+  int m_SpinUs;
+  int m_SpinRate;
+  bool m_Spinning;
+  long long m_WindowStart;
+  long long m_WindowEvents;
+  long long m_SpinTime;
+  long long m_SleepTime;
+  unsigned long m_SpinHits;
+  unsigned long m_SpinMisses;
+  unsigned long m_SpinSwitches;
+
+  int m_PollId;
+  int m_WakeId[2];
+  int m_Active;
+  long long m_NextScan;
+  /// Written by Start and Stop, read unlocked by the dispatchers
+  std::atomic<bool> m_Running;
+  bool m_Debug;
+};
+
+#endif
@@ -0,0 +1,241 @@
+///
+///   LatencyTrace.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "LatencyTrace.h"
+#include "UtilityFuncs.h"
+
+#include <chrono>
+#include <cstring>
+
+LatencyTrace::StageStats LatencyTrace::m_Stages[TRACESTAGES];
+unsigned long LatencyTrace::m_Count = 0;
+Mutex LatencyTrace::m_Mutex;
+
+namespace {
+const char *StageNames[TRACESTAGES] = {"total", "read", "parse", "callback",
+                                       "reply"};
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   MsgTrace
+//   Description:
+///   \brief Start a trace
+//   Parameters:
+///   @param long long arrived - kernel receive timestamp, 0 if none
+//   Return:
+//   Notes:
+///   A trace without an arrival time stays inactive and is never stamped
+//----------------------------------------------------------------------------
+///
+
+MsgTrace::MsgTrace(long long arrived) {
+  memset(stamps, 0, sizeof(stamps));
+  stamps[TRACEARRIVED] = arrived;
+}
+
+void MsgTrace::Stamp(int stage) {
+  if (IsActive() && stage > TRACEARRIVED && stage < TRACESTAGES)
+    stamps[stage] = LatencyTrace::Now();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Now
+//   Description:
+///   \brief Wall clock time in nanoseconds
+//   Parameters:
+//   Return:
+///   @return long long
+//   Notes:
+///   The kernel stamps received data with the real time clock, so the
+///   later stages have to use it too
+//----------------------------------------------------------------------------
+///
+
+long long LatencyTrace::Now(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Record
+//   Description:
+///   \brief Add a finished message to the figures
+//   Parameters:
+///   @param const MsgTrace &trace
+//   Return:
+//   Notes:
+///   Stages that were not reached (no reply sent, say) are skipped, and
+///   the next one is timed from the last stage that was
+//----------------------------------------------------------------------------
+///
+
+void LatencyTrace::Record(const MsgTrace &trace) {
+  if (!trace.IsActive())
+    return;
+
+  m_Mutex.Lock();
+  long long last = trace.stamps[TRACEARRIVED];
+  for (int i = TRACEARRIVED + 1; i < TRACESTAGES; i++) {
+    if (trace.stamps[i] == 0)
+      continue;
+    Add(m_Stages[i], trace.stamps[i] - last);
+    last = trace.stamps[i];
+  }
+  Add(m_Stages[TRACEARRIVED], last - trace.stamps[TRACEARRIVED]);
+  m_Count++;
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Report
+//   Description:
+///   \brief Log the figures for each stage
+//   Parameters:
+//   Return:
+//   Notes:
+///   Percentiles are read off the histogram, so are only good to within
+///   a factor of two
+//----------------------------------------------------------------------------
+///
+
+void LatencyTrace::Report(void) {
+  m_Mutex.Lock();
+  for (int i = 0; i < TRACESTAGES && m_Count > 0; i++) {
+    const StageStats &stage = m_Stages[i];
+    if (stage.count == 0)
+      continue;
+    (void)DebugUtils::LogMessage(
+        MSGINFO,
+        "Debug: [%s,%d] Latency %s: %lu msgs avg=%lldus p50<%lldus "
+        "p99<%lldus max=%lldus",
+        __FILE__, __LINE__, StageNames[i], stage.count,
+        stage.total / (long long)stage.count / 1000, Percentile(stage, 50),
+        Percentile(stage, 99), stage.max / 1000);
+  }
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Reset
+//   Description:
+///   \brief Throw the figures away
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void LatencyTrace::Reset(void) {
+  m_Mutex.Lock();
+  memset(m_Stages, 0, sizeof(m_Stages));
+  m_Count = 0;
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetCount
+//   Description:
+///   \brief Messages traced so far
+//   Parameters:
+//   Return:
+///   @return unsigned long
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+unsigned long LatencyTrace::GetCount(void) {
+  m_Mutex.Lock();
+  unsigned long count = m_Count;
+  m_Mutex.Unlock();
+  return count;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Add
+//   Description:
+///   \brief Add one time to a stage
+//   Parameters:
+///   @param StageStats &stage
+///   @param long long nsecs
+//   Return:
+//   Notes:
+///   Must be called with m_Mutex held. Clocks can step, so a negative
+///   time counts as none.
+//----------------------------------------------------------------------------
+///
+
+void LatencyTrace::Add(StageStats &stage, long long nsecs) {
+  if (nsecs < 0)
+    nsecs = 0;
+
+  int bucket = 0;
+  while (bucket < TRACEBUCKETS - 1 && (nsecs >> bucket) > 1)
+    bucket++;
+
+  stage.count++;
+  stage.total += nsecs;
+  if (nsecs > stage.max)
+    stage.max = nsecs;
+  stage.buckets[bucket]++;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Percentile
+//   Description:
+///   \brief Upper bound of the bucket holding a percentile (us)
+//   Parameters:
+///   @param const StageStats &stage
+///   @param int pct
+//   Return:
+///   @return long long
+//   Notes:
+///   Must be called with m_Mutex held
+//----------------------------------------------------------------------------
+///
+
+long long LatencyTrace::Percentile(const StageStats &stage, int pct) {
+  unsigned long want = (stage.count * pct + 99) / 100;
+  unsigned long seen = 0;
+
+  for (int i = 0; i < TRACEBUCKETS; i++) {
+    seen += stage.buckets[i];
+    if (seen >= want)
+      return ((2LL << i) + 999) / 1000;
+  }
+  return stage.max / 1000;
+}
@@ -0,0 +1,77 @@
+///
+///   LatencyTrace.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __latencytrace_h_
+#define __latencytrace_h_
+
+#include "Mutex.h"
+
+///
+/// Stages a traced message passes through, in order. Each stage's time is
+/// measured from the one before it that was stamped.
+///
+#define TRACEARRIVED 0 /// kernel receive timestamp
+#define TRACEFRAMED 1  /// frame picked up for processing
+#define TRACEPARSED 2  /// parsed into a chat message
+#define TRACEHANDLED 3 /// user callback returned
+#define TRACEREPLIED 4 /// reply written to the socket
+#define TRACESTAGES 5
+
+/// Histogram buckets, each twice the width of the last (ns)
+#define TRACEBUCKETS 40
+
+///
+/// Stage times of one message (wall clock ns, 0 if not reached)
+///
+struct MsgTrace {
+  MsgTrace(long long arrived = 0);
+
+  inline bool IsActive() const { return (stamps[TRACEARRIVED] != 0); }
+  void Stamp(int);
+
+  long long stamps[TRACESTAGES];
+};
+
+///
+/// Process wide latency figures, built up from the traces of messages on
+/// connections with receive timestamps turned on (NET_TIMESTAMPS). Shows
+/// whether reply latency goes to queueing in our own threads or to the
+/// user callback.
+///
+class LatencyTrace {
+
+public:
+  ///
+  /// Public interface
+  ///
+  static long long Now(void);
+  static void Record(const MsgTrace &);
+  static void Report(void);
+  static void Reset(void);
+
+  static unsigned long GetCount(void);
+
+private:
+  struct StageStats {
+    unsigned long count;
+    long long total;
+    long long max;
+    unsigned long buckets[TRACEBUCKETS];
+  };
+
+  static void Add(StageStats &, long long);
+  static long long Percentile(const StageStats &, int);
+
+  /// One entry per stage, from the stage before, and the end to end time
+  /// in the TRACEARRIVED slot
+  static StageStats m_Stages[TRACESTAGES];
+  static unsigned long m_Count;
+  static Mutex m_Mutex;
+};
+
+#endif
@@ -0,0 +1,291 @@
+///
+///   Listener.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "Listener.h"
+#include "UtilityFuncs.h"
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Constructors
+//   Description:
+///   \brief Constructor routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+Listener::Listener() { init(); }
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Destructors
+//   Description:
+///   \brief Destructors routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+Listener::~Listener() { (void)Stop(); }
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   init
+//   Description:
+///   \brief init the class
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void Listener::init() {
+  m_Loop = 0;
+  m_Callback = 0;
+  m_Param = 0;
+  m_Accepted = 0;
+  m_Debug = false;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Start
+//   Description:
+///   \brief Open the port and start accepting
+//   Parameters:
+///   @param const std::string &service - port to listen on
+///   @param ACCEPTCALLBACKFUNCPTR callback - given each new connection
+///   @param void *param - handed to the callback
+///   @param EventLoop *loop - drives the accepts, or 0 to use Poll
+///   @param int shards - listening sockets to open on the port
+//   Return:
+///   @return bool
+//   Notes:
+///   Without SO_REUSEPORT only one shard is opened. Port 0 picks a free
+///   port, which every shard then shares.
+//----------------------------------------------------------------------------
+///
+
+bool Listener::Start(const std::string &service, ACCEPTCALLBACKFUNCPTR callback,
+                     void *param, EventLoop *loop, int shards) {
+  if (IsRunning()) {
+    SetError("- The listener is already running");
+    return false;
+  }
+
+#ifndef SO_REUSEPORT
+  shards = 1;
+#endif
+  if (shards < 1)
+    shards = 1;
+
+  m_Callback = callback;
+  m_Param = param;
+  m_Loop = (loop && loop->IsRunning()) ? loop : 0;
+
+  std::string port = service;
+  for (int i = 0; i < shards; i++) {
+    NetworkOps *sock = new NetworkOps();
+    sock->SetService(&port);
+    sock->SetDebug(IsDebug());
+    sock->SetNonBlocking(true);
+    sock->SetReusePort(shards > 1);
+    sock->SetProfile(m_Profile);
+
+    if (!sock->StartServer(LISTENBACKLOG)) {
+      SetError(sock->GetError());
+      delete sock;
+      (void)Stop();
+      return false;
+    }
+    m_Sockets.push_back(sock);
+
+    if (i == 0) {
+      struct sockaddr_in addr = {0};
+      socklen_t len = sizeof(addr);
+      if (getsockname(sock->GetSockId(), (struct sockaddr *)&addr, &len) == 0)
+        StrUtils::i2str(ntohs(addr.sin_port), port);
+    }
+
+    if (m_Loop && !m_Loop->Add(sock, AcceptEvent, this, EVENTREAD)) {
+      SetError(m_Loop->GetError());
+      (void)Stop();
+      return false;
+    }
+  }
+
+  if (IsDebug())
+    (void)DebugUtils::LogMessage(
+        MSGINFO, "Debug: [%s,%d] Listening on port %s with %d shard(s)",
+        __FILE__, __LINE__, port.c_str(), GetShards());
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Stop
+//   Description:
+///   \brief Close the port
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   Connections already accepted belong to the callback and stay open
+//----------------------------------------------------------------------------
+///
+
+bool Listener::Stop(void) {
+  for (size_t i = 0; i < m_Sockets.size(); i++) {
+    if (m_Loop)
+      (void)m_Loop->Remove(m_Sockets[i]);
+    (void)m_Sockets[i]->Disconnect();
+    delete m_Sockets[i];
+  }
+  m_Sockets.clear();
+  m_Loop = 0;
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Poll
+//   Description:
+///   \brief Wait for and accept connections, when not on an event loop
+//   Parameters:
+///   @param int millisecs - how long to wait, -1 for ever
+//   Return:
+///   @return int - connections accepted, -1 on error
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int Listener::Poll(int millisecs) {
+  std::vector<NetworkOps *> ready;
+
+  if (!IsRunning())
+    return -1;
+
+  if (NetworkOps::WaitMsgs(m_Sockets, ready, millisecs) < 0)
+    return -1;
+
+  int accepted = 0;
+  for (size_t i = 0; i < ready.size(); i++)
+    accepted += AcceptAll(ready[i]);
+  return accepted;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   AcceptEvent
+//   Description:
+///   \brief Event loop callback for a listening socket
+//   Parameters:
+///   @param NetworkOps *net - the listening socket
+///   @param int events
+///   @param void *param - the listener
+//   Return:
+///   @return bool - false drops the registration
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool Listener::AcceptEvent(NetworkOps *net, int events, void *param) {
+  Listener *listener = (Listener *)param;
+
+  if (!listener || (events & EVENTHANGUP))
+    return false;
+
+  if (events & EVENTREAD)
+    (void)listener->AcceptAll(net);
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   AcceptAll
+//   Description:
+///   \brief Accept everything queued on one listening socket
+//   Parameters:
+///   @param NetworkOps *sock
+//   Return:
+///   @return int - connections accepted
+//   Notes:
+///   Readiness is edge triggered, so the queue has to be drained
+//----------------------------------------------------------------------------
+///
+
+int Listener::AcceptAll(NetworkOps *sock) {
+  int accepted = 0;
+
+  sock->SetError("");
+  for (;;) {
+    NetworkOps *conn = sock->Accept();
+    if (!conn)
+      break;
+
+    accepted++;
+    if (!m_Callback || !(*m_Callback)(conn, m_Param)) {
+      (void)conn->Disconnect();
+      delete conn;
+    }
+  }
+
+  if (!sock->GetError()->empty()) {
+    m_Mutex.Lock();
+    SetError(sock->GetError());
+    m_Mutex.Unlock();
+    if (IsDebug())
+      (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
+                                   __LINE__, sock->GetError()->c_str());
+  }
+
+  m_Mutex.Lock();
+  m_Accepted += accepted;
+  m_Mutex.Unlock();
+  return accepted;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetAccepted
+//   Description:
+///   \brief Connections accepted so far
+//   Parameters:
+//   Return:
+///   @return unsigned long
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+unsigned long Listener::GetAccepted(void) {
+  m_Mutex.Lock();
+  unsigned long accepted = m_Accepted;
+  m_Mutex.Unlock();
+  return accepted;
+}
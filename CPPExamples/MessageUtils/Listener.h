@@ -0,0 +1,84 @@
+///
+///   Listener.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __listener_h_
+#define __listener_h_
+
+#include <string>
+#include <vector>
+
+#include "EventLoop.h"
+#include "Mutex.h"
+#include "NetworkOps.h"
+
+/// Pending connection queue for each listening socket
+#define LISTENBACKLOG 128
+
+///
+/// Accept callback, handed each new connection. Return true to take
+/// ownership of it (add it to an event loop, give it to a worker thread),
+/// false to have it closed and deleted.
+///
+typedef bool (*ACCEPTCALLBACKFUNCPTR)(NetworkOps *, void *);
+
+///
+/// A listening port that stays open and accepts in a loop. With several
+/// shards the port is bound once per shard with SO_REUSEPORT, so the kernel
+/// spreads connections across them and the event loop threads accept in
+/// parallel.
+///
+class Listener {
+
+public:
+  ///
+  /// Public interface
+  ///
+  Listener();
+  ~Listener();
+
+  inline bool const IsRunning() { return !m_Sockets.empty(); }
+  inline bool const IsDebug() { return m_Debug; }
+  inline void SetDebug(bool val) { m_Debug = val; }
+  inline const std::string *GetError() { return &m_ErrorStr; }
+  inline void SetProfile(const SocketProfile &val) { m_Profile = val; }
+  inline int const GetShards() { return (int)m_Sockets.size(); }
+
+  bool Start(const std::string &, ACCEPTCALLBACKFUNCPTR, void *,
+             EventLoop *loop = 0, int shards = 1);
+  bool Stop(void);
+  int Poll(int);
+
+  unsigned long GetAccepted(void);
+
+protected:
+  ///
+  /// Protected interface
+  ///
+  void init();
+
+  inline void SetError(const std::string *err) { m_ErrorStr = *err; }
+  inline void SetError(const char *err) { m_ErrorStr = err; }
+
+private:
+  static bool AcceptEvent(NetworkOps *, int, void *);
+
+  int AcceptAll(NetworkOps *);
+
+  std::vector<NetworkOps *> m_Sockets;
+  EventLoop *m_Loop;
+  ACCEPTCALLBACKFUNCPTR m_Callback;
+  void *m_Param;
+  SocketProfile m_Profile;
+
+  Mutex m_Mutex;
+  std::string m_ErrorStr;
+  unsigned long m_Accepted;
+  bool m_Debug;
+};
+
+#endif
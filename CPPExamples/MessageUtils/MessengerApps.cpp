@@ -73,6 +73,9 @@ MessengerApps::~MessengerApps() {
 ///
 
 void MessengerApps::clear() {
+  /// Nothing may be dispatched while the sessions are torn down
+  (void)GetEventLoop()->Stop();
+
   (void)GetNetOps()->Disconnect();
   (void)GetNetOpsSSL()->Disconnect();
 
@@ -80,8 +83,6 @@ void MessengerApps::clear() {
   m_Groups.clear();
   m_Symbols.clear();
 
-  for (Chats::iterator i = m_Chats.begin(); i != m_Chats.end(); ++i)
-    delete *i;
   m_Chats.clear();
 
   return;
@@ -106,7 +107,12 @@ void MessengerApps::init() {
   m_Debug = false;
   m_DryRun = false;
   m_iConnectAttempts = 5;
+  m_EventThreads = EVENTTHREADS;
   m_Callback = 0;
+  m_ViewCallback = 0;
+  m_FastOpen = true;
+  m_Ktls = false;
+  SetSocketProfile(SocketProfile::Interactive());
   return;
 }
 
@@ -249,7 +255,7 @@ void MessengerApps::AddGroup(const std::string *grp) {
 bool MessengerApps::ChatEstablished(const std::string *contact) {
   Chats::const_iterator it;
   for (it = m_Chats.begin(); it != m_Chats.end(); it++) {
-    ChatSessions *chat = (*it);
+    ChatSessions *chat = it->get();
     if (*contact == *chat->GetWho())
       return true;
   }
@@ -339,9 +345,68 @@ bool MessengerApps::ReadConfigFile() {
   }
 
   delete tmp;
+  ReadSocketProfile();
   return true;
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReadSocketProfile
+//   Description:
+///   \brief Set the socket tuning from the config file
+//   Parameters:
+//   Return:
+//   Notes:
+///   NET_PROFILE picks a preset (interactive, bulk or none), then any of
+///   the individual NET_* keys override it. -1 leaves the system default.
+///   NET_FASTOPEN=0 turns fast open off for the switchboards.
+///   NET_TIMESTAMPS=1 stamps received data and traces chat latency.
+//----------------------------------------------------------------------------
+///
+
+void MessengerApps::ReadSocketProfile(void) {
+  SocketProfile profile = m_SocketProfile;
+
+  if (GetSymbol("NET_PROFILE")) {
+    std::string name = GetSymbol("NET_PROFILE");
+    StrUtils::Trim(name);
+    if (name == "interactive")
+      profile = SocketProfile::Interactive();
+    else if (name == "bulk")
+      profile = SocketProfile::Bulk();
+    else if (name == "none")
+      profile = SocketProfile();
+  }
+
+  struct {
+    const char *name;
+    int *value;
+  } keys[] = {{"NET_NODELAY", &profile.noDelay},
+              {"NET_QUICKACK", &profile.quickAck},
+              {"NET_SNDBUF", &profile.sendBuf},
+              {"NET_RCVBUF", &profile.recvBuf},
+              {"NET_KEEPIDLE", &profile.keepIdle},
+              {"NET_KEEPINTVL", &profile.keepIntvl},
+              {"NET_KEEPCNT", &profile.keepCnt},
+              {"NET_BUSYPOLL", &profile.busyPoll},
+              {"NET_NOTSENT_LOWAT", &profile.notSentLowat},
+              {"NET_ZEROCOPY", &profile.zeroCopy},
+              {"NET_TIMESTAMPS", &profile.rxStamps}};
+
+  for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+    if (GetSymbol(keys[i].name))
+      *keys[i].value = atoi(GetSymbol(keys[i].name));
+  }
+
+  SetSocketProfile(profile);
+
+  if (GetSymbol("NET_FASTOPEN"))
+    SetFastOpen(atoi(GetSymbol("NET_FASTOPEN")) != 0);
+  return;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
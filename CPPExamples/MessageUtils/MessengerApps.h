@@ -10,13 +10,16 @@
 #define __messengerapps_h__
 
 #include "ChatSessions.h"
+#include "EventLoop.h"
 #include "NetworkOpsSSL.h"
 
 #include <list>
 #include <map>
+#include <memory>
 #include <vector>
 
-typedef std::vector<ChatSessions *> Chats;
+/// Sessions are polymorphic and move only, so each is owned by its entry
+typedef std::vector<std::unique_ptr<ChatSessions> > Chats;
 typedef std::map<std::string, std::string> SymbolMap;
 typedef std::pair<std::string, std::string> Symbols;
 
@@ -55,6 +58,24 @@ public:
   inline void SetConnectAttempts(int val) { m_iConnectAttempts = val; }
   inline const CHATCALLBACKFUNCPTR GetFunction() { return m_Callback; }
   inline void SetFunction(CHATCALLBACKFUNCPTR val) { m_Callback = val; }
+  inline const CHATVIEWCALLBACKFUNCPTR GetViewFunction() {
+    return m_ViewCallback;
+  }
+  inline void SetViewFunction(CHATVIEWCALLBACKFUNCPTR val) {
+    m_ViewCallback = val;
+  }
+  inline EventLoop *GetEventLoop() { return &m_Events; }
+  inline int const GetEventThreads() { return m_EventThreads; }
+  inline void SetEventThreads(int val) { m_EventThreads = val; }
+  inline const SocketProfile *GetSocketProfile() { return &m_SocketProfile; }
+  inline void SetSocketProfile(const SocketProfile &val) {
+    m_SocketProfile = val;
+    m_Net.SetProfile(val);
+  }
+  inline bool const IsFastOpen() { return m_FastOpen; }
+  inline void SetFastOpen(bool val) { m_FastOpen = val; }
+  inline bool const IsKtls() { return m_Ktls; }
+  inline void SetKtls(bool val) { m_Ktls = val; }
 
   inline void SetConfigFile(const char *val) { m_configFile = val; }
   inline void SetConfigFile(std::string &val) { m_configFile = val; }
@@ -81,6 +102,7 @@ protected:
   inline void SetDryRun(bool val) { m_DryRun = val; }
 
   bool ChatEstablished(const std::string *);
+  void ReadSocketProfile(void);
 
   ///
   /// Variables
@@ -91,15 +113,30 @@ protected:
   bool m_AcceptMsg;
 
   int m_iConnectAttempts;
+  int m_EventThreads;
 
   NetworkOps m_Net;
   NetworkOpsSSL m_NetSSL;
+
+  /// Tuning given to every connection, from the NET_* config keys
+  SocketProfile m_SocketProfile;
+
+  /// TCP Fast Open for the switchboard connections
+  bool m_FastOpen;
+
+  /// Kernel TLS for the nexus and passport connections
+  bool m_Ktls;
+
   std::list<std::string> m_Users;
   std::list<std::string> m_Groups;
   std::string m_configFile;
   SymbolMap m_Symbols;
   Chats m_Chats;
   CHATCALLBACKFUNCPTR m_Callback;
+  CHATVIEWCALLBACKFUNCPTR m_ViewCallback;
+
+  /// Shared dispatcher for the connections, if m_EventThreads > 0
+  EventLoop m_Events;
 
 private:
 };
@@ -13,11 +13,14 @@
 #endif
 #include <locale.h>
 
+#include "DnsCache.h"
+#include "EventLoop.h"
 #include "Msn.h"
 #include "MsnChatSessions.h"
 #include "Msnlocale.h"
 #include "Mutex.h"
 #include "NetworkOpsSSL.h"
+#include "SslSessionCache.h"
 #include "UtilityFuncs.h"
 
 namespace {
@@ -57,6 +60,42 @@ static CALLBACKFUNC ChatCallback(void *ptrClass) {
   }
   return 0;
 }
+
+static bool ProcessEventCallback(NetworkOps *net, int events, void *ptrClass) {
+  Msn *msn = (Msn *)ptrClass;
+  (void)net;
+  return (msn) ? msn->ProcessEvents(events) : false;
+}
+
+static bool ChatEventCallback(NetworkOps *net, int events, void *ptrClass) {
+  MsnChatSessions *chat = (MsnChatSessions *)ptrClass;
+  (void)net;
+  return (chat) ? chat->ChatEvents(events) : false;
+}
+
+///
+/// Start resolving the switchboard hosts named in a batch of RNG and XFR
+/// frames, so the connects that follow find them cached
+///
+static void PrefetchHosts(const std::vector<std::string> &frames) {
+  for (size_t i = 0; i < frames.size(); i++) {
+    // RNG sessid host:port ... / XFR trid SB host:port ...
+    int field = 0;
+    if (!frames[i].compare(0, 4, "RNG "))
+      field = 2;
+    else if (!frames[i].compare(0, 4, "XFR "))
+      field = 3;
+    else
+      continue;
+
+    std::istringstream tokens(frames[i]);
+    std::string host;
+    for (int j = 0; j <= field && (tokens >> host); j++)
+      ;
+    DnsCache::Prefetch(host);
+  }
+  return;
+}
 } // namespace
 
 ///
@@ -112,6 +151,7 @@ Msn::~Msn() {
 
 void Msn::clear() {
   (void)Disconnect();
+  (void)SslSessionCache::Sync(true);
 #ifndef _WIN32
   m_Thread.Stop();
 #endif
@@ -251,6 +291,31 @@ bool Msn::ParseArgs(const int argc, const char **argv) {
           SetHostName(msnHost);
         }
       }
+      /// 0 keeps the original thread per connection model
+      if (GetSymbol("EVENT_THREADS"))
+        SetEventThreads(atoi(GetSymbol("EVENT_THREADS")));
+      /// uring asks for io_uring, falling back to epoll without it
+      if (GetSymbol("EVENT_BACKEND")) {
+        std::string backend = GetSymbol("EVENT_BACKEND");
+        StrUtils::Trim(backend);
+        GetEventLoop()->SetBackend((backend == "uring") ? EVENTBACKENDURING
+                                                        : EVENTBACKENDEPOLL);
+      }
+      /// Busy poll for this long (us) before blocking, while the account
+      /// sees at least EVENT_SPIN_RATE events a second
+      if (GetSymbol("EVENT_SPIN_US"))
+        GetEventLoop()->SetSpinUs(atoi(GetSymbol("EVENT_SPIN_US")));
+      if (GetSymbol("EVENT_SPIN_RATE"))
+        GetEventLoop()->SetSpinRate(atoi(GetSymbol("EVENT_SPIN_RATE")));
+      /// Keep TLS sessions here so logins after a restart resume them
+      if (GetSymbol("TLS_SESSION_FILE")) {
+        std::string sessionFile = GetSymbol("TLS_SESSION_FILE");
+        StrUtils::Trim(sessionFile);
+        if (!SslSessionCache::SetFile(sessionFile) && IsDebug())
+          (void)DebugUtils::LogMessage(
+              MSGINFO, "Debug: [%s,%d] Unable to read TLS sessions from %s",
+              __FILE__, __LINE__, sessionFile.c_str());
+      }
     } else
       return false;
   }
@@ -313,6 +378,8 @@ bool Msn::Connect() {
 
     // Try MSNP8 first...
     bRet = MSNP8_Login();
+    /// The nexus and passport sessions just handed over
+    (void)SslSessionCache::Sync();
     if (bRet) {
       SetProtcol(MSNP8);
       bRet = MSNSynch();
@@ -351,6 +418,10 @@ bool Msn::MSNP8_Login(void) {
   if (IsDebug())
     std::cout << "Attempting to connect to remote host..." << std::endl;
 
+  // Passport is needed once the notification server answers
+  if (!IsDryRun())
+    DnsCache::Prefetch(NEXUSHOST);
+
   // Connect to the remote host...
   if (!IsDryRun())
     bRet = GetNetOps()->Connect();
@@ -545,7 +616,7 @@ bool Msn::MSNP8_Login(void) {
     // done using a SSL connection...
 
     {
-      NetworkOpsSSL nexus("nexus.passport.com:443");
+      NetworkOpsSSL nexus(NEXUSHOST);
       if (IsDebug())
         std::cout << "Attempting to connect to nexus passport host..."
                   << std::endl;
@@ -554,6 +625,7 @@ bool Msn::MSNP8_Login(void) {
       std::string keyChain(KEYCHAIN);
       std::string passwd(KEYPWD);
 
+      nexus.SetKtls(IsKtls());
       bRet = nexus.Connect(&keyChain, &passwd);
       if (!bRet) {
         SetError(nexus.GetError());
@@ -613,6 +685,7 @@ bool Msn::MSNP8_Login(void) {
       std::string keyChain(KEYCHAIN);
       std::string passwd(KEYPWD);
 
+      nexus.SetKtls(IsKtls());
       bRet = nexus.Connect(&keyChain, &passwd);
       if (!bRet) {
         SetError(nexus.GetError());
@@ -734,6 +807,7 @@ bool Msn::MSNP8_Login(void) {
 
 bool Msn::Disconnect() {
   if (GetNetOps()) {
+    (void)GetEventLoop()->Remove(GetNetOps());
     if (IsConnected()) {
       // Setup the message
       std::string message;
@@ -924,6 +998,24 @@ bool Msn::MSNSynch(void) {
 ///
 
 bool Msn::RestartMonitor(void) {
+  if (GetEventThreads() > 0 &&
+      (GetEventLoop()->IsRunning() ||
+       GetEventLoop()->Start(GetEventThreads()))) {
+    GetEventLoop()->SetDebug(IsDebug());
+    GetNetOps()->SetBlock(false);
+    GetNetOps()->SetSocketTimeOut(5000);
+    if (GetEventLoop()->Add(GetNetOps(), ProcessEventCallback, (void *)this,
+                            EVENTREAD, MSNIDLEPING)) {
+      SetThreadState(0);
+      return true;
+    }
+  }
+
+  if (IsDebug() && GetEventThreads() > 0)
+    (void)DebugUtils::LogMessage(
+        MSGINFO, "Debug: [%s,%d] Event loop unavailable (%s), using a thread",
+        __FILE__, __LINE__, GetEventLoop()->GetError()->c_str());
+
   m_Thread.SetFunction(ProcessCallback);
   m_Thread.SetParam((void *)this);
 #ifndef _WIN32
@@ -1118,6 +1210,7 @@ bool Msn::MSNChallengeResponse(const std::string *challenge) {
 bool Msn::ProcessCalls(void) {
   bool bCont = true;
   std::string message;
+  std::vector<std::string> frames;
   int read = 0;
   int count = 0;
 
@@ -1132,58 +1225,32 @@ bool Msn::ProcessCalls(void) {
       break;
     }
 #endif
-    while (!message.empty() && (read > 0)) {
-      std::string msg2Process =
-          StrUtils::SubStr(message, 0, message.find("\r\n"));
-      std::string msnCode = StrUtils::SubStr(msg2Process, 0, message.find(" "));
-
-      if (msnCode.empty())
-        msnCode = StrUtils::SubStr(msg2Process, 0, message.find("\r"));
-      if (msnCode.empty())
-        StrUtils::Trim(message);
-      else {
-        if (msnCode == "QRY") {
-        } else if (msnCode == "CHL") {
-          // * CHL - Client challenge
-          if (!MSNChallengeResponse(&msg2Process))
-            std::cerr << GetNetOps()->GetError();
-        } else if (msnCode == "FLN") {
-          // * FLN - Principal signed off
-          std::string contacts =
-              StrUtils::SubStr(msg2Process, 5, msg2Process.length());
-          RemoveContact(&contacts);
-        } else if (msnCode == "NLN") {
-          // * NLN - Principal changed presence/signed on
-          std::string contacts =
-              StrUtils::SubStr(msg2Process, 5, msg2Process.length());
-          AddContact(&contacts);
-        } else if (msnCode == "RNG" && IsMessagesAllowed()) {
-          // * RNG - Client invited to chat session
-          // RNG sessid address authtype ticket invitepassport invitename\r\n
-          if (!MSNChat(&msg2Process))
-            std::cerr << GetNetOps()->GetError();
-        } else if (msnCode == "QNG") {
-          // * Ping response - ignore for now
-        } else {
-        }
-        message =
-            StrUtils::SubStr(message, message.find("\r\n"), message.length());
-        if (message == "\r\n")
-          message = "";
-      }
-    }
-
-    if (count > 180) {
+    for (size_t i = 0; i < frames.size(); i++)
+      ProcessMessages(frames[i]);
+    frames.clear();
+
+    ///
+    /// Check sooner when the kernel reports the connection in trouble or
+    /// replies have got slow, rather than waiting out the idle count
+    ///
+    int idleReads = MSNIDLEREADS;
+    if (count > 0 && GetNetOps()->SampleHealth() &&
+        GetNetOps()->IsDegraded())
+      idleReads = MSNDEGRADEDREADS;
+
+    if (count > idleReads) {
       // We haven't seen any data for 100 times around. Is the socket okay?
       if (IsDebug())
         (void)DebugUtils::LogMessage(MSGINFO,
                                      "Debug: [%s,%d] Doing remote socket check",
                                      __FILE__, __LINE__);
+      GetNetOps()->ReportHealth();
 
       if (!MSNPing(&message)) {
         // Oh dear, the socket seems to have gone south for the winter...
         bCont = false;
       }
+      (void)SslSessionCache::Sync();
       if (IsDebug())
         (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] Socket seems %s",
                                      __FILE__, __LINE__,
@@ -1193,16 +1260,20 @@ bool Msn::ProcessCalls(void) {
 
     // If I read a message as a result of my ping - process it
     if (count == -1 && !message.empty()) {
+      ProcessMessages(message);
+      read = 0;
     } else {
-      if (!GetNetOps()->GetBinMsg(&read, message))
+      if (!GetNetOps()->GetFrames(MsnUtils::MSNFrameLen, frames))
         bCont = false;
+      PrefetchHosts(frames);
+      read = (int)frames.size();
     }
 
     if (read > 0) {
       count = 0;
       if (IsDebug())
-        (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
-                                     __LINE__, message.c_str());
+        (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %d frames",
+                                     __FILE__, __LINE__, read);
     } else
       count++;
   }
@@ -1210,6 +1281,130 @@ bool Msn::ProcessCalls(void) {
   return true;
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ProcessMessages
+//   Description:
+///   \brief Process the notification server commands held in a buffer
+//   Parameters:
+///   @param std::string &message - consumed as it is processed
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void Msn::ProcessMessages(std::string &message) {
+  while (!message.empty()) {
+    std::string msg2Process =
+        StrUtils::SubStr(message, 0, message.find("\r\n"));
+    std::string msnCode = StrUtils::SubStr(msg2Process, 0, message.find(" "));
+
+    if (msnCode.empty())
+      msnCode = StrUtils::SubStr(msg2Process, 0, message.find("\r"));
+    if (msnCode.empty())
+      StrUtils::Trim(message);
+    else {
+      if (msnCode == "QRY") {
+      } else if (msnCode == "CHL") {
+        // * CHL - Client challenge
+        if (!MSNChallengeResponse(&msg2Process))
+          std::cerr << GetNetOps()->GetError();
+      } else if (msnCode == "FLN") {
+        // * FLN - Principal signed off
+        std::string contacts =
+            StrUtils::SubStr(msg2Process, 5, msg2Process.length());
+        RemoveContact(&contacts);
+      } else if (msnCode == "NLN") {
+        // * NLN - Principal changed presence/signed on
+        std::string contacts =
+            StrUtils::SubStr(msg2Process, 5, msg2Process.length());
+        AddContact(&contacts);
+      } else if (msnCode == "RNG" && IsMessagesAllowed()) {
+        // * RNG - Client invited to chat session
+        // RNG sessid address authtype ticket invitepassport invitename\r\n
+        if (!MSNChat(&msg2Process))
+          std::cerr << GetNetOps()->GetError();
+      } else if (msnCode == "QNG") {
+        // * Ping response - ignore for now
+      } else if (msnCode == "MSG") {
+        // * MSG - server message, skip the header and its payload
+        int payLoad = MsnUtils::MSNGetPayload(msg2Process);
+        if (payLoad > 0) {
+          message = StrUtils::SubStr(message, payLoad, message.length());
+          continue;
+        }
+      } else {
+      }
+      message =
+          StrUtils::SubStr(message, message.find("\r\n"), message.length());
+      if (message == "\r\n")
+        message = "";
+    }
+  }
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ProcessEvents
+//   Description:
+///   \brief Service the notification server from an event loop callback
+//   Parameters:
+///   @param int events - EVENT* flags
+//   Return:
+///   @return bool - false once the connection is no longer usable
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool Msn::ProcessEvents(int events) {
+  std::string message;
+  std::vector<std::string> frames;
+
+  if (events & EVENTREAD) {
+    while (GetNetOps()->GetFrames(MsnUtils::MSNFrameLen, frames, false) &&
+           !frames.empty()) {
+      PrefetchHosts(frames);
+      for (size_t i = 0; i < frames.size(); i++) {
+        if (IsDebug())
+          (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
+                                       __LINE__, frames[i].c_str());
+        ProcessMessages(frames[i]);
+      }
+    }
+  }
+
+  if (events & EVENTTIMEOUT) {
+    // Nothing seen for a while. Is the socket okay?
+    if (IsDebug())
+      (void)DebugUtils::LogMessage(MSGINFO,
+                                   "Debug: [%s,%d] Doing remote socket check",
+                                   __FILE__, __LINE__);
+    if (GetNetOps()->SampleHealth(true))
+      GetNetOps()->ReportHealth();
+    if (!MSNPing(&message)) {
+      SetThreadState(-1);
+      return false;
+    }
+    ProcessMessages(message);
+    (void)SslSessionCache::Sync();
+  }
+
+  if ((events & EVENTHANGUP) || GetNetOps()->IsPeerClosed()) {
+    if (IsDebug())
+      (void)DebugUtils::LogMessage(
+          MSGINFO, "Debug: [%s,%d] Notification server closed the connection",
+          __FILE__, __LINE__);
+    SetThreadState(-1);
+    return false;
+  }
+  return true;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -1435,6 +1630,8 @@ bool Msn::MSNChat(const std::string *ptr) {
   sbRemoteHost->SetDebug(IsDebug());
   sbRemoteHost->SetDryRun(IsDryRun());
   sbRemoteHost->GetNetOps()->SetNonBlocking(true);
+  sbRemoteHost->GetNetOps()->SetProfile(*GetSocketProfile());
+  sbRemoteHost->GetNetOps()->SetFastOpen(IsFastOpen() && !IsDryRun());
   sbRemoteHost->GetNetOps()->SetDebug(IsDebug());
 
   if (!sbRemoteHost->GetNetOps()->Connect()) {
@@ -1478,12 +1675,42 @@ bool Msn::MSNChat(const std::string *ptr) {
   sbRemoteHost->SetReply2RemoteChat(true);
   if (GetFunction())
     sbRemoteHost->SetFunction(GetFunction());
-  (void)sbRemoteHost->StartChat();
+  if (GetViewFunction())
+    sbRemoteHost->SetViewFunction(GetViewFunction());
+  (void)LaunchChat(sbRemoteHost);
 
-  GetChats()->push_back(sbRemoteHost);
+  GetChats()->push_back(std::unique_ptr<ChatSessions>(sbRemoteHost));
   return true;
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   LaunchChat
+//   Description:
+///   \brief Hand a connected chat to the event loop, or its own thread
+//   Parameters:
+///   @param MsnChatSessions *chat
+//   Return:
+///   @return bool
+//   Notes:
+///   Switchboard connections are long lived and only ever serviced by the
+///   loop, so on io_uring the loop does their reads and writes too
+//----------------------------------------------------------------------------
+///
+
+bool Msn::LaunchChat(MsnChatSessions *chat) {
+  if (GetEventLoop()->IsRunning()) {
+    chat->ChatOpen();
+    if (GetEventLoop()->Add(chat->GetNetOps(), ChatEventCallback,
+                            (void *)chat, EVENTREAD | EVENTLOOPIO))
+      return true;
+    chat->SetChatStarted(false);
+  }
+  return (chat->StartChat() == 0);
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -1564,6 +1791,8 @@ bool Msn::StartChat(const std::string *who) {
   sbRemoteHost->SetDebug(IsDebug());
   sbRemoteHost->SetDryRun(IsDryRun());
   sbRemoteHost->GetNetOps()->SetNonBlocking(true);
+  sbRemoteHost->GetNetOps()->SetProfile(*GetSocketProfile());
+  sbRemoteHost->GetNetOps()->SetFastOpen(IsFastOpen() && !IsDryRun());
 
   if (!sbRemoteHost->GetNetOps()->Connect()) {
     SetError(sbRemoteHost->GetNetOps()->GetError());
@@ -1716,8 +1945,10 @@ bool Msn::StartChat(const std::string *who) {
   sbRemoteHost->SetReply2RemoteChat(false);
   if (GetFunction())
     sbRemoteHost->SetFunction(GetFunction());
-  (void)sbRemoteHost->StartChat();
+  if (GetViewFunction())
+    sbRemoteHost->SetViewFunction(GetViewFunction());
+  (void)LaunchChat(sbRemoteHost);
 
-  GetChats()->push_back(sbRemoteHost);
+  GetChats()->push_back(std::unique_ptr<ChatSessions>(sbRemoteHost));
   return true;
 }
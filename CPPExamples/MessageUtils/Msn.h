@@ -13,6 +13,8 @@
 #include "MsnConstants.h"
 #include <cstring>
 
+class MsnChatSessions;
+
 class Msn : public MessengerApps {
 
 public:
@@ -58,6 +60,7 @@ public:
   bool MD5Calc(const std::string *, std::string *);
   bool MSNChallengeResponse(const std::string *);
   bool ProcessCalls(void);
+  bool ProcessEvents(int);
   bool StartChat(const std::string *);
   bool StartChat(const char *);
   bool SetSwitchboardStatus(bool);
@@ -85,6 +88,8 @@ private:
   inline void SetProtcol(int val) { m_Protocol = val; }
   void ParseGrpAndUsrs(const std::string *);
   bool MSNChat(const std::string *);
+  void ProcessMessages(std::string &);
+  bool LaunchChat(MsnChatSessions *);
 
   int m_Protocol;
   int m_TriId;
@@ -17,9 +17,11 @@
 
 #include <sys/stat.h>
 
+#include "EventLoop.h"
 #include "FileTransferRequests.h"
 #include "Msn.h"
 #include "MsnChatSessions.h"
+#include "MsnFtpServer.h"
 #include "Threads.h"
 #include "UtilityFuncs.h"
 
@@ -44,27 +46,9 @@ MsnChatSessions::MsnChatSessions(const std::string *hostName, int protocol) {
   SetProtocol(protocol);
 }
 
-MsnChatSessions::MsnChatSessions(const MsnChatSessions &val) {
-  init();
-  m_SessionId = val.m_SessionId;
-  m_Net = val.m_Net;
-  m_Thread = val.m_Thread;
-  m_Debug = val.m_Debug;
-  m_DryRun = val.m_DryRun;
-  m_Reply2RemoteChat = val.m_Reply2RemoteChat;
-  m_Started = val.m_Started;
-  m_ErrorStr = val.m_ErrorStr;
-  m_WhoAlias = val.m_WhoAlias;
-  m_Who = val.m_Who;
-  m_WhoAmI = val.m_WhoAmI;
-  m_WhoAmIAlias = val.m_WhoAmIAlias;
-
-  m_UserCallback = val.m_UserCallback;
-  m_SystemCallback = val.m_SystemCallback;
-
-  m_TriId = val.m_TriId;
-  m_TriIdStr = val.m_TriIdStr;
-  m_Protocol = val.m_Protocol;
+MsnChatSessions::MsnChatSessions(MsnChatSessions &&val) noexcept
+    : ChatSessions(std::move(val)) {
+  TakeMsn(val);
 }
 
 ///
@@ -81,30 +65,12 @@ MsnChatSessions::MsnChatSessions(const MsnChatSessions &val) {
 ///
 
 // Overloading the = operator
-MsnChatSessions &MsnChatSessions::operator=(const MsnChatSessions &val) {
+MsnChatSessions &MsnChatSessions::operator=(MsnChatSessions &&val) noexcept {
   if (this == &val)
     return *this;
 
-  m_SessionId = val.m_SessionId;
-  m_Net = val.m_Net;
-  m_Thread = val.m_Thread;
-  m_Debug = val.m_Debug;
-  m_DryRun = val.m_DryRun;
-  m_Reply2RemoteChat = val.m_Reply2RemoteChat;
-  m_Started = val.m_Started;
-  m_ErrorStr = val.m_ErrorStr;
-  m_WhoAlias = val.m_WhoAlias;
-  m_Who = val.m_Who;
-  m_WhoAmI = val.m_WhoAmI;
-  m_WhoAmIAlias = val.m_WhoAmIAlias;
-
-  m_UserCallback = val.m_UserCallback;
-  m_SystemCallback = val.m_SystemCallback;
-
-  m_TriId = val.m_TriId;
-  m_TriIdStr = val.m_TriIdStr;
-  m_Protocol = val.m_Protocol;
-
+  ChatSessions::operator=(std::move(val));
+  TakeMsn(val);
   return *this;
 }
 
@@ -161,6 +127,37 @@ void MsnChatSessions::init() {
   ChatSessions::init();
   m_TriId = 1;
   m_Protocol = 0;
+  m_Trace = MsgTrace();
+  m_Traces.clear();
+  m_Traced = 0;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///  TakeMsn
+//   Description:
+///  \brief Take over another session's MSN details
+//   Parameters:
+///  @param MsnChatSessions &val
+//   Return:
+//   Notes:
+///  The base class has already taken the connection and thread
+//----------------------------------------------------------------------------
+///
+
+void MsnChatSessions::TakeMsn(MsnChatSessions &val) noexcept {
+  m_TriId = val.m_TriId;
+  m_TriIdStr.swap(val.m_TriIdStr);
+  m_Protocol = val.m_Protocol;
+  m_Trace = val.m_Trace;
+  m_Traces.swap(val.m_Traces);
+  m_Traced = val.m_Traced;
+
+  val.m_Trace = MsgTrace();
+  val.m_Traced = 0;
   return;
 }
 
@@ -194,6 +191,10 @@ bool MsnChatSessions::Disconnect() {
 
   GetNetOps()->Disconnect();
 
+  if (m_Traced > 0) {
+    LatencyTrace::Report();
+    m_Traced = 0;
+  }
   return true;
 }
 
@@ -358,37 +359,28 @@ const std::string *MsnChatSessions::GetNTriId() {
 //   Description:
 ///   \brief Process a MSG
 //   Parameters:
-///	  @param std::string &ptrMessage
+///	  @param const BufSlice &frame - the MSG line and its payload
 //   Return:
 ///   @return bool
 //   Notes:
 //----------------------------------------------------------------------------
 ///
 
-bool MsnChatSessions::ProcessMsg(std::string &ptrMessage) {
-  std::string message = ptrMessage;
+bool MsnChatSessions::ProcessMsg(const BufSlice &frame) {
   bool bCode = false;
   std::string line;
   bool bMess = true;
 
   if (IsDebug())
-    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] message='%s'",
-                                 __FILE__, __LINE__, message.c_str());
-
-  MsnUtils::MSNParseChatLine(message, line, true);
-  if (IsDebug())
-    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s %s", __FILE__,
-                                 __LINE__, message.c_str(), line.c_str());
-
-  int payLoad = MsnUtils::MSNGetPayload(line);
-  line = message;
-  MSNChatMsg ChatLine(line, payLoad);
-  message = StrUtils::SubStr(message, payLoad, message.length());
+    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] message='%.*s'",
+                                 __FILE__, __LINE__, (int)frame.size(),
+                                 frame.data());
 
-  line = "";
+  MSNChatMsg ChatLine(frame);
+  m_Trace.Stamp(TRACEPARSED);
 
   ///   Do the message callback
-  if (ChatLine.IsChat() && ChatLine.GetMsg()->empty()) {
+  if (ChatLine.IsChat() && ChatLine.GetText()->empty()) {
     ///
     /// Chat line - ignore
     ///
@@ -434,15 +426,21 @@ bool MsnChatSessions::ProcessMsg(std::string &ptrMessage) {
     ///
     int retCode = 0;
     bool ret = false;
-    CHATCALLBACKFUNCPTR cb = GetFunction();
+    CHATVIEWCALLBACKFUNCPTR viewCb = GetViewFunction();
     CHATCALLBACKSYSFUNCPTR sysCb = GetSystemFunction();
+    const BufSlice *text = ChatLine.GetText();
     line = "";
-    std::string mess = *ChatLine.GetMsg();
-    ret = (*sysCb)(mess, line, &retCode, MSN, (void *)this);
-    if (retCode == 0)
-      ret = (*cb)(mess, line, &retCode);
+    ret = (*sysCb)(*text, line, &retCode, MSN, (void *)this);
+    if (retCode == 0 && viewCb)
+      ret = (*viewCb)(*text, line, &retCode);
+    else if (retCode == 0) {
+      ///   Older callbacks get their own copy, which they may change
+      std::string mess = text->str();
+      ret = (*GetFunction())(mess, line, &retCode);
+    }
     if (!ret)
       bMess = false;
+    m_Trace.Stamp(TRACEHANDLED);
   }
 
   if (bMess && !line.empty()) {
@@ -468,8 +466,9 @@ bool MsnChatSessions::ProcessMsg(std::string &ptrMessage) {
       (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
                                    __LINE__, response.c_str());
 
+    ///   Queued, so all the replies to one batch go out together
     if (!IsDryRun())
-      bCode = GetNetOps()->Talk(&response, NULL);
+      bCode = GetNetOps()->PostMsg(response);
     else
       bCode = true;
 
@@ -478,15 +477,68 @@ bool MsnChatSessions::ProcessMsg(std::string &ptrMessage) {
       if (IsDebug())
         (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
                                      __LINE__, GetError()->c_str());
-      ptrMessage = message;
       return bCode;
     }
+
+    ///   Timed to the reply once it has been written
+    if (m_Trace.IsActive())
+      m_Traces.push_back(m_Trace);
+    m_Trace = MsgTrace();
+  }
+
+  if (m_Trace.IsActive()) {
+    LatencyTrace::Record(m_Trace);
+    m_Traced++;
+    m_Trace = MsgTrace();
   }
 
-  ptrMessage = message;
   return bCode;
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BeginTrace
+//   Description:
+///   \brief Start tracing a frame as it is picked up for processing
+//   Parameters:
+///   @param long long arrived - kernel receive time, 0 if not stamped
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void MsnChatSessions::BeginTrace(long long arrived) {
+  m_Trace = MsgTrace(arrived);
+  m_Trace.Stamp(TRACEFRAMED);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   EndTraces
+//   Description:
+///   \brief Finish the traces of messages whose replies have gone out
+//   Parameters:
+//   Return:
+//   Notes:
+///   Only called once the outbound queue has been written
+//----------------------------------------------------------------------------
+///
+
+void MsnChatSessions::EndTraces(void) {
+  for (size_t i = 0; i < m_Traces.size(); i++) {
+    m_Traces[i].Stamp(TRACEREPLIED);
+    LatencyTrace::Record(m_Traces[i]);
+  }
+  m_Traced += m_Traces.size();
+  m_Traces.clear();
+  return;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -495,41 +547,32 @@ bool MsnChatSessions::ProcessMsg(std::string &ptrMessage) {
 //   Description:
 ///   Do a chat line
 //   Parameters:
+///   @param const BufSlice &frame
 //   Return:
 //   Notes:
 //----------------------------------------------------------------------------
 ///
 
-int MsnChatSessions::DoAChat(std::string *ptrMessage) {
-  std::string message = *ptrMessage;
-
+int MsnChatSessions::DoAChat(const BufSlice &frame) {
   if (IsDebug())
-    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
-                                 __LINE__, message.c_str());
+    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %.*s", __FILE__,
+                                 __LINE__, (int)frame.size(), frame.data());
 
   int bRet = 0;
+  size_t pos = 0;
 
-  std::string line;
   ///
   /// Process the messages I have...
   ///
-  while (!message.empty()) {
-    MsnUtils::MSNParseChatLine(message, line, true);
-    MSNChatMsg msg(line);
-    std::string msgcode;
-    msg.GetMsgCode(msgcode);
+  while (pos < frame.size() && bRet == 0) {
+    BufSlice message = frame.Sub(pos);
+    size_t eol = message.Find('\n');
+    size_t len = (eol == BufSlice::npos) ? message.size() : eol + 1;
 
-    if (IsDebug())
-      (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] msgcode = %s '%s'",
-                                   __FILE__, __LINE__, msgcode.c_str(),
-                                   message.c_str());
-
-    if (msgcode == "BYE") {
+    if (message.IsToken("BYE")) {
       ///
       /// Process BYE
       ///
-      /// Did you mean me?
-      std::string bye = "BYE ";
       /// Woops, looks like MSN killed me
       /// time to commit suicide
       if (IsDebug())
@@ -540,13 +583,16 @@ int MsnChatSessions::DoAChat(std::string *ptrMessage) {
 
       bRet = 2;
       GetThread()->Stop();
-    } else if (msgcode == "MSG") {
+    } else if (message.IsToken("MSG")) {
       ///
-      /// Process MSG codes
+      /// Process MSG codes, the payload included
       ///
-      ProcessMsg(message);
-    } else
-      MsnUtils::MSNParseChatLine(message, line);
+      int msgLen = MsnUtils::MSNFrameLen(message.data(), (int)message.size());
+      if (msgLen > 0)
+        len = msgLen;
+      ProcessMsg(message.Sub(0, len));
+    }
+    pos += len;
   }
 
   return bRet;
@@ -556,21 +602,16 @@ int MsnChatSessions::DoAChat(std::string *ptrMessage) {
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   Chat
+///   ChatOpen
 //   Description:
-///   Start and detach the chat session
+///   \brief Mark the chat as started and say hello if I started it
 //   Parameters:
 //   Return:
 //   Notes:
 //----------------------------------------------------------------------------
 ///
 
-bool MsnChatSessions::Chat() {
-  int read = 0;
-  bool bRet = true;
-  std::string message;
-  std::string responses;
-
+void MsnChatSessions::ChatOpen() {
   /// Signal that a chat has started
   SetChatStarted(true);
 
@@ -578,6 +619,7 @@ bool MsnChatSessions::Chat() {
 
   /// Send an initial hello message...
   if (!IsReply2RemoteChat()) {
+    std::string message;
     std::string myReply(CLIENTAPP);
     myReply += " ";
     myReply += CLIENTAPPVRS;
@@ -593,6 +635,85 @@ bool MsnChatSessions::Chat() {
     if (!IsDryRun())
       (void)GetNetOps()->Talk(&message, NULL);
   }
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ChatEvents
+//   Description:
+///   \brief Service the chat from an event loop callback
+//   Parameters:
+///   @param int events - EVENT* flags
+//   Return:
+///   @return bool - false once the session is finished
+//   Notes:
+///   Drains everything pending, as the loop only reports new data once.
+//----------------------------------------------------------------------------
+///
+
+bool MsnChatSessions::ChatEvents(int events) {
+  std::vector<BufSlice> frames;
+  std::vector<long long> stamps;
+
+  if (events & EVENTREAD) {
+    while (GetNetOps()->IsConnected() &&
+           GetNetOps()->GetFrames(MsnUtils::MSNFrameLen, frames, false,
+                                  &stamps) &&
+           !frames.empty()) {
+      for (size_t i = 0; i < frames.size(); i++) {
+        if (IsDebug())
+          (void)DebugUtils::LogMessage(
+              MSGINFO, "Debug: [%s,%d] %.*s", __FILE__, __LINE__,
+              (int)frames[i].size(), frames[i].data());
+
+        BeginTrace(stamps[i]);
+        if (DoAChat(frames[i]) == 2)
+          return false;
+      }
+    }
+  }
+
+  if (GetNetOps()->HasQueuedMsgs() && GetNetOps()->FlushMsgs() < 0)
+    events |= EVENTHANGUP;
+  if (!GetNetOps()->HasQueuedMsgs())
+    EndTraces();
+
+  if ((events & EVENTHANGUP) || !GetNetOps()->IsConnected() ||
+      GetNetOps()->IsPeerClosed()) {
+    if (IsDebug())
+      (void)DebugUtils::LogMessage(
+          MSGINFO, "Debug: [%s,%d] Chat connection closed", __FILE__, __LINE__);
+    SetChatStarted(false);
+    GetNetOps()->Disconnect();
+    return false;
+  }
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Chat
+//   Description:
+///   Start and detach the chat session
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool MsnChatSessions::Chat() {
+  bool bRet = true;
+  std::string message;
+  std::string responses;
+  std::vector<BufSlice> frames;
+  std::vector<long long> stamps;
+
+  ChatOpen();
 
   message = "";
 
@@ -603,18 +724,22 @@ bool MsnChatSessions::Chat() {
       break;
     }
 #endif
-    if (GetNetOps()->GetBinMsg(&read, message)) {
-      if (read == 0 || message.empty())
-        continue;
-
-      if (IsDebug())
-        (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
-                                     __LINE__, message.c_str());
-
-      read = DoAChat(&message);
-
-      if (read == 2)
-        bRet = false;
+    if (GetNetOps()->GetFrames(MsnUtils::MSNFrameLen, frames, true,
+                               &stamps)) {
+      for (size_t i = 0; i < frames.size() && bRet; i++) {
+        if (IsDebug())
+          (void)DebugUtils::LogMessage(
+              MSGINFO, "Debug: [%s,%d] %.*s", __FILE__, __LINE__,
+              (int)frames[i].size(), frames[i].data());
+
+        BeginTrace(stamps[i]);
+        if (DoAChat(frames[i]) == 2)
+          bRet = false;
+      }
+      if (bRet && GetNetOps()->HasQueuedMsgs())
+        (void)GetNetOps()->FlushMsgs(true);
+      if (!GetNetOps()->HasQueuedMsgs())
+        EndTraces();
     }
   }
 
@@ -866,11 +991,10 @@ bool MsnChatSessions::ProcessFileRequest(MSNChatMsg &ChatLine) {
     istr = GetNetOps()->GetHostIPAddr(istr);
   payLoad += istr;
   payLoad += "\r\n";
-  payLoad += "Port: 6891";
+  payLoad += "Port: " MSNFTPPORT;
   payLoad += "\r\nAuthCookie: ";
-  srand(time(NULL));
-  int cookieAuth =
-      (rand() % 20000 + 120); /// random number between 120 and 20120
+  /// Unique among the transfers waiting on the shared MSNFTP port
+  int cookieAuth = MsnFtpServer::NewCookie();
 
   StrUtils::i2str(cookieAuth, istr);
   payLoad += istr;
@@ -900,6 +1024,7 @@ bool MsnChatSessions::ProcessFileRequest(MSNChatMsg &ChatLine) {
     bRet = true;
 
   if (!bRet) {
+    MsnFtpServer::Release(cookieAuth);
     SetError(GetNetOps()->GetError());
     return bRet;
   }
@@ -910,59 +1035,24 @@ bool MsnChatSessions::ProcessFileRequest(MSNChatMsg &ChatLine) {
 
   Disconnect();
 
-  /// Start a network server
+  /// The MSNFTP port stays open, the peer is matched by its auth cookie
   NetworkOps fileServer;
-  fileServer.SetService("6891");
   fileServer.SetDebug(IsDebug());
-
-  if (!fileServer.StartServer(2)) {
-    SetError(fileServer.GetError());
-    fileServer.Disconnect();
-    return false;
-  }
+  /// Zero copy is configured with the rest of the connection tuning
+  SocketProfile profile = SocketProfile::Bulk();
+  profile.zeroCopy = GetNetOps()->GetProfile()->zeroCopy;
 
   if (IsDebug())
     (void)DebugUtils::LogMessage(
         MSGINFO, "Debug: [%s,%d] Waiting for a connection", __FILE__, __LINE__);
 
-  if (!fileServer.AcceptSingleConnection()) {
-    SetError(fileServer.GetError());
-    fileServer.Disconnect();
-    return false;
-  }
-
-  if (IsDebug())
-    (void)DebugUtils::LogMessage(
-        MSGINFO, "Debug: [%s,%d] Waiting for a message", __FILE__, __LINE__);
-
-  message = "";
-  /// Wait for a message from the client
-  if (!IsDryRun())
-    bRet = fileServer.Talk(&message, &responses);
-  else
-    bRet = true;
-
-  if (IsDebug())
-    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
-                                 __LINE__, responses.c_str());
-
-  if (responses.find("VER MSNFTP") == std::string::npos || !bRet) {
-    /// Message was invalid - goodbye
-    if (!bRet)
-      SetError(" - The client sent an invalid request and was disconnected");
-    else
-      SetError(fileServer.GetError());
-    fileServer.Disconnect();
-
+  std::string errMsg;
+  if (!MsnFtpServer::WaitPeer(cookieAuth, profile, fileServer, responses,
+                              errMsg)) {
+    SetError(&errMsg);
     return false;
   }
-
-  message = "VER MSNFTP\r\n";
-  /// Wait for a message from the client
-  if (!IsDryRun())
-    bRet = fileServer.Talk(&message, &responses);
-  else
-    bRet = true;
+  bRet = true;
 
   if (IsDebug())
     (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] %s", __FILE__,
@@ -1075,57 +1165,33 @@ bool MsnChatSessions::ProcessFileRequest(MSNChatMsg &ChatLine) {
   }
 
   int filesz = request.GetFileSz();
-  int fileTransferred = 0;
-  char *toTransfer = (char *)calloc(
-      (MSNFTPPACKSIZ + 3), sizeof(char)); /// Allocate memory for the transfer
 
   if (IsDebug())
     (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] Transferring %d",
                                  __FILE__, __LINE__, filesz);
 
-  while (fileTransferred < filesz) /// Repeat while something to do
-  {
-    int i = 0;
-    int packetsz = (filesz - fileTransferred);
-    if (packetsz > MSNFTPPACKSIZ)
-      packetsz = MSNFTPPACKSIZ;
-
-    /// Packet size has a header of 3 bytes
-    toTransfer[i++] = (char)0x00; /// First byte = 0
-    toTransfer[i++] =
-        (char)(packetsz & 0x00FF); /// Second byte = (packet_size MOD 255)
-    toTransfer[i++] = (char)((packetsz & 0xff00) >>
-                             8); /// Third byte = (packet_size MOD 65280)
-
-    if (IsDebug())
-      (void)DebugUtils::LogMessage(MSGINFO,
-                                   "Debug: [%s,%d] Transferring %d of %d",
-                                   __FILE__, __LINE__, fileTransferred, filesz);
-
-    if (read(fileNo, &toTransfer[i], packetsz) < 0) {
-      free(toTransfer);
-      SetError(" - An error occurred reading the file for transfer");
-      fileServer.Disconnect();
-      return false;
-    }
-
-    /// Send the message -
-    if (!fileServer.SendBinMsg(&toTransfer[0], packetsz + MSNFTPPACKHDR)) {
-      free(toTransfer);
-      SetError(" - An error occurred transferring the file");
-      fileServer.Disconnect();
-      return false;
-    }
+  /// Each packet is a 3 byte header then up to MSNFTPPACKSIZ bytes of file
+  long long started = NetworkOps::GetTimeMs();
+  long long sent = fileServer.SendFile(fileNo, 0, filesz, MSNFTPPACKSIZ,
+                                       MsnUtils::MSNFTPHeader);
+  long long elapsed = NetworkOps::GetTimeMs() - started;
+  (void)close(fileNo);
 
-    fileTransferred += packetsz;
+  if (sent != filesz) {
+    std::string errMsg(" - An error occurred transferring the file ");
+    errMsg += *fileServer.GetError();
+    SetError(&errMsg);
+    fileServer.Disconnect();
+    return false;
   }
 
   if (IsDebug())
-    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] Transfer done",
-                                 __FILE__, __LINE__);
-
-  (void)close(fileNo);
-  free(toTransfer);
+    (void)DebugUtils::LogMessage(
+        MSGINFO, "Debug: [%s,%d] Transfer done, %lld bytes in %lldms "
+                 "(%.1f MB/s), %llu zero copy, %llu copied",
+        __FILE__, __LINE__, sent, elapsed,
+        (elapsed > 0) ? (sent / 1048576.0) / (elapsed / 1000.0) : 0.0,
+        fileServer.GetZeroCopyBytes(), fileServer.GetCopiedBytes());
 
   /// I sent the file - what happened to it?
   message = "";
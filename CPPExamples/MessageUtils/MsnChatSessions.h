@@ -10,9 +10,12 @@
 #define __msnchatsessions_h_
 
 #include "ChatSessions.h"
+#include "LatencyTrace.h"
 #include "MsnConstants.h"
 #include "MsnMsg.h"
 
+#include <vector>
+
 class MsnChatSessions : public ChatSessions {
 
 public:
@@ -21,11 +24,16 @@ public:
   ///
   MsnChatSessions();
   MsnChatSessions(const std::string *, int);
-  MsnChatSessions(const MsnChatSessions &);
+  MsnChatSessions(MsnChatSessions &&) noexcept;
   ~MsnChatSessions();
 
+  MsnChatSessions(const MsnChatSessions &) = delete;
+  MsnChatSessions &operator=(const MsnChatSessions &) = delete;
+
   bool Disconnect(void);
   bool Chat(void);
+  void ChatOpen(void);
+  bool ChatEvents(int);
   bool FileTransfer(const std::string &);
   bool FileTransfer(const char *);
 
@@ -38,7 +46,7 @@ public:
   ///
 
   /// Overloading the = operator
-  MsnChatSessions &operator=(const MsnChatSessions &other);
+  MsnChatSessions &operator=(MsnChatSessions &&other) noexcept;
 
 protected:
   ///
@@ -56,15 +64,24 @@ private:
   void FormatChatMsg(const char *, std::string &);
   void FormatChatMsg(MSNChatMsg &, std::string &);
   int noMsgs2Process(std::string *, std::string *);
-  int DoAChat(std::string *);
-  bool ProcessMsg(std::string &);
+  int DoAChat(const BufSlice &);
+  bool ProcessMsg(const BufSlice &);
   bool FileTransferMsnp8(const std::string &);
   bool ProcessFileRequest(MSNChatMsg &);
+  void BeginTrace(long long);
+  void EndTraces(void);
+  void TakeMsn(MsnChatSessions &) noexcept;
   ///
   ///
   int m_TriId;
   std::string m_TriIdStr;
   int m_Protocol;
+
+  /// Latency trace of the message being processed, and of those whose
+  /// replies are still queued
+  MsgTrace m_Trace;
+  std::vector<MsgTrace> m_Traces;
+  unsigned long m_Traced;
 };
 
 #endif
\ No newline at end of file
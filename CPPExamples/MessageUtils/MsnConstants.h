@@ -9,6 +9,7 @@
 #ifndef __msnconstants_h__
 #define __msnconstants_h__
 
+#define NEXUSHOST "nexus.passport.com:443"
 #define NEXUSLOGINKEY "DALogin="
 #define NEXUSAUTHKEY "Authentication-Info:"
 #define NEXUSAUTHKEYALT "WWW-Authenticate:"
@@ -19,6 +20,14 @@
 /// Supported MSN protocols
 #define MSNP8 1
 
+/// Ping the notification server after this long without traffic (ms)
+#define MSNIDLEPING 360000
+
+/// Empty reads before the polling thread checks the connection, and the
+/// fewer it allows once the connection looks degraded
+#define MSNIDLEREADS 180
+#define MSNDEGRADEDREADS 15
+
 /// File transfer keys
 #define MSNP8_FILEACC "\r\nInvitation-Command: ACCEPT\r\n"
 #define MSNFTPPACKSIZ 2045
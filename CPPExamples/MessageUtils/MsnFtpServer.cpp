@@ -0,0 +1,357 @@
+///
+///   MsnFtpServer.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "MsnFtpServer.h"
+#include "UtilityFuncs.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+Listener MsnFtpServer::m_Listener;
+Mutex MsnFtpServer::m_Mutex;
+Mutex MsnFtpServer::m_PollMutex;
+std::set<int> MsnFtpServer::m_Issued;
+std::set<int> MsnFtpServer::m_Waiting;
+std::map<int, MsnFtpServer::FtpPeer> MsnFtpServer::m_Peers;
+unsigned long MsnFtpServer::m_Matched = 0;
+std::mt19937 MsnFtpServer::m_Random;
+bool MsnFtpServer::m_Seeded = false;
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   NewCookie
+//   Description:
+///   \brief Issue an auth cookie for a transfer's invitation
+//   Parameters:
+//   Return:
+///   @return int - not issued to, or waited on by, any other transfer
+//   Notes:
+///   Pass it to WaitPeer, or to Release if the invitation is not sent. A
+///   peer that connects with it before WaitPeer is called is kept for it.
+//----------------------------------------------------------------------------
+///
+
+int MsnFtpServer::NewCookie(void) {
+  int cookie = 0;
+
+  m_Mutex.Lock();
+  if (!m_Seeded) {
+    std::random_device seed;
+    m_Random.seed(seed());
+    m_Seeded = true;
+  }
+  do {
+    cookie = MSNFTPCOOKIEMIN + (int)(m_Random() % MSNFTPCOOKIERANGE);
+  } while (m_Issued.count(cookie) || m_Waiting.count(cookie));
+  m_Issued.insert(cookie);
+  m_Mutex.Unlock();
+  return cookie;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Release
+//   Description:
+///   \brief Give back a cookie from NewCookie that will not be waited on
+//   Parameters:
+///   @param int cookie
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void MsnFtpServer::Release(int cookie) {
+  Forget(cookie);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WaitPeer
+//   Description:
+///   \brief Wait for the peer invited with an auth cookie to connect
+//   Parameters:
+///   @param int cookie - the AuthCookie sent with the invitation, from
+///          NewCookie
+///   @param const SocketProfile &profile - for the listener, when it is
+///          started by this call
+///   @param NetworkOps &fileServer - given the peer's connection
+///   @param std::string &usrLine - the peer's USR line
+///   @param std::string &errMsg - set on failure
+//   Return:
+///   @return bool - false if the listener could not be started, the cookie
+///   is already being waited on, or the peer did not turn up within
+///   MSNFTPCONNECTWAIT
+//   Notes:
+///   The peer has been greeted (VER MSNFTP both ways) and its USR line
+///   read, checking the user is left to the caller
+//----------------------------------------------------------------------------
+///
+
+bool MsnFtpServer::WaitPeer(int cookie, const SocketProfile &profile,
+                            NetworkOps &fileServer, std::string &usrLine,
+                            std::string &errMsg) {
+  if (!Start(profile, errMsg)) {
+    Forget(cookie);
+    return false;
+  }
+
+  m_Mutex.Lock();
+  bool bDuplicate = !m_Waiting.insert(cookie).second;
+  if (!bDuplicate)
+    m_Issued.erase(cookie);
+  m_Mutex.Unlock();
+
+  /// Two transfers on one cookie would take each other's peers
+  if (bDuplicate) {
+    errMsg = " - Another transfer is already waiting on this auth cookie";
+    return false;
+  }
+
+  long long deadline = NetworkOps::GetTimeMs() + MSNFTPCONNECTWAIT;
+  for (;;) {
+    m_Mutex.Lock();
+    std::map<int, FtpPeer>::iterator it = m_Peers.find(cookie);
+    if (it != m_Peers.end()) {
+      NetworkOps *conn = it->second.conn;
+      usrLine = it->second.usrLine;
+      m_Peers.erase(it);
+      m_Waiting.erase(cookie);
+      m_Mutex.Unlock();
+
+      fileServer = std::move(*conn);
+      delete conn;
+      return true;
+    }
+    m_Mutex.Unlock();
+
+    long long now = NetworkOps::GetTimeMs();
+    if (now >= deadline)
+      break;
+
+    /// One transfer accepts for all, the rest wait their turn
+    m_PollMutex.Lock();
+    (void)m_Listener.Poll((int)std::min(deadline - now,
+                                        (long long)MSNFTPPOLLWAIT));
+    m_PollMutex.Unlock();
+  }
+
+  Forget(cookie);
+  errMsg = " - Timed out waiting for the peer to connect for the transfer";
+  return false;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Start
+//   Description:
+///   \brief Open the MSNFTP port, if it is not open already
+//   Parameters:
+///   @param const SocketProfile &profile
+///   @param std::string &errMsg
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool MsnFtpServer::Start(const SocketProfile &profile, std::string &errMsg) {
+  bool bOk = true;
+
+  m_Mutex.Lock();
+  if (!m_Listener.IsRunning()) {
+    m_Listener.SetProfile(profile);
+    bOk = m_Listener.Start(MSNFTPPORT, Accept, 0);
+    if (!bOk)
+      errMsg = *m_Listener.GetError();
+  }
+  m_Mutex.Unlock();
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Stop
+//   Description:
+///   \brief Close the MSNFTP port
+//   Parameters:
+//   Return:
+//   Notes:
+///   Connections not yet claimed are closed, transfers still waiting time
+///   out
+//----------------------------------------------------------------------------
+///
+
+void MsnFtpServer::Stop(void) {
+  m_PollMutex.Lock();
+  m_Mutex.Lock();
+  (void)m_Listener.Stop();
+  for (std::map<int, FtpPeer>::iterator it = m_Peers.begin();
+       it != m_Peers.end(); ++it) {
+    (void)it->second.conn->Disconnect();
+    delete it->second.conn;
+  }
+  m_Peers.clear();
+  m_Mutex.Unlock();
+  m_PollMutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Forget
+//   Description:
+///   \brief Drop a transfer's registration, and its peer if one came late
+//   Parameters:
+///   @param int cookie
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void MsnFtpServer::Forget(int cookie) {
+  NetworkOps *conn = 0;
+
+  m_Mutex.Lock();
+  m_Issued.erase(cookie);
+  m_Waiting.erase(cookie);
+  std::map<int, FtpPeer>::iterator it = m_Peers.find(cookie);
+  if (it != m_Peers.end()) {
+    conn = it->second.conn;
+    m_Peers.erase(it);
+  }
+  m_Mutex.Unlock();
+
+  if (conn) {
+    (void)conn->Disconnect();
+    delete conn;
+  }
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Accept
+//   Description:
+///   \brief Listener callback - greet a new peer and file it by cookie
+//   Parameters:
+///   @param NetworkOps *conn
+///   @param void *param - unused
+//   Return:
+///   @return bool - true if a waiting transfer will take the connection
+//   Notes:
+///   Peers giving a cookie that was not issued, or one already claimed,
+///   are closed
+//----------------------------------------------------------------------------
+///
+
+bool MsnFtpServer::Accept(NetworkOps *conn, void *param) {
+  std::string usrLine;
+  (void)param;
+
+  if (!Greet(conn, usrLine))
+    return false;
+
+  /// USR <user> <cookie>
+  size_t pos = usrLine.find_last_of(' ');
+  if (pos == std::string::npos)
+    return false;
+  int cookie = (int)strtol(usrLine.c_str() + pos + 1, (char **)NULL, 10);
+
+  bool bTaken = false;
+  m_Mutex.Lock();
+  if ((m_Waiting.count(cookie) || m_Issued.count(cookie)) &&
+      !m_Peers.count(cookie)) {
+    FtpPeer peer;
+    peer.conn = conn;
+    peer.usrLine = usrLine;
+    m_Peers[cookie] = peer;
+    m_Matched++;
+    bTaken = true;
+  }
+  m_Mutex.Unlock();
+  return bTaken;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Greet
+//   Description:
+///   \brief Exchange versions with a new peer and read its USR line
+//   Parameters:
+///   @param NetworkOps *conn
+///   @param std::string &usrLine - trimmed
+//   Return:
+///   @return bool - false if the peer is not an MSNFTP client or too slow
+//   Notes:
+///   Limited to MSNFTPGREETWAIT a read, so a silent peer holds up the
+///   other transfers' accepts no longer than that
+//----------------------------------------------------------------------------
+///
+
+bool MsnFtpServer::Greet(NetworkOps *conn, std::string &usrLine) {
+  std::string message;
+  std::string responses;
+
+  conn->SetBlock(false);
+  conn->SetReadWait(MSNFTPGREETWAIT);
+
+  if (!conn->Talk(&message, &responses) ||
+      responses.find("VER MSNFTP") == std::string::npos)
+    return false;
+
+  message = "VER MSNFTP\r\n";
+  if (!conn->Talk(&message, &usrLine))
+    return false;
+  StrUtils::Trim(usrLine);
+  if (usrLine.compare(0, 4, "USR ") != 0)
+    return false;
+
+  conn->SetBlock(true);
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Counters
+//   Description:
+///   \brief Server statistics
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+unsigned long MsnFtpServer::GetAccepted(void) {
+  return m_Listener.GetAccepted();
+}
+
+unsigned long MsnFtpServer::GetMatched(void) {
+  m_Mutex.Lock();
+  unsigned long matched = m_Matched;
+  m_Mutex.Unlock();
+  return matched;
+}
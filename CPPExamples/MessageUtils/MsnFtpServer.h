@@ -0,0 +1,85 @@
+///
+///   MsnFtpServer.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __msnftpserver_h_
+#define __msnftpserver_h_
+
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+
+#include "Listener.h"
+#include "Mutex.h"
+#include "NetworkOps.h"
+
+/// Port offered in MSNFTP invitations
+#define MSNFTPPORT "6891"
+
+/// How long a peer has to connect, and then to say who it is (ms)
+#define MSNFTPCONNECTWAIT 120000
+#define MSNFTPGREETWAIT 10000
+
+/// Longest a waiting transfer polls the listener for at once (ms)
+#define MSNFTPPOLLWAIT 250
+
+/// Auth cookies are drawn from [MSNFTPCOOKIEMIN, MSNFTPCOOKIEMIN + range)
+#define MSNFTPCOOKIEMIN 120
+#define MSNFTPCOOKIERANGE 20000
+
+///
+/// Process wide MSNFTP file server. One listener stays open on the MSNFTP
+/// port for every transfer, so transfers can run at once and a peer that
+/// connects late or twice does not find the port closed. Each transfer
+/// invites its peer with an auth cookie issued here, unique among those
+/// outstanding, and a connection is handed to the transfer whose cookie
+/// its USR line gives. Whichever waiting transfer polls the listener
+/// accepts and greets for all.
+///
+class MsnFtpServer {
+
+public:
+  ///
+  /// Public interface
+  ///
+  static int NewCookie(void);
+  static void Release(int);
+  static bool WaitPeer(int, const SocketProfile &, NetworkOps &,
+                       std::string &, std::string &);
+  static void Stop(void);
+
+  /// Counters - connections accepted, and those handed to a transfer
+  static unsigned long GetAccepted(void);
+  static unsigned long GetMatched(void);
+
+private:
+  struct FtpPeer {
+    NetworkOps *conn;
+    std::string usrLine;
+  };
+
+  static bool Start(const SocketProfile &, std::string &);
+  static bool Accept(NetworkOps *, void *);
+  static bool Greet(NetworkOps *, std::string &);
+  static void Forget(int);
+
+  static Listener m_Listener;
+  static Mutex m_Mutex;
+  /// Held by the one transfer polling the listener
+  static Mutex m_PollMutex;
+  /// Cookies handed out and not yet waited on, and those being waited on
+  static std::set<int> m_Issued;
+  static std::set<int> m_Waiting;
+  static std::map<int, FtpPeer> m_Peers;
+  static unsigned long m_Matched;
+  /// Seeded once, on the first cookie
+  static std::mt19937 m_Random;
+  static bool m_Seeded;
+};
+
+#endif
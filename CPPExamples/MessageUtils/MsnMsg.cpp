@@ -34,6 +34,11 @@ MSNChatMsg::MSNChatMsg(const char *msg, int payLoad) {
   ProcessChatResponse(msg, payLoad);
 }
 
+MSNChatMsg::MSNChatMsg(const BufSlice &msg) {
+  init();
+  ProcessChatResponse(msg);
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -80,6 +85,7 @@ void MSNChatMsg::clear() { return; }
 void MSNChatMsg::init() {
   m_Payload = 0;
   m_Cookie = 0;
+  m_chatLogging = false;
   return;
 }
 
@@ -193,6 +199,65 @@ void MSNChatMsg::ProcessChatResponse(const std::string &ptrMessage,
   return;
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ProcessChatResponse
+//   Description:
+///   \brief Parse one framed MSG, keeping the text as a view
+//   Parameters:
+///	  @param const BufSlice &frame - the MSG line and its payload
+//   Return:
+///   @return void
+//   Notes:
+///   The headers run to the first blank line and the rest is the text,
+///   exactly as sent. Only the headers are copied, and the text too when
+///   it is not plain text (invites), for GetMsg.
+//----------------------------------------------------------------------------
+///
+
+void MSNChatMsg::ProcessChatResponse(const BufSlice &frame) {
+  size_t pos = 0;
+
+  while (pos < frame.size()) {
+    size_t eol = frame.Find('\n', pos);
+    size_t next = (eol == BufSlice::npos) ? frame.size() : eol + 1;
+    BufSlice line = frame.Sub(pos, next - pos).Trim();
+    pos = next;
+
+    if (line.empty())
+      break;
+    else if (line.StartsWith("MSG "))
+      line.CopyTo(m_msgLine);
+    else if (line.StartsWith("MIME-Version"))
+      line.CopyTo(m_mimeType);
+    else if (line.StartsWith("Content-Type"))
+      line.CopyTo(m_contentType);
+    else if (line.StartsWith("Client-Name"))
+      line.CopyTo(m_imAgent);
+    else if (line.StartsWith("Chat-Logging"))
+      SetChat(true);
+    else if (line.StartsWith("X-MMS-IM-Format"))
+      line.CopyTo(m_imFormat);
+    else if (line.StartsWith("User-Agent"))
+      line.CopyTo(m_userAgent);
+    else if (line.StartsWith("TypingUser")) {
+      line.CopyTo(m_typingUsr);
+      SetChat(true);
+    }
+  }
+
+  m_Text = frame.Sub(pos);
+  if (!m_Text.empty() && !IsText()) {
+    m_Text.CopyTo(m_msgTxt);
+    int cookie = MsnUtils::MSNGetCookieId(&m_msgTxt);
+    if (cookie > 0)
+      SetCookie(cookie);
+  }
+  return;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -12,12 +12,15 @@
 #include <cstring>
 #include <string>
 
+#include "BufSlice.h"
+
 class MSNChatMsg {
 public:
   /// Public functions
   MSNChatMsg();
   MSNChatMsg(const char *, int len = 0);
   MSNChatMsg(const std::string &, int len = 0);
+  MSNChatMsg(const BufSlice &);
 
   ~MSNChatMsg();
 
@@ -30,6 +33,7 @@ public:
   inline const std::string *GetAgent() { return &m_userAgent; }
   inline const int GetCookie() { return m_Cookie; }
   inline const std::string *GetMsg() { return &m_msgTxt; }
+  inline const BufSlice *GetText() { return &m_Text; }
   inline const bool IsChat() { return m_chatLogging; }
 
   /// What type of message is this?
@@ -66,6 +70,7 @@ private:
   void clear();
   void ProcessChatResponse(const std::string &, int);
   void ProcessChatResponse(const char *, int);
+  void ProcessChatResponse(const BufSlice &);
 
   std::string m_mimeType;
   std::string m_contentType;
@@ -77,6 +82,7 @@ private:
 
   std::string m_msgTxt;
   std::string m_msg;
+  BufSlice m_Text;
   bool m_chatLogging;
   int m_Payload;
   int m_Cookie;
@@ -7,21 +7,24 @@
 /// @file
 
 #include "NetworkOps.h"
+#include "DnsCache.h"
 #include "Mutex.h"
 #include "UtilityFuncs.h"
+#include <algorithm>
+#include <chrono>
 #include <fcntl.h>
 #include <iostream>
+#include <sys/stat.h>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#endif
 
-///
-/// As this module may need to be threaded, we need a simple
-/// mutex lock on critical calls such as network packet consuming
-///
 namespace {
-static Mutex NetMutex;
-static void LockMutex(void) { NetMutex.Lock(); }
-
-static void UnlockMutex(void) { NetMutex.Unlock(); }
-
 static void SetNonBlockingSocket(int sockId) {
   int options = 0;
 #ifndef _WIN32
@@ -38,6 +41,47 @@ static void SetNonBlockingSocket(int sockId) {
   return;
 }
 
+static bool SetSocketBlocking(int sockId, bool block) {
+#ifndef _WIN32
+  int options = fcntl(sockId, F_GETFL, 0);
+  if (options == -1)
+    return false;
+  options = (block) ? (options & ~O_NONBLOCK) : (options | O_NONBLOCK);
+  return (fcntl(sockId, F_SETFL, options) == 0);
+#else
+  u_long nBlock = (block) ? 0 : 1;
+  return (ioctlsocket(sockId, FIONBIO, &nBlock) == 0);
+#endif
+}
+
+static void SetTcpOption(int sockId, int level, int name, int value) {
+  if (value >= 0)
+    (void)setsockopt(sockId, level, name, (char *)&value, sizeof(value));
+  return;
+}
+
+static int ReadFileAt(int fileNo, char *buffer, size_t len, long long offset) {
+  int num_read = 0;
+#ifndef _WIN32
+  do
+    num_read = (int)pread(fileNo, buffer, len, (off_t)offset);
+  while (num_read < 0 && errno == EINTR);
+#else
+  if (_lseeki64(fileNo, offset, SEEK_SET) < 0)
+    return -1;
+  num_read = _read(fileNo, buffer, (unsigned int)len);
+#endif
+  return num_read;
+}
+
+static int GetTcpOption(int sockId, int level, int name) {
+  int value = -1;
+  socklen_t len = sizeof(value);
+  if (getsockopt(sockId, level, name, (char *)&value, &len) < 0)
+    return -1;
+  return value;
+}
+
 } // namespace
 
 ///
@@ -72,19 +116,9 @@ NetworkOps::NetworkOps(const char *host) {
   SetHostName(host);
 }
 
-NetworkOps::NetworkOps(const NetworkOps &val) {
+NetworkOps::NetworkOps(NetworkOps &&val) noexcept {
   init();
-  m_HostName = val.m_HostName;
-  m_Service = val.m_Service;
-  m_Debug = val.m_Debug;
-  m_ErrorStr = val.m_ErrorStr;
-  m_NonBlocking = val.m_NonBlocking;
-  m_Block = val.m_Block;
-  m_SocketId = val.m_SocketId;
-
-#ifdef _WIN32
-  m_Started = val.m_Started;
-#endif
+  Take(val);
 }
 
 ///
@@ -127,23 +161,12 @@ bool NetworkOps::operator!=(const NetworkOps &other) const {
 }
 
 // Overloading the = operator
-NetworkOps &NetworkOps::operator=(const NetworkOps &val) {
+NetworkOps &NetworkOps::operator=(NetworkOps &&val) noexcept {
   if (this == &val)
     return *this;
 
-  m_HostName = val.m_HostName;
-  m_Service = val.m_Service;
-
-  m_ErrorStr = val.m_ErrorStr;
-  m_NonBlocking = val.m_NonBlocking;
-  m_Block = val.m_Block;
-  m_SocketId = val.m_SocketId;
-  m_Debug = val.m_Debug;
-
-#ifdef _WIN32
-  m_Started = val.m_Started;
-#endif
-
+  (void)Disconnect();
+  Take(val);
   return *this;
 }
 
@@ -157,6 +180,94 @@ bool NetworkOps::operator<(const NetworkOps &other) const {
   return (m_SocketId < other.m_SocketId);
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Take
+//   Description:
+///   \brief Take over another object's connection and settings
+//   Parameters:
+///   @param NetworkOps &val - left unconnected
+//   Return:
+//   Notes:
+///   This object must be unconnected. Buffers and queues are swapped, not
+///   copied, so no data is copied and nothing touches the socket. Each
+///   object keeps its own locks.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::Take(NetworkOps &val) noexcept {
+  m_HostName.swap(val.m_HostName);
+  m_Service.swap(val.m_Service);
+  m_ErrorStr.swap(val.m_ErrorStr);
+  m_Transport = val.m_Transport;
+  m_NonBlocking = val.m_NonBlocking;
+  m_FastOpen = val.m_FastOpen;
+  m_ReusePort = val.m_ReusePort;
+  m_Block = val.m_Block;
+  m_ReadWait = val.m_ReadWait;
+  m_SocketId = val.m_SocketId;
+  m_Debug = val.m_Debug;
+  m_PeerClosed = val.m_PeerClosed;
+  m_Profile = val.m_Profile;
+  m_Health = val.m_Health;
+
+  m_ConnAddrs.swap(val.m_ConnAddrs);
+  m_ConnNext = val.m_ConnNext;
+  m_ConnAttempts.swap(val.m_ConnAttempts);
+  m_ConnDeadline = val.m_ConnDeadline;
+  m_ConnNextStart = val.m_ConnNextStart;
+  m_ConnectWait = val.m_ConnectWait;
+  m_ConnErr = val.m_ConnErr;
+
+  m_RecvBuf.swap(val.m_RecvBuf);
+  m_RxStamps = val.m_RxStamps;
+  m_RecvTotal = val.m_RecvTotal;
+  m_RecvStamps.swap(val.m_RecvStamps);
+
+  m_SendQueue.swap(val.m_SendQueue);
+  m_SendOffset = val.m_SendOffset;
+  m_SendQueued = val.m_SendQueued;
+  m_LowWater = val.m_LowWater;
+  m_HighWater = val.m_HighWater;
+  m_Throttled = val.m_Throttled;
+
+  m_ZcEnabled = val.m_ZcEnabled;
+  m_ZcUsed = val.m_ZcUsed;
+  m_ZcNext = val.m_ZcNext;
+  m_ZcDone = val.m_ZcDone;
+  m_ZcRanges.swap(val.m_ZcRanges);
+  m_ZcHeld.swap(val.m_ZcHeld);
+  m_ZcSpare.swap(val.m_ZcSpare);
+  m_ZcBytes = val.m_ZcBytes;
+  m_CopyBytes = val.m_CopyBytes;
+
+  m_Delivered = (bool)val.m_Delivered;
+  m_WaitId = val.m_WaitId;
+  m_Waiters = val.m_Waiters;
+  m_Signalled = val.m_Signalled;
+  m_Staged.swap(val.m_Staged);
+  m_StagedEnd = val.m_StagedEnd;
+  m_StagedErr = val.m_StagedErr;
+  m_Submit = val.m_Submit;
+  m_SubmitParam = val.m_SubmitParam;
+  m_LoopQueued = (size_t)val.m_LoopQueued;
+
+#ifdef _WIN32
+  m_Started = val.m_Started;
+#endif
+
+  /// The socket is mine now, so the other object must not close it
+  val.m_SocketId = -1;
+  val.m_WaitId = -1;
+  val.NetworkOps::init();
+  val.m_HostName.clear();
+  val.m_Service.clear();
+  val.m_ErrorStr.clear();
+  return;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -193,9 +304,52 @@ void NetworkOps::init() {
   m_Started = false;
 #endif
   m_SocketId = -1;
+  m_Transport = TRANSPORTTCP;
   m_NonBlocking = false;
+  m_FastOpen = false;
+  m_ReusePort = false;
   m_Block = true;
+  m_ReadWait = 2000;
   m_Debug = false;
+  m_PeerClosed = false;
+  m_RecvBuf.clear();
+  m_RxStamps = false;
+  m_RecvTotal = 0;
+  m_RecvStamps.clear();
+  m_SendQueue.clear();
+  m_SendOffset = 0;
+  m_SendQueued = 0;
+  m_LowWater = SENDLOWWATER;
+  m_HighWater = SENDHIGHWATER;
+  m_Throttled = false;
+  /// Anything still pinned goes with the socket
+  m_ZcEnabled = false;
+  m_ZcUsed = false;
+  m_ZcNext = 0;
+  m_ZcDone = 0;
+  m_ZcRanges.clear();
+  m_ZcHeld.clear();
+  m_ZcSpare.clear();
+  m_ZcBytes = 0;
+  m_CopyBytes = 0;
+  m_Delivered = false;
+  m_WaitId = -1;
+  m_Waiters = 0;
+  m_Signalled = false;
+  m_Staged.clear();
+  m_StagedEnd = false;
+  m_StagedErr = 0;
+  m_Submit = 0;
+  m_SubmitParam = 0;
+  m_LoopQueued = 0;
+  m_ConnAddrs.clear();
+  m_ConnAttempts.clear();
+  m_ConnNext = 0;
+  m_ConnDeadline = 0;
+  m_ConnNextStart = 0;
+  m_ConnectWait = CONNECTWAIT;
+  m_ConnErr = 0;
+  m_Health = ConnHealth();
   return;
 }
 
@@ -214,21 +368,147 @@ void NetworkOps::init() {
 
 void NetworkOps::ParseHost() {
 
-  if (GetHostName()->empty())
+  if (GetHostName()->empty() || IsUnixHost())
     return;
 
-  if (strstr(GetHostName()->c_str(), ":")) {
-    // We have a host with a port imbedded in it, we need to split this up
-    std::string hostName = GetHostName()->substr(0, GetHostName()->find(":"));
-    std::string serviceName = GetHostName()->substr(
-        (GetHostName()->find(":")) + 1, GetHostName()->length());
+  const std::string &host = *GetHostName();
+  std::string hostName;
+  std::string serviceName;
+
+  if (host[0] == '[') {
+    // Bracketed IPv6 literal, optionally followed by a port
+    size_t end = host.find(']');
+    if (end == std::string::npos)
+      return;
+    hostName = host.substr(1, end - 1);
+    if (end + 1 < host.length() && host[end + 1] == ':')
+      serviceName = host.substr(end + 2);
+  } else {
+    // A single colon separates the port, more means a bare IPv6 address
+    size_t colon = host.find(':');
+    if (colon == std::string::npos ||
+        host.find(':', colon + 1) != std::string::npos)
+      return;
+    hostName = host.substr(0, colon);
+    serviceName = host.substr(colon + 1);
+  }
 
-    SetHostName(&hostName);
+  SetHostName(&hostName);
+  if (!serviceName.empty())
     SetService(&serviceName);
-  }
   return;
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   IsUnixHost
+//   Description:
+///   \brief Whether the host name is a Unix domain socket path
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::IsUnixHost(void) {
+  return (GetHostName()->compare(0, strlen(UNIXPREFIX), UNIXPREFIX) == 0);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetUnixAddr
+//   Description:
+///   \brief Build the address of a Unix domain socket from the host name
+//   Parameters:
+///   @param DnsAddr &local
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::GetUnixAddr(DnsAddr &local) {
+  memset((char *)&local, 0, sizeof(local));
+#ifndef _WIN32
+  std::string path = GetHostName()->substr(strlen(UNIXPREFIX));
+  struct sockaddr_un *sun = (struct sockaddr_un *)&local.addr;
+
+  if (path.empty() || path.length() >= sizeof(sun->sun_path)) {
+    SetError("- Unix socket path is empty or too long");
+    return (false);
+  }
+  sun->sun_family = AF_UNIX;
+  memcpy(sun->sun_path, path.c_str(), path.length());
+  local.len = sizeof(*sun);
+  return (true);
+#else
+  SetError("- Unix sockets are not supported on this platform");
+  return (false);
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   CreatePair
+//   Description:
+///   \brief Connect two NetworkOps to each other, in process
+//   Parameters:
+///   @param NetworkOps &first
+///   @param NetworkOps &second
+//   Return:
+///   @return bool
+//   Notes:
+///   Neither may already be connected. Each end keeps its own blocking
+///   mode and profile, and behaves as a connection to a remote host would,
+///   so protocol code can be driven and load tested without the network.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::CreatePair(NetworkOps &first, NetworkOps &second) {
+  if (first.IsConnected() || second.IsConnected()) {
+    first.SetError("- A socket pair needs two unconnected ends");
+    return (false);
+  }
+
+#ifndef _WIN32
+  int pair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) {
+    std::string errMsg("- An error occurred creating a socket pair ");
+    char error[1024 + 1];
+    if (strerror_r(errNo, error, sizeof(error)) == 0)
+      errMsg += error;
+    first.SetError(&errMsg);
+    return (false);
+  }
+
+  NetworkOps *ends[2] = {&first, &second};
+  for (int i = 0; i < 2; i++) {
+    (void)fcntl(pair[i], F_SETFD, FD_CLOEXEC);
+    if (ends[i]->m_NonBlocking)
+      SetNonBlockingSocket(pair[i]);
+    ends[i]->ApplyProfile(pair[i]);
+
+    ends[i]->m_RecvMutex.Lock();
+    ends[i]->m_SendMutex.Lock();
+    ends[i]->SetSockId(pair[i]);
+    ends[i]->m_Transport = TRANSPORTPAIR;
+    ends[i]->m_SendMutex.Unlock();
+    ends[i]->m_RecvMutex.Unlock();
+  }
+  return (true);
+#else
+  first.SetError("- Socket pairs are not supported on this platform");
+  return (false);
+#endif
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -243,25 +523,36 @@ void NetworkOps::ParseHost() {
 ///
 
 bool NetworkOps::Connect(void) {
-  LockMutex();
-  struct servent *servp = 0;
-  struct hostent *host = 0;
-  struct sockaddr_in sin = {0};
+  if (!BeginConnect())
+    return (false);
 
-  int channel = -1;
+  return (PollConnect(-1) > 0);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BeginConnect
+//   Description:
+///   \brief Resolve the remote host and start connecting to it
+//   Parameters:
+//   Return:
+///   @return bool - false if nothing could be started
+//   Notes:
+///   Never blocks on the connect itself, drive it with PollConnect. IPv4
+///   and IPv6 addresses are interleaved so the families race each other.
+//----------------------------------------------------------------------------
+///
 
-  if (GetHostName()->empty()) {
-    UnlockMutex();
+bool NetworkOps::BeginConnect(void) {
+  if (GetHostName()->empty())
     return (false);
-  }
 
+  CancelConnect();
   ParseHost();
-  int portNo = (int)strtol(GetService()->c_str(), (char **)NULL, 10);
 
 #ifdef _WIN32
-  struct sockaddr peer = {0};
-  int addrlen = 0;
-  addrlen = sizeof(peer);
   if (!m_Started) {
     WSADATA wsData;
     WSAStartup(MAKEWORD(2, 0), &wsData);
@@ -269,59 +560,202 @@ bool NetworkOps::Connect(void) {
   }
 #endif
 
-  if (portNo < 1) {
-    if ((servp = getservbyname(GetService()->c_str(), "tcp")) ==
-        (struct servent *)0) {
+  std::vector<DnsAddr> addrs;
+  if (IsUnixHost()) {
+    ///   A local socket, nothing to resolve
+    DnsAddr local;
+    if (!GetUnixAddr(local))
+      return (false);
+    addrs.push_back(local);
+  } else {
+    long long start = GetTimeMs();
+    int rc = DnsCache::Lookup(*GetHostName(), *GetService(), addrs);
+    if (rc != 0) {
       std::string errMsg("- TCP/IP name specified is invalid ");
-      char error[1024 + 1];
-#ifndef _WIN32
-      if (strerror_r(errNo, error, sizeof(error)) == 0)
-        errMsg += error;
-#else
-      if (strerror_s(error, sizeof(error), errNo) == 0)
-        errMsg += error;
-#endif
+      errMsg += gai_strerror(rc);
       SetError(&errMsg);
-      UnlockMutex();
       return (false);
     }
-    sin.sin_port = servp->s_port;
-  } else
-    sin.sin_port = htons(portNo);
+    if (IsDebug())
+      (void)DebugUtils::LogMessage(
+          MSGINFO,
+          "Debug: [%s,%d] Resolved %s in %lldms (%lu hits, %lu misses)",
+          __FILE__, __LINE__, GetHostName()->c_str(), GetTimeMs() - start,
+          DnsCache::GetHits(), DnsCache::GetMisses());
+  }
+
+  // Alternate families, keeping the resolver's order within each one
+  std::vector<DnsAddr> first, second;
+  for (size_t i = 0; i < addrs.size(); i++) {
+    if (addrs[i].addr.ss_family == addrs[0].addr.ss_family)
+      first.push_back(addrs[i]);
+    else
+      second.push_back(addrs[i]);
+  }
+
+  for (size_t i = 0; i < first.size() || i < second.size(); i++) {
+    if (i < first.size())
+      m_ConnAddrs.push_back(first[i]);
+    if (i < second.size())
+      m_ConnAddrs.push_back(second[i]);
+  }
+
+  m_ConnNext = 0;
+  m_ConnErr = 0;
+  m_ConnDeadline = GetTimeMs() + m_ConnectWait;
+
+  while (m_ConnNext < m_ConnAddrs.size()) {
+    if (StartAttempt())
+      return (true);
+  }
+
+  SetConnectError(m_ConnErr);
+  CancelConnect();
+  return (false);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   PollConnect
+//   Description:
+///   \brief Drive a connect started by BeginConnect
+//   Parameters:
+///   @param int millisecs - how long to wait, -1 for the overall deadline
+//   Return:
+///   @return int - 1 connected, 0 still in progress, -1 failed
+//   Notes:
+///   Attempts complete on writability. Each has its own deadline, and the
+///   next address is started once the current one has had CONNECTSTAGGER
+///   ms to itself or has failed outright. The first to connect wins.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::PollConnect(int millisecs) {
+  if (IsConnected() && !IsConnecting())
+    return (1);
+
+  long long until = (millisecs < 0) ? m_ConnDeadline : GetTimeMs() + millisecs;
+
+  for (;;) {
+    long long now = GetTimeMs();
+
+    // Give up on attempts that have run out of time
+    for (size_t i = 0; i < m_ConnAttempts.size();) {
+      if (now >= m_ConnAttempts[i].deadline || now >= m_ConnDeadline) {
+        (void)closesk(m_ConnAttempts[i].sockId);
+        m_ConnAttempts.erase(m_ConnAttempts.begin() + i);
+        m_ConnErr = ETIMEDOUT;
+      } else
+        i++;
+    }
+
+    // Race the next address if this one is slow or gone
+    if (m_ConnNext < m_ConnAddrs.size() && now < m_ConnDeadline &&
+        (m_ConnAttempts.empty() || now >= m_ConnNextStart)) {
+      (void)StartAttempt();
+      continue;
+    }
+
+    if (m_ConnAttempts.empty()) {
+      SetConnectError(m_ConnErr);
+      CancelConnect();
+      return (-1);
+    }
+
+    long long wake = std::min(until, m_ConnDeadline);
+    if (m_ConnNext < m_ConnAddrs.size())
+      wake = std::min(wake, m_ConnNextStart);
+    for (size_t i = 0; i < m_ConnAttempts.size(); i++)
+      wake = std::min(wake, m_ConnAttempts[i].deadline);
+    int wait = (wake > now) ? (int)(wake - now) : 0;
 
-  if ((host = gethostbyname(GetHostName()->c_str())) == (struct hostent *)0) {
-    // Can't find a hostname, so assume it is an inetaddr...
 #ifndef _WIN32
-    struct in_addr iAddr = {0};
-    inet_aton(GetHostName()->c_str(), &iAddr);
+    std::vector<struct pollfd> fds(m_ConnAttempts.size());
+    for (size_t i = 0; i < m_ConnAttempts.size(); i++) {
+      fds[i].fd = m_ConnAttempts[i].sockId;
+      fds[i].events = POLLOUT;
+      fds[i].revents = 0;
+    }
+    int ready = poll(&fds[0], (nfds_t)fds.size(), wait);
 #else
-    unsigned int iAddr = 0;
-    iAddr = inet_addr(GetHostName()->c_str());
+    fd_set wfds, efds;
+    FD_ZERO(&wfds);
+    FD_ZERO(&efds);
+    for (size_t i = 0; i < m_ConnAttempts.size(); i++) {
+      FD_SET(m_ConnAttempts[i].sockId, &wfds);
+      FD_SET(m_ConnAttempts[i].sockId, &efds);
+    }
+    struct timeval tv;
+    tv.tv_sec = wait / 1000;
+    tv.tv_usec = (wait % 1000) * 1000;
+    int ready = select(0, 0, &wfds, &efds, &tv);
 #endif
+    if (ready < 0 && errNo != EINTR) {
+      m_ConnErr = errNo;
+      CancelConnect();
+      SetConnectError(m_ConnErr);
+      return (-1);
+    }
 
-    if ((host = gethostbyaddr((const char *)&iAddr, sizeof(iAddr), AF_INET)) ==
-        (struct hostent *)0) {
-      std::string errMsg("- TCP/IP name specified is invalid ");
-      char error[1024 + 1];
+    for (size_t i = 0; ready > 0 && i < m_ConnAttempts.size();) {
 #ifndef _WIN32
-      if (strerror_r(errNo, error, sizeof(error)) == 0)
-        errMsg += error;
+      bool done = (fds[i].revents != 0);
 #else
-      if (strerror_s(error, sizeof(error), errNo) == 0)
-        errMsg += error;
+      bool done = (FD_ISSET(m_ConnAttempts[i].sockId, &wfds) ||
+                   FD_ISSET(m_ConnAttempts[i].sockId, &efds));
 #endif
-      SetError(&errMsg);
-      UnlockMutex();
-      return (false);
+      if (!done) {
+        i++;
+        continue;
+      }
+
+      int err = 0;
+      socklen_t len = sizeof(err);
+      if (getsockopt(m_ConnAttempts[i].sockId, SOL_SOCKET, SO_ERROR,
+                     (char *)&err, &len) < 0)
+        err = errNo;
+      if (err == 0)
+        return FinishConnect(i);
+
+      // Refused or unreachable, so let the next address go straight away
+      (void)closesk(m_ConnAttempts[i].sockId);
+      m_ConnAttempts.erase(m_ConnAttempts.begin() + i);
+#ifndef _WIN32
+      fds.erase(fds.begin() + i);
+#endif
+      m_ConnErr = err;
+      m_ConnNextStart = GetTimeMs();
     }
+
+    if (GetTimeMs() >= until)
+      return (0);
   }
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   StartAttempt
+//   Description:
+///   \brief Start a non-blocking connect to the next candidate address
+//   Parameters:
+//   Return:
+///   @return bool - true if the attempt is in flight
+//   Notes:
+//----------------------------------------------------------------------------
+///
 
-  sin.sin_family = host->h_addrtype;
-  memcpy((char *)&(sin.sin_addr), host->h_addr, host->h_length);
+bool NetworkOps::StartAttempt(void) {
+  const DnsAddr &target = m_ConnAddrs[m_ConnNext++];
+  long long now = GetTimeMs();
+  m_ConnNextStart = now + CONNECTSTAGGER;
 
-  if ((channel = socket(sin.sin_family, SOCK_STREAM, 0)) < 0) {
-    SetError("- Socket initialisation failed");
-    UnlockMutex();
+  int channel = socket(target.addr.ss_family, SOCK_STREAM, 0);
+  if (channel < 0) {
+    m_ConnErr = errNo;
     return (false);
   }
 
@@ -330,32 +764,43 @@ bool NetworkOps::Connect(void) {
   if ((setsockopt(channel, SOL_SOCKET, SO_REUSEADDR, (char *)&n, sizeof(n)) <
        0) ||
       (setsockopt(channel, SOL_SOCKET, SO_KEEPALIVE, (char *)&n, sizeof(n)) <
-       0)) {
-    SetError("- Set socket options failed");
-    UnlockMutex();
+       0) ||
+      !SetSocketBlocking(channel, false)) {
+    m_ConnErr = errNo;
+    (void)closesk(channel);
     return (false);
   }
-
-  if (connect(channel, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
-    std::string errMsg("- Connection to server socket failed ");
-    char error[1024 + 1];
-#ifndef _WIN32
-    if (strerror_r(errNo, error, sizeof(error)) == 0)
-      errMsg += error;
-#else
-    if (strerror_s(error, sizeof(error), errNo) == 0)
-      errMsg += error;
+  ApplyProfile(channel);
+
+#ifdef TCP_FASTOPEN_CONNECT
+  ///
+  /// With a cookie cached for the server, connect returns at once and the
+  /// SYN goes out with the first write. Otherwise this is an ordinary
+  /// connect that asks for a cookie for next time. Servers without fast
+  /// open never give one, and the kernel backs off by itself if SYNs with
+  /// data get dropped on the way.
+  ///
+  /// A connect that returns at once would win straight away, skipping the
+  /// attempt deadline and the other addresses, and a dead server would
+  /// only show as a read timeout. So only with one address to try, as for
+  /// a switchboard given by address in XFR or RNG.
+  ///
+  if (m_FastOpen && m_ConnAddrs.size() == 1)
+    SetTcpOption(channel, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
 #endif
-    SetError(&errMsg);
-    UnlockMutex();
+
+  if (connect(channel, (const struct sockaddr *)&target.addr, target.len) <
+          0 &&
+      errNo != EINPROGRESS && errNo != EWOULDBLOCK) {
+    m_ConnErr = errNo;
+    (void)closesk(channel);
     return (false);
   }
 
-  if (m_NonBlocking)
-    SetNonBlockingSocket(channel);
-
-  SetSockId(channel);
-  UnlockMutex();
+  ConnectAttempt attempt;
+  attempt.sockId = channel;
+  attempt.deadline = std::min(now + CONNECTATTEMPTWAIT, m_ConnDeadline);
+  m_ConnAttempts.push_back(attempt);
   return (true);
 }
 
@@ -363,33 +808,137 @@ bool NetworkOps::Connect(void) {
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   Disconnect
+///   FinishConnect
 //   Description:
-///   Disconnect from remote host
+///   \brief Adopt the winning attempt as this connection's socket
 //   Parameters:
+///   @param size_t winner - index into the attempts in flight
 //   Return:
+///   @return int - 1
 //   Notes:
 //----------------------------------------------------------------------------
 ///
 
-bool NetworkOps::Disconnect(void) {
-  UnlockMutex();
-  if (IsConnected())
-    (void)closesk(GetSockId());
-  init();
-  return true;
+int NetworkOps::FinishConnect(size_t winner) {
+  int channel = m_ConnAttempts[winner].sockId;
+  m_ConnAttempts.erase(m_ConnAttempts.begin() + winner);
+  CancelConnect();
+
+  if (m_NonBlocking)
+    SetNonBlockingSocket(channel);
+  else
+    (void)SetSocketBlocking(channel, true);
+  ReportProfile(channel);
+
+  m_RecvMutex.Lock();
+  m_SendMutex.Lock();
+  SetSockId(channel);
+  m_Transport = (IsUnixHost()) ? TRANSPORTUNIX : TRANSPORTTCP;
+  m_SendMutex.Unlock();
+  m_RecvMutex.Unlock();
+  return (1);
 }
 
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   Talk
+///   CancelConnect
 //   Description:
-///   \brief Have a talk with a remote host
+///   \brief Abandon any connect in progress
 //   Parameters:
-///   @param const char* pczMessage
-///   @param std::string *response
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::CancelConnect(void) {
+  for (size_t i = 0; i < m_ConnAttempts.size(); i++)
+    (void)closesk(m_ConnAttempts[i].sockId);
+  m_ConnAttempts.clear();
+  m_ConnAddrs.clear();
+  m_ConnNext = 0;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SetConnectError
+//   Description:
+///   \brief Record why the last connect failed
+//   Parameters:
+///   @param int errCode
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::SetConnectError(int errCode) {
+  std::string errMsg("- Connection to server socket failed ");
+  char error[1024 + 1];
+#ifndef _WIN32
+  if (strerror_r(errCode, error, sizeof(error)) == 0)
+    errMsg += error;
+#else
+  if (strerror_s(error, sizeof(error), errCode) == 0)
+    errMsg += error;
+#endif
+  SetError(&errMsg);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Disconnect
+//   Description:
+///   Disconnect from remote host
+//   Parameters:
+//   Return:
+//   Notes:
+///   A receive the event loop has outstanding holds the socket open, so
+///   with loop owned I/O the read side is shut down first to end it
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::Disconnect(void) {
+  bool bDelivered = m_Delivered;
+
+  CancelConnect();
+  if (m_WaitId != -1)
+    StopDelivery();
+  if (IsConnected()) {
+    if (IsDebug()) {
+      (void)SampleHealth(true);
+      ReportHealth();
+    }
+#ifndef _WIN32
+    if (bDelivered)
+      (void)shutdown(GetSockId(), SHUT_RD);
+#endif
+    (void)closesk(GetSockId());
+  }
+#ifndef _WIN32
+  if (m_WaitId != -1)
+    (void)close(m_WaitId);
+#endif
+  init();
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Talk
+//   Description:
+///   \brief Have a talk with a remote host
+//   Parameters:
+///   @param const char* pczMessage
+///   @param std::string *response
 ///   @param bool bforc
 //   Return:
 ///   @return bool
@@ -427,19 +976,35 @@ bool NetworkOps::Talk(const std::string *pczMessage, std::string *response,
 
   int iRet = -1;
 
-  if (bforce)
-    UnlockMutex();
-
-  LockMutex();
+  ///
+  /// Hold the receive side for the whole exchange so that no other reader
+  /// on this connection can consume the reply to my request. Sends that do
+  /// not want a reply (bforce or not) only ever take the send side, so they
+  /// are never held up by a thread sitting in a read.
+  ///
+  (void)bforce;
+  if (response != NULL)
+    m_RecvMutex.Lock();
 
   std::string message;
 
+  ///
+  /// Only time the reply when it has to come off the wire - one already
+  /// buffered says nothing about the round trip
+  ///
+  bool bTimed = (response != NULL && m_RecvBuf.empty() && !IsPending());
+  long long sent = 0;
+
   if (pczMessage && !pczMessage->empty()) {
     message = pczMessage->c_str();
     //
     // Send a message to the server...
     //
+    m_SendMutex.Lock();
     int iLen = SendMsg((void *)message.c_str(), message.length());
+    m_SendMutex.Unlock();
+
+    sent = GetTimeUs();
 
     if (iLen != (int)message.length()) {
       std::string errMsg("- A communications error occurred (1) ");
@@ -452,18 +1017,23 @@ bool NetworkOps::Talk(const std::string *pczMessage, std::string *response,
         errMsg += error;
 #endif
       SetError(&errMsg);
-      UnlockMutex();
+      if (response != NULL)
+        m_RecvMutex.Unlock();
       return false;
     }
   }
 
-  if (response == NULL) {
-    UnlockMutex();
+  if (response == NULL)
     return true;
-  }
 
   std::string reply;
-  iRet = ReadMsg(reply);
+  iRet = FillMsg((m_RecvBuf.empty()) ? GetReplyWait() : 0);
+  if (iRet > 0) {
+    if (bTimed && sent != 0)
+      AddReplyTime(GetTimeUs() - sent);
+    reply.assign(m_RecvBuf.Linearize(), m_RecvBuf.size());
+    m_RecvBuf.Consume(m_RecvBuf.size());
+  }
 
   if (iRet < 0) {
     if (GetError()->empty()) {
@@ -478,12 +1048,12 @@ bool NetworkOps::Talk(const std::string *pczMessage, std::string *response,
 #endif
       SetError(&errMsg);
     }
-    UnlockMutex();
+    m_RecvMutex.Unlock();
     return false;
   }
 
   *response = reply;
-  UnlockMutex();
+  m_RecvMutex.Unlock();
   return true;
 }
 
@@ -508,13 +1078,11 @@ bool NetworkOps::SendBinMsg(void *pczMessage, int iMsgLen, bool bforce) {
   if (!IsConnected())
     return false;
 
-  if (bforce)
-    UnlockMutex();
-
-  LockMutex();
+  (void)bforce;
+  m_SendMutex.Lock();
   int iRet = SendMsg(pczMessage, iMsgLen);
   bool bRet = (iRet == iMsgLen);
-  UnlockMutex();
+  m_SendMutex.Unlock();
   return bRet;
 }
 
@@ -522,212 +1090,283 @@ bool NetworkOps::SendBinMsg(void *pczMessage, int iMsgLen, bool bforce) {
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   SendMsg
+///   SendFile
 //   Description:
-///   Send a message to the remote host
+///   \brief Send part of a file, optionally split into headed packets
 //   Parameters:
+///   @param int fileNo - open file, its offset is left alone
+///   @param long long offset - where to start in the file
+///   @param long long length - bytes of file data to send
+///   @param int packetsz - file bytes per packet when headed
+///   @param FILEHDRFUNCPTR hdrFunc - builds each packet header, or 0
 //   Return:
+///   @return long long - file bytes sent, or -1
 //   Notes:
+///   On Linux, unheaded data or large packets on a plain socket go from
+///   the page cache with sendfile, headers written in between and TCP_CORK
+///   holding partial segments back. Kernel TLS sends unheaded data that
+///   way too, with SSL_sendfile. Otherwise whole packets are read in
+///   blocks and each block's headers and data go out in one gather write.
 //----------------------------------------------------------------------------
 ///
 
-int NetworkOps::SendMsg(void *pczMessage, int iMsgLen) {
-  int writen = 0;
-  int msgblk = DBLOCK;
-  int msgsnt = 0;
-  int msglft = iMsgLen;
+long long NetworkOps::SendFile(int fileNo, long long offset, long long length,
+                               int packetsz, FILEHDRFUNCPTR hdrFunc) {
+  if (!IsConnected() || fileNo < 0 || offset < 0 || length < 0)
+    return (-1);
 
-  char *tmp = 0;
+  if (packetsz <= 0)
+    packetsz = FILEBLOCK;
 
-  if (pczMessage == 0)
-    return 0;
+  m_SendMutex.Lock();
 
-  tmp = (char *)pczMessage;
+  // Anything already queued has to go first
+  bool bOk = true;
+  while (bOk && HasQueuedMsgs()) {
+    if (SendQueued() < 0)
+      bOk = false;
+    else if (HasQueuedMsgs() && !WaitSend(SENDWAIT)) {
+      SetError("- Timed out waiting to send to a socket ");
+      bOk = false;
+    }
+  }
 
-  while (msglft > 0) {
-    int i = 0;
-    if (msglft < msgblk)
-      i = msglft;
+  long long sent = -1;
+  if (bOk) {
+#ifdef __linux__
+    /// Small headed packets cost two syscalls each with sendfile, more
+    /// than copying a block of them into one gather write
+    struct stat st;
+    if (CanSendFile(hdrFunc != 0) && (!hdrFunc || packetsz >= FILEBLOCK) &&
+        fstat(fileNo, &st) == 0 && S_ISREG(st.st_mode))
+      sent = SendFileDirect(fileNo, offset, length, packetsz, hdrFunc);
     else
-      i = msgblk;
-
-    do
-      writen = send(GetSockId(), tmp, i, 0);
-    while (writen < 0 && errNo == EINTR);
-
-    msglft -= writen;
-    msgsnt += writen;
-    tmp = (char *)(tmp + writen);
-    if (writen == 0)
-      break;
+#endif
+      sent = SendFileCopy(fileNo, offset, length, packetsz, hdrFunc);
   }
 
-  if (IsDebug())
-    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] Sent %d", __FILE__,
-                                 __LINE__, msgsnt);
-
-  return (msgsnt);
+  m_SendMutex.Unlock();
+  return sent;
 }
 
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   GetMsg
+///   SendFileDirect
 //   Description:
-///   \brief Wrapper public function to read a message
+///   \brief SendFile using sendfile for the data
 //   Parameters:
-///   @param int *ptrRead
-///   @param std::string message
 //   Return:
-///   @return bool
+///   @return long long - file bytes sent, or -1
 //   Notes:
+///   Must be called with m_SendMutex held
 //----------------------------------------------------------------------------
 ///
 
-bool NetworkOps::GetBinMsg(int *ptrRead, std::string &message) {
-  bool bRet = false;
-
-  LockMutex();
-  int read = ReadMsg(message);
+long long NetworkOps::SendFileDirect(int fileNo, long long offset,
+                                     long long length, int packetsz,
+                                     FILEHDRFUNCPTR hdrFunc) {
+#ifdef __linux__
+  int n = 1;
+  (void)setsockopt(GetSockId(), IPPROTO_TCP, TCP_CORK, (char *)&n, sizeof(n));
+
+  long long pos = offset;
+  long long done = 0;
+  bool bOk = true;
+
+  while (bOk && done < length) {
+    long long packet = length - done;
+    if (hdrFunc) {
+      if (packet > packetsz)
+        packet = packetsz;
+      char header[FILEHDRMAX];
+      struct iovec vec;
+      vec.iov_base = header;
+      vec.iov_len = hdrFunc(header, (int)packet);
+      bOk = WriteAll(&vec, 1);
+    }
 
-  if (read < 0)
-    *ptrRead = 0;
-  else {
-    bRet = true;
-    *ptrRead = read;
+    long long left = packet;
+    while (bOk && left > 0) {
+      long long writen = SendFileData(fileNo, &pos, left);
+      if (writen > 0) {
+        left -= writen;
+        continue;
+      }
+      if (writen < 0 && errNo == EINTR)
+        continue;
+      if (writen < 0 && (errNo == EAGAIN || errNo == EWOULDBLOCK)) {
+        if (WaitSend(SENDWAIT))
+          continue;
+        SetError("- Timed out waiting to send to a socket ");
+      } else if (writen == 0)
+        SetError("- The file ended before it was all sent ");
+      else {
+        std::string errMsg("- An error occurred sending a file ");
+        char error[1024 + 1];
+        if (strerror_r(errNo, error, sizeof(error)) == 0)
+          errMsg += error;
+        SetError(&errMsg);
+      }
+      bOk = false;
+    }
+    done += packet - left;
   }
-  UnlockMutex();
-  return bRet;
+
+  n = 0;
+  (void)setsockopt(GetSockId(), IPPROTO_TCP, TCP_CORK, (char *)&n, sizeof(n));
+  return (bOk) ? done : -1;
+#else
+  return SendFileCopy(fileNo, offset, length, packetsz, hdrFunc);
+#endif
 }
 
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   GetMsg
+///   SendFileData
 //   Description:
-///   \brief Wrapper public function to read a message
+///   \brief Send file data from the page cache to the socket
 //   Parameters:
-///   @param int *ptrRead
-///   @param char **ptrMessage
+///   @param int fileNo
+///   @param long long *pos - file offset, moved on by what was sent
+///   @param long long count
 //   Return:
-///   @return bool
+///   @return long long - bytes sent, 0 at the end of the file, -1 with
+///   errNo set
 //   Notes:
 //----------------------------------------------------------------------------
 ///
 
-bool NetworkOps::GetBinMsg(int *ptrRead, char **ptrMessage) {
-  bool bRet = false;
-  char *pcMess(0);
-
-  LockMutex();
-  int read = ReadMsg(&pcMess);
-
-  if (read < 0)
-    *ptrRead = 0;
-  else {
-    bRet = true;
-    *ptrRead = read;
-  }
-  *ptrMessage = pcMess;
-
-  UnlockMutex();
-  return bRet;
+long long NetworkOps::SendFileData(int fileNo, long long *pos,
+                                   long long count) {
+#ifdef __linux__
+  off_t off = (off_t)*pos;
+  ssize_t writen = sendfile(GetSockId(), fileNo, &off, (size_t)count);
+  *pos = off;
+  return writen;
+#else
+  (void)fileNo;
+  (void)pos;
+  (void)count;
+  errno = ENOSYS;
+  return (-1);
+#endif
 }
 
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   ReadMsg
+///   SendFileCopy
 //   Description:
-///   \brief Read a message from the remote host
+///   \brief SendFile reading the data through a buffer
 //   Parameters:
-///   @param std::string&
 //   Return:
-///   @return int
+///   @return long long - file bytes sent, or -1
 //   Notes:
+///   Must be called with m_SendMutex held. Used for user space TLS and
+///   where there is no sendfile. Each block holds as many whole packets
+///   as fit in one gather write. Blocks written zero copy are handed over
+///   to be held until the kernel is done with them, and a fresh one used.
 //----------------------------------------------------------------------------
 ///
 
-int NetworkOps::ReadMsg(std::string &message) {
-  char *ptr(0);
-  int len(0);
+long long NetworkOps::SendFileCopy(int fileNo, long long offset,
+                                   long long length, int packetsz,
+                                   FILEHDRFUNCPTR hdrFunc) {
+  int packets = 1;
+  size_t blockSize = FILEBLOCK;
+  if (hdrFunc) {
+    packets = std::max(1, std::min(FILEBLOCK / packetsz, SENDMAXVEC / 2));
+    blockSize = (size_t)packets * packetsz;
+  }
 
-  len = ReadMsg(&ptr);
-  if (len == 0) {
-    message = "";
-    return 0;
-  } else if (len < 0) {
-    message = "";
-    return -1;
+  /// Headers first, then the data
+  size_t headerSize = (size_t)packets * FILEHDRMAX;
+  bool bZeroCopy = (m_Profile.zeroCopy > 0 &&
+                    blockSize >= (size_t)m_Profile.zeroCopy);
+  std::string block;
+  long long done = 0;
+
+  while (done < length) {
+    if (block.size() != headerSize + blockSize) {
+      if (m_ZcNext != m_ZcDone)
+        (void)ReapCompletions();
+      block.swap(m_ZcSpare);
+      block.resize(headerSize + blockSize);
+    }
+    char *headers = &block[0];
+    char *data = &block[headerSize];
+
+    size_t want = (size_t)std::min((long long)blockSize, length - done);
+    int num_read = ReadFileAt(fileNo, data, want, offset + done);
+    if (num_read <= 0) {
+      SetError((num_read == 0) ? "- The file ended before it was all sent "
+                               : "- An error occurred reading a file to send ");
+      return (-1);
+    }
+
+    struct iovec vec[SENDMAXVEC];
+    int count = 0;
+    if (!hdrFunc) {
+      vec[count].iov_base = data;
+      vec[count++].iov_len = num_read;
+    } else {
+      for (int pos = 0, i = 0; pos < num_read; pos += packetsz, i++) {
+        int packet = std::min(packetsz, num_read - pos);
+        char *header = &headers[i * FILEHDRMAX];
+        vec[count].iov_base = header;
+        vec[count++].iov_len = hdrFunc(header, packet);
+        vec[count].iov_base = &data[pos];
+        vec[count++].iov_len = packet;
+      }
+    }
+
+    bool bOk = WriteAll(vec, count, bZeroCopy);
+    RetireBuffer(block);
+    if (!bOk)
+      return (-1);
+    done += num_read;
   }
-  message = ptr;
-  free(ptr);
-  return len;
+  return done;
 }
 
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   ReadMsg
+///   WriteAll
 //   Description:
-///   \brief Read a message from the remote host
+///   \brief Write a set of buffers completely, waiting if the socket fills
 //   Parameters:
-///   @param char **
+///   @param struct iovec *vec - updated as data goes out
+///   @param int count
+///   @param bool bZeroCopy - the buffers are retired with RetireBuffer
 //   Return:
-///   @return int
+///   @return bool
 //   Notes:
+///   Must be called with m_SendMutex held and nothing queued. Returns
+///   once the transport has written everything it took as well.
 //----------------------------------------------------------------------------
 ///
 
-int NetworkOps::ReadMsg(char **ptrMessage) {
-  char *ptr = 0;
-  char *tmp = 0;
-  int total_read = 0;
-  int num_read = 1;
-  int msgblk = DBLOCK; ///    1K read///
-  int nleft = 0;
-  int rsize = 0;
-  bool bCont = true;
-  bool bErr = false;
-
-  ptr = (char *)calloc(msgblk + 1, sizeof(char));
-  nleft = msgblk;
-  rsize = msgblk;
-  tmp = ptr;
-
-  /// Wait until something somes along to read///
-  if (!GetBlock()) {
-    if (!PollMsg(2)) {
-      free(ptr);
-      *ptrMessage = 0;
-      return 0;
-    }
-  } else
-    (void)PollMsg(-1);
-
-  while (bCont) {
-    do {
-      num_read = recv(GetSockId(), tmp, msgblk, 0);
-      if (num_read < 0) {
-        if (errNo == EINTR) {
-        } else if (errNo == EAGAIN || errNo == EWOULDBLOCK) {
-          bCont = false;
-          break;
-        } else {
-          bCont = false;
-          break;
-        }
+bool NetworkOps::WriteAll(struct iovec *vec, int count, bool bZeroCopy) {
+  while (count > 0 || GetTransportQueued() > 0) {
+    /// Past the last buffer vec is off the end of the caller's array
+    int writen = (count > 0) ? SendVec(vec, count, bZeroCopy)
+                             : SendVec(NULL, 0, false);
+    if (writen < 0) {
+      if (errNo == EAGAIN || errNo == EWOULDBLOCK) {
+        if (WaitSend(SENDWAIT))
+          continue;
+        SetError("- Timed out waiting to send to a socket ");
+        return false;
       }
-    } while (num_read < 0 && bCont);
 
-    if (num_read < 0 && !(errNo == EAGAIN || errNo == EWOULDBLOCK)) {
-      bErr = true;
-      // An error occurred
-      std::string errMsg("- An error occurred reading from a socket ");
+      std::string errMsg("- An error occurred writing to a socket ");
       char error[1024 + 1];
 #ifndef _WIN32
       if (strerror_r(errNo, error, sizeof(error)) == 0)
@@ -737,99 +1376,1669 @@ int NetworkOps::ReadMsg(char **ptrMessage) {
         errMsg += error;
 #endif
       SetError(&errMsg);
-      break;
+      return false;
     }
-    if (num_read == 0)
-      break;
-    total_read += num_read;
-    rsize += num_read;
-    nleft -= num_read;
-    if (nleft <= 0) {
-      /// Realloc memory on the fly///
-      ptr = (char *)realloc((char *)ptr, rsize + 1);
-      nleft = num_read;
-      tmp = ptr;
+
+    size_t left = writen;
+    while (count > 0 && left >= vec->iov_len) {
+      left -= vec->iov_len;
+      vec++;
+      count--;
+    }
+    if (count > 0) {
+      vec->iov_base = (char *)vec->iov_base + left;
+      vec->iov_len -= left;
     }
-    tmp = (char *)(tmp + total_read);
-    ///
-    /// If data read on pipe is less than msgblk then
-    /// we have (hopefully) we have finished reading
-    /// so break from loop ^_^
-    ///
-    ///
-    if (num_read < msgblk)
-      break;
   }
+  return true;
+}
 
-  if (IsDebug())
-    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] Read %d '%s'",
-                                 __FILE__, __LINE__, total_read,
-                                 (ptr) ? ptr : "");
-
-  if (total_read == 0) {
-    free(ptr);
-    *ptrMessage = 0;
-    if (!bErr)
-      return 0;
-    /// EOF error///
-    return (-1);
-  } else {
-    *ptrMessage = ptr;
-    return (1);
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SendMsg
+//   Description:
+///   Send a message to the remote host
+//   Parameters:
+//   Return:
+//   Notes:
+///   Must be called with m_SendMutex held. Returns once the whole outbound
+///   queue, this message included, has been written - or with loop owned
+///   I/O, once the event loop has it.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::SendMsg(void *pczMessage, int iMsgLen) {
+  if (pczMessage == 0)
+    return 0;
+
+  int writen = 0;
+  if (m_Submit == 0 && !HasQueuedMsgs()) {
+    ///   Nothing queued - try to write straight from the caller's buffer
+    struct iovec vec;
+    vec.iov_base = pczMessage;
+    vec.iov_len = iMsgLen;
+    if ((writen = SendVec(&vec, 1, false)) < 0) {
+      if (errNo != EAGAIN && errNo != EWOULDBLOCK) {
+        std::string errMsg("- An error occurred writing to a socket ");
+        char error[1024 + 1];
+#ifndef _WIN32
+        if (strerror_r(errNo, error, sizeof(error)) == 0)
+          errMsg += error;
+#else
+        if (strerror_s(error, sizeof(error), errNo) == 0)
+          errMsg += error;
+#endif
+        SetError(&errMsg);
+        return (-1);
+      }
+      writen = 0;
+    }
+  }
+
+  ///
+  /// Anything left goes out behind whatever is already queued, so
+  /// ordering is kept and the lot is written together
+  ///
+  QueueMsg((const char *)pczMessage + writen, iMsgLen - writen);
+
+  if (m_Submit != 0)
+    return (SendQueued() < 0) ? -1 : iMsgLen;
+
+  while (HasQueuedMsgs()) {
+    if (SendQueued() < 0)
+      return (-1);
+    if (HasQueuedMsgs() && !WaitSend(SENDWAIT)) {
+      SetError("- Timed out waiting to send to a socket ");
+      return (-1);
+    }
   }
+
+  if (IsDebug())
+    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] Sent %d", __FILE__,
+                                 __LINE__, iMsgLen);
+
+  return (iMsgLen);
 }
 
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   PollMsg
+///   PostMsg
 //   Description:
-///   Function to see if message pending for reading
+///   \brief Queue a message to be sent by the next flush
 //   Parameters:
-///   INT              secs    - Timeout period
+///   @param const char *pczMessage
+///   @param int iMsgLen
 //   Return:
-///   INT 1 if pending, else 0
+///   @return bool
 //   Notes:
+///   Never blocks. Producers should back off while IsThrottled().
 //----------------------------------------------------------------------------
 ///
 
-bool NetworkOps::PollMsg(int secs) {
-  fd_set readfds;
-  int nbits = 0;
-  int fds = 0;
-  bool bRet = false;
+bool NetworkOps::PostMsg(const char *pczMessage, int iMsgLen) {
+  if (!IsConnected() || pczMessage == 0)
+    return false;
 
-  /// Time out period///
-  struct timeval timeout = {0};
-  struct timeval *timex = 0;
+  m_SendMutex.Lock();
+  QueueMsg(pczMessage, iMsgLen);
+  m_SendMutex.Unlock();
+  return true;
+}
 
-  if (GetSockId() >= fds)
-    fds = GetSockId() + 1;
-  else
-    fds = GetSockId();
+bool NetworkOps::PostMsg(const std::string &message) {
+  return PostMsg(message.c_str(), (int)message.length());
+}
 
-  FD_ZERO(&readfds);
-  FD_SET(GetSockId(), &readfds);
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   FlushMsgs
+//   Description:
+///   \brief Write out the outbound queue
+//   Parameters:
+///   @param bool bWait - keep going until the queue is empty
+//   Return:
+///   @return int - bytes still queued, -1 on error
+//   Notes:
+///   Without bWait, whatever the socket will not take now stays queued for
+///   the next flush, e.g. when the event loop reports it writable.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::FlushMsgs(bool bWait) {
+  if (!IsConnected())
+    return (-1);
 
-  /// Timeout period in secs///
-  timeout.tv_sec = secs;
+  m_SendMutex.Lock();
+  int iRet = 0;
+  while (HasQueuedMsgs()) {
+    if ((iRet = SendQueued()) < 0)
+      break;
+    if (!bWait || !HasQueuedMsgs())
+      break;
+    if (!WaitSend(SENDWAIT)) {
+      SetError("- Timed out waiting to send to a socket ");
+      iRet = -1;
+      break;
+    }
+  }
+  if (iRet >= 0)
+    iRet = (int)(m_SendQueued + GetTransportQueued());
+  m_SendMutex.Unlock();
+  return iRet;
+}
 
-  /// Select and process the results. Allow for signal delivery.///
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   QueueMsg
+//   Description:
+///   \brief Add a message to the outbound queue
+//   Parameters:
+///   @param const char *pczMessage
+///   @param int iMsgLen
+//   Return:
+//   Notes:
+///   Must be called with m_SendMutex held
+//----------------------------------------------------------------------------
+///
 
-  if (secs < 0)
-    timex = 0;
-  else
-    timex = &timeout;
+void NetworkOps::QueueMsg(const char *pczMessage, int iMsgLen) {
+  if (iMsgLen <= 0)
+    return;
 
-  nbits = select(fds, (fd_set *)&readfds, (fd_set *)0, (fd_set *)0,
-                 (struct timeval *)timex);
-  if (nbits > 0 && FD_ISSET(GetSockId(), &readfds))
-    bRet = true;
-  if (nbits < 0)
-    bRet = false;
+  m_SendQueue.push_back(std::string(pczMessage, iMsgLen));
+  m_SendQueued += iMsgLen;
+  if (m_SendQueued >= m_HighWater)
+    m_Throttled = true;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SendQueued
+//   Description:
+///   \brief Write as much of the outbound queue as the socket will take
+//   Parameters:
+//   Return:
+///   @return int - bytes written, -1 on error
+//   Notes:
+///   Must be called with m_SendMutex held. Gathers up to SENDMAXVEC queued
+///   messages into each write. With loop owned I/O the queue is handed to
+///   the event loop instead, and nothing is written here.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::SendQueued(void) {
+  int total = 0;
+
+  if (m_Submit != 0) {
+    if (m_SendQueued > 0 && !(*m_Submit)(this, m_SubmitParam)) {
+      SetError("- Unable to hand the outbound queue to the event loop ");
+      return (-1);
+    }
+    return 0;
+  }
+
+  if (m_ZcNext != m_ZcDone)
+    (void)ReapCompletions();
+
+  while (HasQueuedMsgs()) {
+    struct iovec vec[SENDMAXVEC];
+    int count = 0;
+    size_t want = 0;
+
+    for (std::deque<std::string>::iterator it = m_SendQueue.begin();
+         it != m_SendQueue.end() && count < SENDMAXVEC; ++it, count++) {
+      size_t offset = (count == 0) ? m_SendOffset : 0;
+      vec[count].iov_base = (void *)(it->data() + offset);
+      vec[count].iov_len = it->length() - offset;
+      want += vec[count].iov_len;
+    }
+
+    int writen = SendVec(vec, count,
+                         m_Profile.zeroCopy > 0 &&
+                             want >= (size_t)m_Profile.zeroCopy);
+    if (writen < 0) {
+      if (errNo == EAGAIN || errNo == EWOULDBLOCK)
+        break;
+
+      std::string errMsg("- An error occurred writing to a socket ");
+      char error[1024 + 1];
+#ifndef _WIN32
+      if (strerror_r(errNo, error, sizeof(error)) == 0)
+        errMsg += error;
+#else
+      if (strerror_s(error, sizeof(error), errNo) == 0)
+        errMsg += error;
+#endif
+      SetError(&errMsg);
+      return (-1);
+    }
+
+    /// Retire whatever went out
+    size_t left = writen;
+    m_SendQueued -= left;
+    total += writen;
+    while (left > 0) {
+      size_t front = m_SendQueue.front().length() - m_SendOffset;
+      if (left < front) {
+        m_SendOffset += left;
+        break;
+      }
+      left -= front;
+      RetireBuffer(m_SendQueue.front());
+      m_SendQueue.pop_front();
+      m_SendOffset = 0;
+    }
+
+    if ((size_t)writen < want)
+      break;
+  }
+
+  if (m_Throttled && m_SendQueued <= m_LowWater)
+    m_Throttled = false;
+  return total;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WriteVec
+//   Description:
+///   \brief Gather write to the socket
+//   Parameters:
+///   @param struct iovec *vec
+///   @param int count
+//   Return:
+///   @return int - bytes written or -1
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::WriteVec(struct iovec *vec, int count) {
+  int writen = 0;
+
+  if (count <= 0)
+    return 0;
+
+#ifndef _WIN32
+  struct msghdr msg = {0};
+  msg.msg_iov = vec;
+  msg.msg_iovlen = count;
+#ifdef MSG_NOSIGNAL
+  int flags = MSG_NOSIGNAL;
+#else
+  int flags = 0;
+#endif
+  do
+    writen = sendmsg(GetSockId(), &msg, flags);
+  while (writen < 0 && errNo == EINTR);
+#else
+  (void)count;
+  do
+    writen = send(GetSockId(), (const char *)vec[0].iov_base,
+                  (int)vec[0].iov_len, 0);
+  while (writen < 0 && errNo == EINTR);
+#endif
+  return writen;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SendVec
+//   Description:
+///   \brief Gather write, zero copy if asked for and enabled
+//   Parameters:
+///   @param struct iovec *vec
+///   @param int count
+///   @param bool bZeroCopy - the buffers are owned here and retired with
+///   RetireBuffer, never reused straight away
+//   Return:
+///   @return int - bytes written or -1
+//   Notes:
+///   Must be called with m_SendMutex held
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::SendVec(struct iovec *vec, int count, bool bZeroCopy) {
+  int writen = 0;
+
+#if defined(MSG_ZEROCOPY) && defined(MSG_NOSIGNAL)
+  if (bZeroCopy && m_ZcEnabled && CanZeroCopy()) {
+    struct msghdr msg = {0};
+    msg.msg_iov = vec;
+    msg.msg_iovlen = count;
+    do
+      writen = sendmsg(GetSockId(), &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+    while (writen < 0 && errNo == EINTR);
+
+    /// Only a write that took something is given a sequence number
+    if (writen > 0) {
+      m_ZcNext++;
+      m_ZcUsed = true;
+      m_ZcBytes += writen;
+      return writen;
+    }
+    /// Out of memory to pin the pages with - copy this one instead
+    if (writen == 0 || errNo != ENOBUFS)
+      return writen;
+  }
+#else
+  (void)bZeroCopy;
+#endif
+
+  writen = WriteVec(vec, count);
+  if (writen > 0)
+    m_CopyBytes += writen;
+  return writen;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RetireBuffer
+//   Description:
+///   \brief Finish with a buffer that has been written
+//   Parameters:
+///   @param std::string &buffer - emptied if it has to be held
+//   Return:
+//   Notes:
+///   Must be called with m_SendMutex held. While any zero copy write is
+///   outstanding the buffer may still be pinned, so it is kept until the
+///   last write made so far completes.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::RetireBuffer(std::string &buffer) {
+  if (m_ZcNext == m_ZcDone)
+    return;
+
+  m_ZcHeld.push_back(std::make_pair(m_ZcNext - 1, std::string()));
+  m_ZcHeld.back().second.swap(buffer);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReapCompletions
+//   Description:
+///   \brief Collect zero copy completions from the socket error queue
+//   Parameters:
+//   Return:
+///   @return int - zero copy writes completed
+//   Notes:
+///   Must be called with m_SendMutex held. Held buffers are released as
+///   the completed sequence catches up with them. If the kernel reports it
+///   had to copy anyway (loopback, a device without scatter gather) zero
+///   copy is turned off for the connection, as it only adds overhead.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::ReapCompletions(void) {
+  int reaped = 0;
+
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+  for (;;) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err) +
+                            sizeof(struct sockaddr_in6))];
+    struct msghdr msg = {0};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    int ret = recvmsg(GetSockId(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+    if (ret < 0 && errNo == EINTR)
+      continue;
+    if (ret < 0)
+      break;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != 0;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+        continue;
+
+      struct sock_extended_err *err =
+          (struct sock_extended_err *)CMSG_DATA(cmsg);
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0)
+        continue;
+
+      if ((err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && m_ZcEnabled) {
+        m_ZcEnabled = false;
+        if (IsDebug())
+          (void)DebugUtils::LogMessage(
+              MSGINFO, "Debug: [%s,%d] Socket %d copies anyway, zero copy off",
+              __FILE__, __LINE__, GetSockId());
+      }
+      m_ZcRanges[err->ee_info] = err->ee_data;
+      reaped += (int)(err->ee_data - err->ee_info + 1);
+    }
+  }
+
+  /// Ranges can be reported out of order
+  std::map<unsigned, unsigned>::iterator it;
+  while ((it = m_ZcRanges.find(m_ZcDone)) != m_ZcRanges.end()) {
+    m_ZcDone = it->second + 1;
+    m_ZcRanges.erase(it);
+  }
+
+  while (!m_ZcHeld.empty() && (int)(m_ZcHeld.front().first - m_ZcDone) < 0) {
+    m_ZcSpare.swap(m_ZcHeld.front().second);
+    m_ZcHeld.pop_front();
+  }
+#endif
+  return reaped;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   IsHungUp
+//   Description:
+///   \brief Check whether an error or hang up report is real
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   Zero copy completions raise POLLERR like a socket error does. Pollers
+///   that see it call this to collect them, and only treat the connection
+///   as broken if something is still reported afterwards. Without any zero
+///   copy writes the report always stands.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::IsHungUp(void) {
+  if (!IsConnected() || !m_ZcUsed)
+    return true;
+
+#ifndef _WIN32
+  m_SendMutex.Lock();
+  (void)ReapCompletions();
+  m_SendMutex.Unlock();
+
+  struct pollfd pfd = {0};
+  pfd.fd = GetSockId();
+#ifdef POLLRDHUP
+  pfd.events = POLLRDHUP;
+#endif
+  if (poll(&pfd, 1, 0) <= 0)
+    return false;
+#ifdef POLLRDHUP
+  return ((pfd.revents & (POLLHUP | POLLERR | POLLRDHUP)) != 0);
+#else
+  return ((pfd.revents & (POLLHUP | POLLERR)) != 0);
+#endif
+#else
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WaitSend
+//   Description:
+///   \brief Wait for the socket to accept more data
+//   Parameters:
+///   @param int millisecs - timeout, -1 to wait forever
+//   Return:
+///   @return bool
+//   Notes:
+///   Must be called with m_SendMutex held once zero copy writes have been
+///   made, their completions are collected here while waiting. With loop
+///   owned I/O this waits for the event loop to finish its send, checking
+///   each millisecond.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::WaitSend(int millisecs) {
+  if (!IsConnected())
+    return false;
+
+  if (m_Submit != 0) {
+    long long deadline = GetTimeMs() + millisecs;
+    while (m_LoopQueued > 0) {
+      if (millisecs >= 0 && GetTimeMs() >= deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+
+#ifndef _WIN32
+  struct pollfd pfd = {0};
+  pfd.fd = GetSockId();
+  pfd.events = POLLOUT;
+  if (WriteWantsRead())
+    pfd.events |= POLLIN;
+
+  long long deadline = GetTimeMs() + millisecs;
+  for (;;) {
+    int nready = poll(&pfd, 1, millisecs);
+    if (nready > 0) {
+      if (pfd.revents & pfd.events)
+        return true;
+      if (!(pfd.revents & POLLERR) || !m_ZcUsed)
+        return false;
+      if (ReapCompletions() <= 0)
+        return false;
+    } else if (nready == 0 || errNo != EINTR)
+      return false;
+    if (millisecs >= 0) {
+      long long left = deadline - GetTimeMs();
+      millisecs = (left > 0) ? (int)left : 0;
+    }
+  }
+#else
+  fd_set writefds;
+  FD_ZERO(&writefds);
+  FD_SET(GetSockId(), &writefds);
+
+  struct timeval timeout = {0};
+  timeout.tv_sec = millisecs / 1000;
+  timeout.tv_usec = (millisecs % 1000) * 1000;
+
+  return (select(0, (fd_set *)0, &writefds, (fd_set *)0,
+                 (millisecs < 0) ? (struct timeval *)0
+                                 : (struct timeval *)&timeout) > 0);
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetMsg
+//   Description:
+///   \brief Wrapper public function to read a message
+//   Parameters:
+///   @param int *ptrRead
+///   @param std::string message
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::GetBinMsg(int *ptrRead, std::string &message) {
+  bool bRet = false;
+
+  m_RecvMutex.Lock();
+  int read = ReadMsg(message);
+
+  if (read < 0)
+    *ptrRead = 0;
+  else {
+    bRet = true;
+    *ptrRead = read;
+  }
+  m_RecvMutex.Unlock();
+  return bRet;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetMsg
+//   Description:
+///   \brief Wrapper public function to read a message
+//   Parameters:
+///   @param int *ptrRead
+///   @param char **ptrMessage
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::GetBinMsg(int *ptrRead, char **ptrMessage) {
+  bool bRet = false;
+  char *pcMess(0);
+
+  m_RecvMutex.Lock();
+  int read = ReadMsg(&pcMess);
+
+  if (read < 0)
+    *ptrRead = 0;
+  else {
+    bRet = true;
+    *ptrRead = read;
+  }
+  *ptrMessage = pcMess;
+
+  m_RecvMutex.Unlock();
+  return bRet;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetFrames
+//   Description:
+///   \brief Read and split the stream into complete protocol frames
+//   Parameters:
+///   @param FRAMELENFUNCPTR func - protocol framer
+///   @param std::vector<std::string> &frames - every complete frame held,
+///          or as BufSlice views of one shared copy
+///   @param bool bWait - wait for data if no frame is held yet
+///   @param std::vector<long long> *stamps - if given, the kernel arrival
+///          time of each frame (wall clock ns), 0 where there is none
+//   Return:
+///   @return bool - false on a read error, or data that can't be framed
+//   Notes:
+///   A trailing partial frame stays buffered until the rest arrives.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::GetFrames(FRAMELENFUNCPTR func,
+                           std::vector<std::string> &frames, bool bWait,
+                           std::vector<long long> *stamps) {
+  frames.clear();
+  if (stamps)
+    stamps->clear();
+
+  m_RecvMutex.Lock();
+  bool bOk = TakeFrames(func, frames, stamps);
+
+  int read = 0;
+  if (bOk) {
+    read = FillMsg((bWait && frames.empty()) ? GetWait() : 0);
+    bOk = TakeFrames(func, frames, stamps);
+  }
+
+  m_RecvMutex.Unlock();
+  return bOk && (read >= 0 || !frames.empty());
+}
+
+bool NetworkOps::GetFrames(FRAMELENFUNCPTR func, std::vector<BufSlice> &frames,
+                           bool bWait, std::vector<long long> *stamps) {
+  frames.clear();
+  if (stamps)
+    stamps->clear();
+
+  m_RecvMutex.Lock();
+  bool bOk = TakeFrames(func, frames, stamps);
+
+  int read = 0;
+  if (bOk) {
+    read = FillMsg((bWait && frames.empty()) ? GetWait() : 0);
+    bOk = TakeFrames(func, frames, stamps);
+  }
+
+  m_RecvMutex.Unlock();
+  return bOk && (read >= 0 || !frames.empty());
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   TakeFrames
+//   Description:
+///   \brief Move every complete frame out of the receive buffer
+//   Parameters:
+///   @param FRAMELENFUNCPTR func
+///   @param std::vector<std::string> &frames (or BufSlice)
+///   @param std::vector<long long> *stamps - arrival times, may be 0
+//   Return:
+///   @return bool - false if the framer rejected the data
+//   Notes:
+///   As slices, every complete frame held goes into one shared chunk, so
+///   a batch costs one allocation and one copy however many it holds.
+///   Frames before a rejected one are still handed over.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::TakeFrames(FRAMELENFUNCPTR func,
+                            std::vector<std::string> &frames,
+                            std::vector<long long> *stamps) {
+  while (!m_RecvBuf.empty()) {
+    const char *ptr = m_RecvBuf.Linearize();
+    int len = (*func)(ptr, (int)m_RecvBuf.size());
+    if (len < 0) {
+      BadFrame();
+      return false;
+    }
+    if (len == 0 || len > (int)m_RecvBuf.size())
+      break;
+    frames.push_back(std::string(ptr, len));
+    m_RecvBuf.Consume(len);
+    if (stamps)
+      stamps->push_back(GetArrival());
+  }
+  return true;
+}
+
+bool NetworkOps::TakeFrames(FRAMELENFUNCPTR func,
+                            std::vector<BufSlice> &frames,
+                            std::vector<long long> *stamps) {
+  if (m_RecvBuf.empty())
+    return true;
+
+  const char *ptr = m_RecvBuf.Linearize();
+  size_t held = m_RecvBuf.size();
+  size_t total = 0;
+  bool bOk = true;
+  while (total < held) {
+    int len = (*func)(ptr + total, (int)(held - total));
+    if (len < 0)
+      bOk = false;
+    if (len <= 0 || len > (int)(held - total))
+      break;
+    total += len;
+  }
+  if (total == 0) {
+    if (!bOk)
+      BadFrame();
+    return bOk;
+  }
+
+  BufSlice chunk(ptr, total);
+  for (size_t offset = 0; offset < total;) {
+    int len = (*func)(chunk.data() + offset, (int)(total - offset));
+    frames.push_back(chunk.Sub(offset, len));
+    m_RecvBuf.Consume(len);
+    if (stamps)
+      stamps->push_back(GetArrival());
+    offset += len;
+  }
+  if (!bOk)
+    BadFrame();
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BadFrame
+//   Description:
+///   \brief Give up on a stream that can't be framed
+//   Parameters:
+//   Return:
+//   Notes:
+///   What is held is dropped and the peer treated as gone, so the
+///   connection is closed the way a hang up is rather than buffering
+///   for ever. Must be called with m_RecvMutex held.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::BadFrame(void) {
+  SetError("- A frame too large, or malformed, was received ");
+  m_RecvBuf.clear();
+  m_PeerClosed = true;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetArrival
+//   Description:
+///   \brief Arrival time of the data just taken from the receive buffer
+//   Parameters:
+//   Return:
+///   @return long long - wall clock ns, 0 if not known
+//   Notes:
+///   That of the read holding the last byte taken, so when the frame was
+///   complete. Must be called with m_RecvMutex held.
+//----------------------------------------------------------------------------
+///
+
+long long NetworkOps::GetArrival(void) {
+  if (m_RecvStamps.empty())
+    return 0;
+
+  unsigned long long taken = m_RecvTotal - m_RecvBuf.size();
+  while (!m_RecvStamps.empty() && m_RecvStamps.front().first < taken)
+    m_RecvStamps.pop_front();
+  return (m_RecvStamps.empty()) ? 0 : m_RecvStamps.front().second;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReadMsg
+//   Description:
+///   \brief Read a message from the remote host
+//   Parameters:
+///   @param std::string&
+//   Return:
+///   @return int
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::ReadMsg(std::string &message) {
+  int len = FillMsg((m_RecvBuf.empty()) ? GetWait() : 0);
+
+  if (len <= 0) {
+    message = "";
+    return len;
+  }
+
+  ///   Hand the data over straight from the ring
+  message.assign(m_RecvBuf.Linearize(), m_RecvBuf.size());
+  m_RecvBuf.Consume(m_RecvBuf.size());
+  return len;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReadMsg
+//   Description:
+///   \brief Read a message from the remote host
+//   Parameters:
+///   @param char **
+//   Return:
+///   @return int
+//   Notes:
+///   The caller owns (and frees) the returned buffer
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::ReadMsg(char **ptrMessage) {
+  int len = FillMsg((m_RecvBuf.empty()) ? GetWait() : 0);
+
+  *ptrMessage = 0;
+  if (len <= 0)
+    return len;
+
+  size_t size = m_RecvBuf.size();
+  char *ptr = (char *)malloc(size + 1);
+  if (ptr == 0) {
+    SetError("- Unable to allocate memory for a message");
+    return (-1);
+  }
+  memcpy(ptr, m_RecvBuf.Linearize(), size);
+  ptr[size] = '\0';
+  m_RecvBuf.Consume(size);
+
+  *ptrMessage = ptr;
+  return (1);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   FillMsg
+//   Description:
+///   \brief Wait for a message and pull it into the receive buffer
+//   Parameters:
+///   @param int millisecs - how long to wait for new data, -1 for ever
+//   Return:
+///   @return int - bytes now held, 0 if nothing arrived, -1 on error
+//   Notes:
+///   A wakeup that yields nothing (TLS reading half a record, or a session
+///   ticket) goes back to waiting for whatever time is left
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::FillMsg(int millisecs) {
+  long long deadline = (millisecs < 0) ? -1 : GetTimeMs() + millisecs;
+  bool bReady = false;
+  int num_read = 0;
+
+  /// Wait until something somes along to read///
+  do {
+    bReady = IsPending() || IsStaged() || WaitMsgUntil(deadline);
+    num_read = (bReady) ? FillBuffer() : 0;
+  } while (bReady && num_read == 0 && m_RecvBuf.empty() && !m_PeerClosed &&
+           (deadline < 0 || GetTimeMs() < deadline));
+
+  if (IsDebug() && bReady)
+    (void)DebugUtils::LogMessage(MSGINFO, "Debug: [%s,%d] Read %d of %d",
+                                 __FILE__, __LINE__, num_read,
+                                 (int)m_RecvBuf.size());
+
+  if (num_read < 0 && m_RecvBuf.empty())
+    return (-1);
+  return (int)m_RecvBuf.size();
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   FillBuffer
+//   Description:
+///   \brief Read whatever the socket has pending into the receive buffer
+//   Parameters:
+//   Return:
+///   @return int - bytes read, 0 if none (or EOF), -1 on error
+//   Notes:
+///   Reads straight into the ring's free space and keeps going while each
+///   read fills it, so a burst is collected without any extra copies.
+///   With loop owned I/O, takes what the event loop received instead.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::FillBuffer(void) {
+  int total_read = 0;
+
+  if (m_WaitId != -1 && (m_Delivered || IsStaged()))
+    return TakeDelivered();
+
+#ifdef MSG_DONTWAIT
+  /// Only called once data is known to be there, so never block///
+  int flags = MSG_DONTWAIT;
+#else
+  int flags = 0;
+#endif
+
+  for (;;) {
+    struct iovec vec[2];
+    m_RecvBuf.Reserve(DBLOCK);
+    int count = m_RecvBuf.GetFreeVec(vec);
+    size_t want = vec[0].iov_len + ((count > 1) ? vec[1].iov_len : 0);
+
+    int num_read = 0;
+    long long stamp = 0;
+    do {
+#ifndef _WIN32
+      struct msghdr msg = {0};
+      msg.msg_iov = vec;
+      msg.msg_iovlen = count;
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+      char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+      if (m_RxStamps) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+      }
+#endif
+      num_read = recvmsg(GetSockId(), &msg, flags);
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+      ///   Software stamps come in the first slot, as wall clock time
+      for (struct cmsghdr *cmsg = (m_RxStamps && num_read > 0)
+                                      ? CMSG_FIRSTHDR(&msg)
+                                      : NULL;
+           cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_TIMESTAMPING) {
+          struct scm_timestamping ts;
+          memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+          stamp = ts.ts[0].tv_sec * 1000000000LL + ts.ts[0].tv_nsec;
+        }
+      }
+#endif
+#else
+      want = vec[0].iov_len;
+      num_read = recv(GetSockId(), (char *)vec[0].iov_base, (int)want, flags);
+#endif
+    } while (num_read < 0 && errNo == EINTR);
+
+    if (num_read < 0) {
+      if (errNo == EAGAIN || errNo == EWOULDBLOCK)
+        break;
+
+      // An error occurred
+      std::string errMsg("- An error occurred reading from a socket ");
+      char error[1024 + 1];
+#ifndef _WIN32
+      if (strerror_r(errNo, error, sizeof(error)) == 0)
+        errMsg += error;
+#else
+      if (strerror_s(error, sizeof(error), errNo) == 0)
+        errMsg += error;
+#endif
+      SetError(&errMsg);
+      return (total_read > 0) ? total_read : -1;
+    }
+
+    if (num_read == 0) {
+      m_PeerClosed = true;
+      break;
+    }
+
+    m_RecvBuf.Commit(num_read);
+    total_read += num_read;
+    m_RecvTotal += num_read;
+    if (stamp != 0) {
+      ///   Stamps for data already handed out are no longer wanted
+      unsigned long long taken = m_RecvTotal - m_RecvBuf.size();
+      while (!m_RecvStamps.empty() && m_RecvStamps.front().first <= taken)
+        m_RecvStamps.pop_front();
+      m_RecvStamps.push_back(std::make_pair(m_RecvTotal, stamp));
+    }
+
+#ifdef TCP_QUICKACK
+    /// Linux drops back to delayed acks on its own, so keep it armed
+    if (m_Profile.quickAck > 0)
+      SetTcpOption(GetSockId(), IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
+
+    ///
+    /// A short read means the socket has (hopefully) been drained
+    ///
+    if ((size_t)num_read < want || flags == 0)
+      break;
+  }
+  return total_read;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   StartDelivery
+//   Description:
+///   \brief Hand the socket's reads and writes over to the event loop
+//   Parameters:
+///   @param SENDSUBMITFUNCPTR func - called when there is something to send
+///   @param void *param - handed to func
+//   Return:
+///   @return bool - false if this connection can't be read for (TLS,
+///   receive timestamps) or there is no eventfd
+//   Notes:
+///   The loop must be receiving before anything else reads the socket.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::StartDelivery(SENDSUBMITFUNCPTR func, void *param) {
+  if (!IsConnected() || func == 0 || !CanDeliver())
+    return false;
+
+#ifdef __linux__
+  if (m_WaitId == -1 &&
+      (m_WaitId = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+    m_WaitId = -1;
+    SetError("- Unable to create a delivery eventfd ");
+    return false;
+  }
+
+  m_SendMutex.Lock();
+  m_DeliverMutex.Lock();
+  m_Delivered = true;
+  m_StagedEnd = false;
+  m_StagedErr = 0;
+  m_Submit = func;
+  m_SubmitParam = param;
+  m_DeliverMutex.Unlock();
+  m_SendMutex.Unlock();
+  return true;
+#else
+  (void)param;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   StopDelivery
+//   Description:
+///   \brief Go back to reading and writing the socket directly
+//   Parameters:
+//   Return:
+//   Notes:
+///   Anything already delivered is still read first. A reader waiting on
+///   the eventfd is woken, so it goes back to waiting on the socket.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::StopDelivery(void) {
+  m_SendMutex.Lock();
+  m_Submit = 0;
+  m_SubmitParam = 0;
+  m_LoopQueued = 0;
+  m_SendMutex.Unlock();
+
+  m_DeliverMutex.Lock();
+  m_Delivered = false;
+  Signal();
+  m_DeliverMutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Deliver
+//   Description:
+///   \brief Stage data the event loop received for the next read
+//   Parameters:
+///   @param const char *data
+///   @param int len
+//   Return:
+//   Notes:
+///   Called by the loop, which never waits on a reader - the staging
+///   buffer has its own lock. Dropped once delivery has stopped.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::Deliver(const char *data, int len) {
+  if (len <= 0)
+    return;
+
+  m_DeliverMutex.Lock();
+  if (m_Delivered) {
+    m_Staged.Append(data, len);
+    Signal();
+  }
+  m_DeliverMutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   DeliverEnd
+//   Description:
+///   \brief Stage the end of the stream, once what came before is read
+//   Parameters:
+///   @param int errCode - 0 for end of file, else the errno
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::DeliverEnd(int errCode) {
+  m_DeliverMutex.Lock();
+  if (m_Delivered && !m_StagedEnd) {
+    m_StagedEnd = true;
+    m_StagedErr = errCode;
+    Signal();
+  }
+  m_DeliverMutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   TakeDelivered
+//   Description:
+///   \brief Move what the event loop delivered into the receive buffer
+//   Parameters:
+//   Return:
+///   @return int - bytes taken, 0 if none (or EOF), -1 on error
+//   Notes:
+///   Must be called with m_RecvMutex held. Into an empty receive buffer
+///   the staging buffer is swapped, not copied.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::TakeDelivered(void) {
+  m_DeliverMutex.Lock();
+  size_t len = m_Staged.size();
+  if (len > 0) {
+    if (m_RecvBuf.empty())
+      m_RecvBuf.swap(m_Staged);
+    else {
+      struct iovec vec[2];
+      int nvec = m_Staged.GetDataVec(vec);
+      for (int i = 0; i < nvec; i++)
+        m_RecvBuf.Append((const char *)vec[i].iov_base, vec[i].iov_len);
+      m_Staged.Consume(len);
+    }
+    m_RecvTotal += len;
+  }
+  bool bEnd = (m_StagedEnd && m_Staged.empty());
+  int errCode = m_StagedErr;
+  m_DeliverMutex.Unlock();
+
+  if (len > 0 || !bEnd)
+    return (int)len;
+
+  if (errCode == 0) {
+    m_PeerClosed = true;
+    return 0;
+  }
+
+  std::string errMsg("- An error occurred reading from a socket ");
+  char error[1024 + 1];
+#ifndef _WIN32
+  if (strerror_r(errCode, error, sizeof(error)) == 0)
+    errMsg += error;
+#endif
+  SetError(&errMsg);
+  return (-1);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   IsStaged
+//   Description:
+///   \brief Whether the event loop has delivered anything not yet read
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   The end of the stream counts, so the read that follows reports it
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::IsStaged(void) {
+  if (m_WaitId == -1)
+    return false;
+
+  m_DeliverMutex.Lock();
+  bool bStaged = (!m_Staged.empty() || m_StagedEnd);
+  m_DeliverMutex.Unlock();
+  return bStaged;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   AddWaiter
+//   Description:
+///   \brief Register to be woken through the eventfd by the next delivery
+//   Parameters:
+//   Return:
+///   @return bool - true if there is something to read already
+//   Notes:
+///   Each call must be matched by a DropWaiter once the wait is over.
+///   Delivery having stopped counts as something to read, so the waiter
+///   goes back to the socket.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::AddWaiter(void) {
+  m_DeliverMutex.Lock();
+  m_Waiters++;
+  bool bReady = (!m_Staged.empty() || m_StagedEnd || !m_Delivered);
+  m_DeliverMutex.Unlock();
+  return bReady;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   DropWaiter
+//   Description:
+///   \brief End a wait started with AddWaiter
+//   Parameters:
+//   Return:
+///   @return bool - true if there is something to read now
+//   Notes:
+///   The last waiter out clears the eventfd
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::DropWaiter(void) {
+  m_DeliverMutex.Lock();
+  if (--m_Waiters == 0 && m_Signalled) {
+#ifndef _WIN32
+    unsigned long long count = 0;
+    (void)read(m_WaitId, &count, sizeof(count));
+#endif
+    m_Signalled = false;
+  }
+  bool bReady = (!m_Staged.empty() || m_StagedEnd || !m_Delivered);
+  m_DeliverMutex.Unlock();
+  return bReady;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Signal
+//   Description:
+///   \brief Wake anyone waiting on the eventfd
+//   Parameters:
+//   Return:
+//   Notes:
+///   Must be called with m_DeliverMutex held. Only writes while there is
+///   a waiter and it isn't signalled already, so a connection whose
+///   reader just takes what is staged costs the loop no call.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::Signal(void) {
+  if (m_Waiters > 0 && !m_Signalled && m_WaitId != -1) {
+#ifndef _WIN32
+    unsigned long long one = 1;
+    (void)write(m_WaitId, &one, sizeof(one));
+#endif
+    m_Signalled = true;
+  }
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   TakeQueued
+//   Description:
+///   \brief Hand the whole outbound queue to the event loop to send
+//   Parameters:
+///   @param std::deque<std::string> &bufs - must be empty, the queued
+///   buffers are swapped into it
+///   @param size_t &offset - set to what of the first was already sent
+//   Return:
+///   @return size_t - bytes handed over
+//   Notes:
+///   Must be called with m_SendMutex held, so from the send hook. The
+///   bytes count as queued until the loop reports them with SendDone.
+//----------------------------------------------------------------------------
+///
+
+size_t NetworkOps::TakeQueued(std::deque<std::string> &bufs, size_t &offset) {
+  size_t bytes = m_SendQueued;
+
+  bufs.swap(m_SendQueue);
+  offset = m_SendOffset;
+  m_SendOffset = 0;
+  m_SendQueued = 0;
+  m_LoopQueued += bytes;
+  if (m_Throttled && m_SendQueued <= m_LowWater)
+    m_Throttled = false;
+  return bytes;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SendDone
+//   Description:
+///   \brief The event loop has finished sending bytes it took
+//   Parameters:
+///   @param size_t bytes
+//   Return:
+//   Notes:
+///   Called by the loop under its own lock, which the send hook takes with
+///   m_SendMutex held, so this doesn't take m_SendMutex. Never goes below
+///   0, a disconnect may have reset it.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::SendDone(size_t bytes) {
+  size_t held = m_LoopQueued;
+  while (!m_LoopQueued.compare_exchange_weak(
+      held, (bytes < held) ? held - bytes : 0))
+    ;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   PollMsg
+//   Description:
+///   Function to see if message pending for reading
+//   Parameters:
+///   INT              secs    - Timeout period
+//   Return:
+///   INT 1 if pending, else 0
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::PollMsg(int secs) {
+  return WaitMsg((secs < 0) ? -1 : secs * 1000);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetTimeMs
+//   Description:
+///   \brief Monotonic time in milliseconds, for deadlines
+//   Parameters:
+//   Return:
+///   @return long long
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+long long NetworkOps::GetTimeMs(void) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetTimeUs
+//   Description:
+///   \brief Monotonic time in microseconds, for timing round trips
+//   Parameters:
+//   Return:
+///   @return long long
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+long long NetworkOps::GetTimeUs(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WaitMsg
+//   Description:
+///   \brief Wait for a message to be pending for reading
+//   Parameters:
+///   @param int millisecs - timeout, -1 to wait forever, 0 to just check
+//   Return:
+///   @return bool - true if pending
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::WaitMsg(int millisecs) {
+  if (millisecs < 0)
+    return WaitMsgUntil(-1);
+  return WaitMsgUntil(GetTimeMs() + millisecs);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WaitMsgUntil
+//   Description:
+///   \brief Wait for a message until an absolute deadline
+//   Parameters:
+///   @param long long deadline - GetTimeMs() value, -1 to wait forever
+//   Return:
+///   @return bool - true if pending
+//   Notes:
+///   Signals restart the wait with whatever time is left. Called before
+///   every read, so it does not allocate.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::WaitMsgUntil(long long deadline) {
+  if (!IsConnected())
+    return false;
+
+  NetworkOps *self = this;
+  NetworkOps *ready = 0;
+
+  for (;;) {
+    int wait = -1;
+    if (deadline >= 0) {
+      long long left = deadline - GetTimeMs();
+      wait = (left > 0) ? (int)left : 0;
+    }
+
+    int nready = WaitMsgs(&self, 1, &ready, wait);
+    if (nready > 0)
+      return true;
+    if (nready == 0 || errNo != EINTR)
+      return false;
+  }
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WaitMsgs
+//   Description:
+///   \brief Wait for any of a set of connections to have a message pending
+//   Parameters:
+///   @param std::vector<NetworkOps *> &ops - connections to wait on
+///   @param std::vector<NetworkOps *> &ready - filled with those now readable
+///   @param int millisecs - timeout, -1 to wait forever
+//   Return:
+///   @return int - number ready, 0 on timeout, -1 on error
+//   Notes:
+///   Hang ups and errors count as readable so the following read reports
+///   them. Zero copy completions also raise POLLERR, those are collected
+///   and the wait carries on.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::WaitMsgs(std::vector<NetworkOps *> &ops,
+                         std::vector<NetworkOps *> &ready, int millisecs) {
+  ready.clear();
+  if (ops.empty())
+    return 0;
+
+  ready.resize(ops.size());
+  int nready = WaitMsgs(&ops[0], ops.size(), &ready[0], millisecs);
+  ready.resize((nready > 0) ? nready : 0);
+  return nready;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WaitMsgs
+//   Description:
+///   \brief Wait for any of an array of connections to have a message pending
+//   Parameters:
+///   @param NetworkOps *const *ops - connections to wait on
+///   @param size_t count - how many
+///   @param NetworkOps **ready - room for count, filled with those readable
+///   @param int millisecs - timeout, -1 to wait forever
+//   Return:
+///   @return int - number ready, 0 on timeout, -1 on error
+//   Notes:
+///   Up to WAITLOCALFDS connections are polled from the stack.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::WaitMsgs(NetworkOps *const *ops, size_t count,
+                         NetworkOps **ready, int millisecs) {
+  int nready = 0;
+  if (count == 0)
+    return 0;
+
+#ifndef _WIN32
+  struct pollfd localFds[WAITLOCALFDS];
+  std::vector<struct pollfd> heapFds;
+  struct pollfd *fds = localFds;
+  if (count > WAITLOCALFDS) {
+    heapFds.resize(count);
+    fds = &heapFds[0];
+  }
+
+  long long deadline = (millisecs >= 0) ? GetTimeMs() + millisecs : -1;
+  for (;;) {
+    ///
+    /// What the event loop delivered is ready without a poll, and it only
+    /// signals the eventfd while a waiter is registered (POLLRDNORM marks
+    /// them), so a connection with nothing to wait for costs no call
+    ///
+    int wait = millisecs;
+    bool bPoll = (millisecs != 0);
+    for (size_t i = 0; i < count; i++) {
+      fds[i].fd = ops[i]->GetWaitId();
+      fds[i].events = POLLIN;
+      if (ops[i]->ReadWantsWrite())
+        fds[i].events |= POLLOUT;
+      fds[i].revents = 0;
+      if (!ops[i]->IsDelivered())
+        bPoll = true;
+      else {
+        fds[i].events |= POLLRDNORM;
+        if (ops[i]->AddWaiter())
+          wait = 0;
+      }
+    }
+
+    int npolled = (bPoll) ? poll(fds, count, wait) : 0;
+    for (size_t i = 0; i < count; i++) {
+      if ((fds[i].events & POLLRDNORM) && ops[i]->DropWaiter())
+        fds[i].revents |= POLLIN;
+    }
+    if (npolled < 0)
+      return npolled;
+
+    for (size_t i = 0; i < count; i++) {
+      if ((fds[i].revents & (POLLIN | POLLHUP)) ||
+          ((fds[i].revents & POLLOUT) && ops[i]->ReadWantsWrite()) ||
+          ((fds[i].revents & POLLERR) && ops[i]->IsHungUp()))
+        ready[nready++] = ops[i];
+    }
+    if (nready > 0 || millisecs == 0 || npolled == 0)
+      break;
+
+    if (deadline >= 0) {
+      long long left = deadline - GetTimeMs();
+      millisecs = (left > 0) ? (int)left : 0;
+    }
+  }
+#else
+  /// Winsock fd_sets are arrays of handles, so FD_SETSIZE is a count
+  fd_set readfds;
+  FD_ZERO(&readfds);
+  for (size_t i = 0; i < count; i++)
+    FD_SET(ops[i]->GetSockId(), &readfds);
 
-  return bRet;
+  struct timeval timeout = {0};
+  timeout.tv_sec = millisecs / 1000;
+  timeout.tv_usec = (millisecs % 1000) * 1000;
+
+  int nselected =
+      select(0, &readfds, (fd_set *)0, (fd_set *)0,
+             (millisecs < 0) ? (struct timeval *)0 : (struct timeval *)&timeout);
+  if (nselected <= 0)
+    return nselected;
+
+  for (size_t i = 0; i < count; i++) {
+    if (FD_ISSET(ops[i]->GetSockId(), &readfds))
+      ready[nready++] = ops[i];
+  }
+#endif
+  return nready;
 }
 
 ///
@@ -846,7 +3055,7 @@ bool NetworkOps::PollMsg(int secs) {
 ///
 
 int NetworkOps::PeekMsg(std::string *message) {
-  LockMutex();
+  m_RecvMutex.Lock();
 
   int num_read = 0;
   char buffer[DBLOCK + 1];
@@ -862,10 +3071,10 @@ int NetworkOps::PeekMsg(std::string *message) {
       } else
         break;
     }
-  } while (PollMsg(2));
+  } while (WaitMsg(m_ReadWait));
 
   *message = buffer;
-  UnlockMutex();
+  m_RecvMutex.Unlock();
   return num_read;
 }
 
@@ -884,46 +3093,24 @@ int NetworkOps::PeekMsg(std::string *message) {
 
 int NetworkOps::ReadMsg(int iSize, std::string *pzMess) {
   int total_read = 0;
-  int num_read = 1;
-  int msgblk = DBLOCK; ///    1K read///
   int nleft = iSize + 24;
-  bool bCont = true;
-  bool bErr = false;
-
-  /// Wait until something somes along to read///
-  if (!GetBlock()) {
-    if (!PollMsg(2))
-      return 0;
-  } else
-    (void)PollMsg(-1);
 
   // Read until the socket is done...
   while (nleft > 0) {
-    char *tmp = (char *)malloc(msgblk + 1);
-
-    do {
-      num_read = recv(GetSockId(), tmp, msgblk, 0);
-      if (num_read < 0) {
-        if (errNo == EINTR) {
-        } else if (errNo == EAGAIN || errNo == EWOULDBLOCK) {
-          bCont = false;
-          break;
-        } else {
-          bCont = false;
-          bErr = true;
-        }
-      }
-    } while (num_read < 0 && bCont);
-
-    if (num_read == 0)
+    int len = FillMsg(GetWait());
+    if (len < 0)
+      return (-1);
+    if (len == 0)
       break;
 
-    if (tmp) {
-      *pzMess += tmp;
-      (void)free(tmp);
+    const char *ptr = 0;
+    while (!m_RecvBuf.empty()) {
+      size_t run = m_RecvBuf.Peek(&ptr);
+      pzMess->append(ptr, run);
+      m_RecvBuf.Consume(run);
     }
-    total_read += num_read;
-    nleft -= num_read;
+    total_read += len;
+    nleft -= len;
   }
 
   if (IsDebug())
@@ -931,10 +3118,7 @@ int NetworkOps::ReadMsg(int iSize, std::string *pzMess) {
                                  __FILE__, __LINE__, total_read,
                                  pzMess->c_str());
 
-  if (bErr)
-    return (-1);
-  else
-    return (total_read);
+  return (total_read);
 }
 
 ///
@@ -977,22 +3161,38 @@ bool NetworkOps::SetSocketTimeOut(int millisecs) {
 ///
 
 bool NetworkOps::StartServer(int connections) {
-  LockMutex();
-  struct sockaddr_in sin = {0};
+  DnsAddr local;
 
   int channel = -1;
 
-  if (GetHostName()->empty() && GetService()->empty()) {
-    UnlockMutex();
+  if (GetHostName()->empty() && GetService()->empty())
     return (false);
-  }
 
-  ParseHost();
-  int portNo = -1;
-  if (!GetService()->empty())
-    portNo = (int)strtol(GetService()->c_str(), (char **)NULL, 10);
-  else if (!GetHostName()->empty())
-    portNo = (int)strtol(GetHostName()->c_str(), (char **)NULL, 10);
+  memset((char *)&local, 0, sizeof(local));
+  if (IsUnixHost()) {
+    if (!GetUnixAddr(local))
+      return (false);
+#ifndef _WIN32
+    /// A socket left behind by an earlier run would stop the bind
+    struct stat info;
+    const char *path = ((struct sockaddr_un *)&local.addr)->sun_path;
+    if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode))
+      (void)unlink(path);
+#endif
+  } else {
+    ParseHost();
+    int portNo = -1;
+    if (!GetService()->empty())
+      portNo = (int)strtol(GetService()->c_str(), (char **)NULL, 10);
+    else if (!GetHostName()->empty())
+      portNo = (int)strtol(GetHostName()->c_str(), (char **)NULL, 10);
+
+    struct sockaddr_in *sin = (struct sockaddr_in *)&local.addr;
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_ANY);
+    sin->sin_port = htons(portNo);
+    local.len = sizeof(*sin);
+  }
 
 #ifdef _WIN32
   if (!m_Started) {
@@ -1002,14 +3202,8 @@ bool NetworkOps::StartServer(int connections) {
   }
 #endif
 
-  memset((char *)&sin, 0, sizeof(sin));
-  sin.sin_family = AF_INET;
-  sin.sin_addr.s_addr = htonl(INADDR_ANY);
-  sin.sin_port = htons(portNo);
-
-  if ((channel = socket(sin.sin_family, SOCK_STREAM, 0)) < 0) {
+  if ((channel = socket(local.addr.ss_family, SOCK_STREAM, 0)) < 0) {
     SetError("- Socket initialisation failed");
-    UnlockMutex();
     return (false);
   }
 
@@ -1020,15 +3214,33 @@ bool NetworkOps::StartServer(int connections) {
       (setsockopt(channel, SOL_SOCKET, SO_KEEPALIVE, (char *)&n, sizeof(n)) <
        0)) {
     SetError("- Set socket options failed");
-    UnlockMutex();
     return (false);
   }
 
+#ifdef SO_REUSEPORT
+  /// The kernel spreads incoming connections across every socket bound
+  if (m_ReusePort && setsockopt(channel, SOL_SOCKET, SO_REUSEPORT, (char *)&n,
+                                sizeof(n)) < 0) {
+    (void)closesk(channel);
+    SetError("- Set socket options failed (SO_REUSEPORT)");
+    return (false);
+  }
+#endif
+
   if (m_NonBlocking)
     SetNonBlockingSocket(channel);
 
+  /// Accepted sockets inherit the buffer sizes set here
+  ApplyProfile(channel);
+
+#ifdef TCP_FASTOPEN
+  /// Fast open SYNs are limited to as many as the accept queue holds
+  if (m_FastOpen)
+    SetTcpOption(channel, IPPROTO_TCP, TCP_FASTOPEN, connections);
+#endif
+
   /// Bind the socket
-  if (bind(channel, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+  if (bind(channel, (struct sockaddr *)&local.addr, local.len) < 0) {
     close(channel);
     // An error occurred
     std::string errMsg("- An error occurred binding ");
@@ -1041,7 +3253,6 @@ bool NetworkOps::StartServer(int connections) {
       errMsg += error;
 #endif
     SetError(&errMsg);
-    UnlockMutex();
     return (false);
   }
 
@@ -1062,13 +3273,15 @@ bool NetworkOps::StartServer(int connections) {
       errMsg += error;
 #endif
     SetError(&errMsg);
-    UnlockMutex();
     return (false);
   }
 
+  m_RecvMutex.Lock();
+  m_SendMutex.Lock();
   SetSockId(channel);
-
-  UnlockMutex();
+  m_Transport = (IsUnixHost()) ? TRANSPORTUNIX : TRANSPORTTCP;
+  m_SendMutex.Unlock();
+  m_RecvMutex.Unlock();
   return (true);
 }
 
@@ -1093,7 +3306,8 @@ bool NetworkOps::AcceptSingleConnection(void) {
   struct sockaddr_in peer = {0};
   addr_size = sizeof(peer);
 
-  LockMutex();
+  m_RecvMutex.Lock();
+  m_SendMutex.Lock();
 
   int newchannel = accept(GetSockId(), (struct sockaddr *)&peer, &addr_size);
 
@@ -1109,12 +3323,15 @@ bool NetworkOps::AcceptSingleConnection(void) {
       errMsg += error;
 #endif
     SetError(&errMsg);
-    UnlockMutex();
+    m_SendMutex.Unlock();
+    m_RecvMutex.Unlock();
     return false;
   }
 
   close(GetSockId());
   SetSockId(newchannel);
+  ApplyProfile(newchannel);
+  ReportProfile(newchannel);
 
   if (IsDebug()) {
     std::string hostPeer;
@@ -1124,10 +3341,88 @@ bool NetworkOps::AcceptSingleConnection(void) {
         __LINE__, hostPeer.c_str());
   }
 
-  UnlockMutex();
+  m_SendMutex.Unlock();
+  m_RecvMutex.Unlock();
   return true;
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Accept
+//   Description:
+///   \brief Accept a network connection, leaving the listener open
+//   Parameters:
+//   Return:
+///   @return NetworkOps * - the new connection, owned by the caller, or 0
+///   if none is waiting (GetError is set if something went wrong)
+//   Notes:
+///   The new socket is non-blocking and close-on-exec, and carries this
+///   listener's debug flag and tuning profile.
+//----------------------------------------------------------------------------
+///
+
+NetworkOps *NetworkOps::Accept(void) {
+  struct sockaddr_storage peer;
+  socklen_t addr_size = sizeof(peer);
+  int newchannel = -1;
+
+  do {
+#ifdef SOCK_NONBLOCK
+    newchannel = accept4(GetSockId(), (struct sockaddr *)&peer, &addr_size,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    newchannel = accept(GetSockId(), (struct sockaddr *)&peer, &addr_size);
+    if (newchannel >= 0) {
+      (void)SetSocketBlocking(newchannel, false);
+#ifndef _WIN32
+      (void)fcntl(newchannel, F_SETFD, FD_CLOEXEC);
+#endif
+    }
+#endif
+  } while (newchannel < 0 && (errNo == EINTR || errNo == ECONNABORTED));
+
+  if (newchannel < 0) {
+    if (errNo != EAGAIN && errNo != EWOULDBLOCK) {
+      std::string errMsg("- An error occurred accepting a connection ");
+      char error[1024 + 1];
+#ifndef _WIN32
+      if (strerror_r(errNo, error, sizeof(error)) == 0)
+        errMsg += error;
+#else
+      if (strerror_s(error, sizeof(error), errNo) == 0)
+        errMsg += error;
+#endif
+      SetError(&errMsg);
+    }
+    return 0;
+  }
+
+  NetworkOps *conn = new NetworkOps();
+  conn->SetDebug(IsDebug());
+  conn->SetNonBlocking(true);
+  conn->m_Profile = m_Profile;
+  conn->m_Transport = m_Transport;
+  conn->ApplyProfile(newchannel);
+  conn->SetSockId(newchannel);
+
+  ///   Unix domain peers have no address, so go by the listening path
+  std::string hostPeer;
+  if (m_Transport == TRANSPORTUNIX)
+    hostPeer = *GetHostName();
+  else
+    (void)conn->GetPeerIPAddr(hostPeer);
+  conn->SetHostName(&hostPeer);
+  if (IsDebug()) {
+    (void)DebugUtils::LogMessage(
+        MSGINFO, "Debug: [%s,%d] Got a connection to me from %s", __FILE__,
+        __LINE__, hostPeer.c_str());
+    conn->ReportProfile(newchannel);
+  }
+  return conn;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -1144,12 +3439,15 @@ bool NetworkOps::AcceptSingleConnection(void) {
 ///
 
 std::string &NetworkOps::GetHostIPAddr(std::string &ipAddr) {
-  sockaddr_in addr = {0};
-  int sin_size = sizeof(sockaddr_in);
-  if (getsockname(GetSockId(), (sockaddr *)&addr, (socklen_t *)&sin_size) < 0)
-    ipAddr = "";
-  else
-    ipAddr = inet_ntoa(addr.sin_addr);
+  struct sockaddr_storage addr;
+  socklen_t sin_size = sizeof(addr);
+  char host[NI_MAXHOST + 1];
+
+  ipAddr = "";
+  if (getsockname(GetSockId(), (sockaddr *)&addr, &sin_size) == 0 &&
+      getnameinfo((sockaddr *)&addr, sin_size, host, sizeof(host), 0, 0,
+                  NI_NUMERICHOST) == 0)
+    ipAddr = host;
 
   return ipAddr;
 }
@@ -1170,12 +3468,383 @@ std::string &NetworkOps::GetHostIPAddr(std::string &ipAddr) {
 ///
 
 std::string &NetworkOps::GetPeerIPAddr(std::string &ipAddr) {
-  sockaddr_in addr = {0};
-  int sin_size = sizeof(sockaddr_in);
-  if (getpeername(GetSockId(), (sockaddr *)&addr, (socklen_t *)&sin_size) < 0)
-    ipAddr = "";
-  else
-    ipAddr = inet_ntoa(addr.sin_addr);
+  struct sockaddr_storage addr;
+  socklen_t sin_size = sizeof(addr);
+  char host[NI_MAXHOST + 1];
+
+  ipAddr = "";
+  if (getpeername(GetSockId(), (sockaddr *)&addr, &sin_size) == 0 &&
+      getnameinfo((sockaddr *)&addr, sin_size, host, sizeof(host), 0, 0,
+                  NI_NUMERICHOST) == 0)
+    ipAddr = host;
 
   return ipAddr;
 }
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SocketProfile
+//   Description:
+///   \brief Socket tuning presets
+//   Parameters:
+//   Return:
+//   Notes:
+///   Interactive suits small chat frames - no Nagle delay, immediate acks
+///   and a write wakeup only once little is left unsent. Bulk suits file
+///   transfers - Nagle left on and large buffers.
+//----------------------------------------------------------------------------
+///
+
+SocketProfile::SocketProfile()
+    : noDelay(-1), quickAck(-1), sendBuf(-1), recvBuf(-1), keepIdle(-1),
+      keepIntvl(-1), keepCnt(-1), busyPoll(-1), notSentLowat(-1),
+      zeroCopy(-1), rxStamps(-1) {}
+
+SocketProfile SocketProfile::Interactive(void) {
+  SocketProfile profile;
+  profile.noDelay = 1;
+  profile.quickAck = 1;
+  profile.keepIdle = 60;
+  profile.keepIntvl = 10;
+  profile.keepCnt = 5;
+  profile.notSentLowat = SENDLOWWATER;
+  return profile;
+}
+
+SocketProfile SocketProfile::Bulk(void) {
+  SocketProfile profile;
+  profile.noDelay = 0;
+  profile.sendBuf = 512 * 1024;
+  profile.recvBuf = 512 * 1024;
+  profile.keepIdle = 60;
+  profile.keepIntvl = 10;
+  profile.keepCnt = 5;
+  return profile;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ConnHealth
+//   Description:
+///   \brief Constructor, nothing measured yet
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+ConnHealth::ConnHealth()
+    : rtt(-1), rttVar(-1), retransmits(-1), backoff(-1), cwnd(-1),
+      unacked(-1), caState(-1), replyRtt(-1), replyRttVar(-1), replyLast(-1),
+      replies(0), sampled(0) {}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SetProfile
+//   Description:
+///   \brief Set the tuning used for this connection
+//   Parameters:
+///   @param const SocketProfile &profile
+//   Return:
+//   Notes:
+///   Applied straight away if already connected, otherwise on connect.
+///   Kept across Disconnect.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::SetProfile(const SocketProfile &profile) {
+  m_Profile = profile;
+  if (IsConnected()) {
+    ApplyProfile(GetSockId());
+    ReportProfile(GetSockId());
+  }
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ApplyProfile
+//   Description:
+///   \brief Apply the tuning profile to a socket
+//   Parameters:
+///   @param int sockId
+//   Return:
+//   Notes:
+///   Done before connect or listen so the buffer sizes shape the window
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::ApplyProfile(int sockId) {
+  SetTcpOption(sockId, IPPROTO_TCP, TCP_NODELAY, m_Profile.noDelay);
+#ifdef TCP_QUICKACK
+  SetTcpOption(sockId, IPPROTO_TCP, TCP_QUICKACK, m_Profile.quickAck);
+#endif
+  SetTcpOption(sockId, SOL_SOCKET, SO_SNDBUF, m_Profile.sendBuf);
+  SetTcpOption(sockId, SOL_SOCKET, SO_RCVBUF, m_Profile.recvBuf);
+#if defined(TCP_KEEPIDLE)
+  SetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPIDLE, m_Profile.keepIdle);
+#elif defined(TCP_KEEPALIVE)
+  SetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPALIVE, m_Profile.keepIdle);
+#endif
+#ifdef TCP_KEEPINTVL
+  SetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPINTVL, m_Profile.keepIntvl);
+#endif
+#ifdef TCP_KEEPCNT
+  SetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPCNT, m_Profile.keepCnt);
+#endif
+#ifdef SO_BUSY_POLL
+  SetTcpOption(sockId, SOL_SOCKET, SO_BUSY_POLL, m_Profile.busyPoll);
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+  SetTcpOption(sockId, IPPROTO_TCP, TCP_NOTSENT_LOWAT, m_Profile.notSentLowat);
+#endif
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  /// Without the socket option the kernel quietly copies and never
+  /// reports completions, so only flag zero copy once it is set
+  int n = 1;
+  m_ZcEnabled = (m_Profile.zeroCopy > 0 &&
+                 setsockopt(sockId, SOL_SOCKET, SO_ZEROCOPY, (char *)&n,
+                            sizeof(n)) == 0);
+#endif
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+  int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  m_RxStamps = (m_Profile.rxStamps > 0 &&
+                setsockopt(sockId, SOL_SOCKET, SO_TIMESTAMPING, (char *)&flags,
+                           sizeof(flags)) == 0);
+#endif
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReportProfile
+//   Description:
+///   \brief Log the tuning a socket actually ended up with
+//   Parameters:
+///   @param int sockId
+//   Return:
+//   Notes:
+///   Values are read back, so kernel adjustments (doubled buffer sizes,
+///   clamped limits) show up. -1 means unsupported here.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::ReportProfile(int sockId) {
+  if (!IsDebug())
+    return;
+
+  int keepIdle = -1, keepIntvl = -1, keepCnt = -1;
+  int busyPoll = -1, notSentLowat = -1, zeroCopy = -1;
+#if defined(TCP_KEEPIDLE)
+  keepIdle = GetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPIDLE);
+#elif defined(TCP_KEEPALIVE)
+  keepIdle = GetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPALIVE);
+#endif
+#ifdef TCP_KEEPINTVL
+  keepIntvl = GetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPINTVL);
+#endif
+#ifdef TCP_KEEPCNT
+  keepCnt = GetTcpOption(sockId, IPPROTO_TCP, TCP_KEEPCNT);
+#endif
+#ifdef SO_BUSY_POLL
+  busyPoll = GetTcpOption(sockId, SOL_SOCKET, SO_BUSY_POLL);
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+  notSentLowat = GetTcpOption(sockId, IPPROTO_TCP, TCP_NOTSENT_LOWAT);
+#endif
+#ifdef SO_ZEROCOPY
+  if (GetTcpOption(sockId, SOL_SOCKET, SO_ZEROCOPY) > 0)
+    zeroCopy = m_Profile.zeroCopy;
+#endif
+
+  (void)DebugUtils::LogMessage(
+      MSGINFO,
+      "Debug: [%s,%d] Socket %d nodelay=%d quickack=%d sndbuf=%d rcvbuf=%d "
+      "keepidle=%d keepintvl=%d keepcnt=%d busypoll=%d notsentlowat=%d "
+      "zerocopy=%d rxstamps=%d",
+      __FILE__, __LINE__, sockId,
+      GetTcpOption(sockId, IPPROTO_TCP, TCP_NODELAY), m_Profile.quickAck,
+      GetTcpOption(sockId, SOL_SOCKET, SO_SNDBUF),
+      GetTcpOption(sockId, SOL_SOCKET, SO_RCVBUF), keepIdle, keepIntvl,
+      keepCnt, busyPoll, notSentLowat, zeroCopy, (m_RxStamps) ? 1 : 0);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SampleHealth
+//   Description:
+///   \brief Read the kernel's view of the connection (TCP_INFO)
+//   Parameters:
+///   @param bool bForce - read it even if the last sample is recent
+//   Return:
+///   @return bool - false if not connected or not available here
+//   Notes:
+///   Cheap enough for every pass of a read loop, as it only goes to the
+///   kernel once every HEALTHSAMPLE ms.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::SampleHealth(bool bForce) {
+  if (!IsConnected())
+    return false;
+
+  long long now = GetTimeMs();
+  if (!bForce && m_Health.sampled != 0 &&
+      now - m_Health.sampled < HEALTHSAMPLE)
+    return true;
+
+#ifdef __linux__
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+
+  memset(&info, 0, sizeof(info));
+  if (getsockopt(GetSockId(), IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+    return false;
+
+  m_Health.rtt = info.tcpi_rtt;
+  m_Health.rttVar = info.tcpi_rttvar;
+  m_Health.retransmits = info.tcpi_total_retrans;
+  m_Health.backoff = info.tcpi_backoff;
+  m_Health.cwnd = info.tcpi_snd_cwnd;
+  m_Health.unacked = info.tcpi_unacked;
+  m_Health.caState = info.tcpi_ca_state;
+  m_Health.sampled = now;
+  return true;
+#else
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   IsDegraded
+//   Description:
+///   \brief Whether the connection looks to be in trouble
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   Either TCP is recovering from loss or timing out retransmits, or the
+///   far end has got slow to reply. Goes on the last sample taken.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOps::IsDegraded(void) {
+#ifdef __linux__
+  if (m_Health.backoff > 0 || m_Health.caState >= TCP_CA_Recovery)
+    return true;
+#endif
+  return (m_Health.replies > 0 &&
+          m_Health.replyRtt > HEALTHSLOWREPLY * 1000L);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   AddReplyTime
+//   Description:
+///   \brief Fold a request to reply time into the smoothed figures
+//   Parameters:
+///   @param long long usecs
+//   Return:
+//   Notes:
+///   Smoothed as TCP does its RTT (RFC 6298) - gains of 1/8 and 1/4
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::AddReplyTime(long long usecs) {
+  long sample = (long)usecs;
+
+  if (m_Health.replies == 0) {
+    m_Health.replyRtt = sample;
+    m_Health.replyRttVar = sample / 2;
+  } else {
+    long delta = sample - m_Health.replyRtt;
+    m_Health.replyRttVar += ((delta < 0 ? -delta : delta) -
+                             m_Health.replyRttVar) / 4;
+    m_Health.replyRtt += delta / 8;
+  }
+  m_Health.replyLast = sample;
+  m_Health.replies++;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetReplyWait
+//   Description:
+///   \brief How long to wait for the reply to a request (ms)
+//   Parameters:
+//   Return:
+///   @return int - -1 for blocking connections
+//   Notes:
+///   The read wait, stretched to the smoothed reply time plus four times
+///   its variance on a connection that has shown itself to be slow, so
+///   slow hosts are not given up on early. Never shortened, as a reply
+///   that misses the wait would be taken for the next one.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOps::GetReplyWait(void) {
+  if (m_Block)
+    return -1;
+
+  int wait = m_ReadWait;
+  if (m_Health.replies > 0) {
+    long long timeout =
+        (m_Health.replyRtt + 4LL * m_Health.replyRttVar) / 1000;
+    if (timeout > HEALTHMAXWAIT)
+      timeout = HEALTHMAXWAIT;
+    if (timeout > wait)
+      wait = (int)timeout;
+  }
+  return wait;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReportHealth
+//   Description:
+///   \brief Log the connection's health figures
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void NetworkOps::ReportHealth(void) {
+  if (!IsDebug())
+    return;
+
+  (void)DebugUtils::LogMessage(
+      MSGINFO,
+      "Debug: [%s,%d] %s rtt=%ldus rttvar=%ldus retrans=%ld backoff=%ld "
+      "cwnd=%ld unacked=%ld reply=%ldus replyvar=%ldus last=%ldus "
+      "replies=%lu%s",
+      __FILE__, __LINE__, GetHostName()->c_str(), m_Health.rtt,
+      m_Health.rttVar, m_Health.retransmits, m_Health.backoff, m_Health.cwnd,
+      m_Health.unacked, m_Health.replyRtt, m_Health.replyRttVar,
+      m_Health.replyLast, m_Health.replies,
+      (IsDegraded()) ? " (degraded)" : "");
+  return;
+}
@@ -15,10 +15,13 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/param.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #define errNo errno
@@ -27,7 +30,8 @@
 #else
 #include "config_win32_vs2005.h"
 #include <io.h>
-#include <winsock.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
 
 #ifndef EINTR
 #define EINTR WSAEINTR
@@ -38,6 +42,15 @@
 #ifndef EWOULDBLOCK
 #define EWOULDBLOCK WSAEWOULDBLOCK
 #endif
+#ifndef EINPROGRESS
+#define EINPROGRESS WSAEINPROGRESS
+#endif
+#ifndef ETIMEDOUT
+#define ETIMEDOUT WSAETIMEDOUT
+#endif
+#ifndef ECONNABORTED
+#define ECONNABORTED WSAECONNABORTED
+#endif
 
 #define closesk closesocket
 #define errNo WSAGetLastError()
@@ -48,10 +61,129 @@
 
 #endif
 
+#include <atomic>
+#include <deque>
+#include <map>
 #include <string>
+#include <vector>
+
+#include "BufSlice.h"
+#include "Mutex.h"
+#include "RingBuffer.h"
 
 #define DBLOCK 1024
 
+/// Outbound queue defaults - watermarks (bytes), iovecs per write and how
+/// long a send waits for the socket to drain (ms)
+#define SENDLOWWATER (16 * 1024)
+#define SENDHIGHWATER (64 * 1024)
+#define SENDMAXVEC 64
+#define SENDWAIT 30000
+
+/// Connections a wait polls without allocating
+#define WAITLOCALFDS 16
+
+/// Connect defaults (ms) - overall deadline, deadline for each address
+/// tried and the head start an attempt gets before the next one races it
+#define CONNECTWAIT 30000
+#define CONNECTATTEMPTWAIT 10000
+#define CONNECTSTAGGER 250
+
+///
+/// Transports - TCP, a Unix domain socket (host name "unix:<path>") or
+/// one end of an in-process pair from CreatePair. All go through the same
+/// read and write paths, so protocol code runs unchanged on any of them.
+///
+#define TRANSPORTTCP 0
+#define TRANSPORTUNIX 1
+#define TRANSPORTPAIR 2
+#define UNIXPREFIX "unix:"
+
+/// Connection health (ms) - how often TCP_INFO is read, the smoothed reply
+/// time counted as slow, and the longest a reply wait is stretched to
+#define HEALTHSAMPLE 1000
+#define HEALTHSLOWREPLY 2000
+#define HEALTHMAXWAIT 30000
+
+///
+/// Frame length callback, given the buffered bytes. Returns the length of
+/// the complete frame at the start of the buffer, 0 if more is needed, or
+/// -1 if the stream can't be framed (e.g. a frame over the protocol's
+/// limit), which fails the connection.
+///
+typedef int (*FRAMELENFUNCPTR)(const char *, int);
+
+///
+/// Packet header callback for SendFile. Writes the header for a packet of
+/// the given data size and returns its length, at most FILEHDRMAX.
+///
+typedef int (*FILEHDRFUNCPTR)(char *, int);
+
+///
+/// Send hook for loop owned I/O. Called with the send side held whenever
+/// the outbound queue has something for the event loop to send, which it
+/// takes with TakeQueued. Returns false if the loop can't take it.
+///
+class NetworkOps;
+typedef bool (*SENDSUBMITFUNCPTR)(NetworkOps *, void *);
+
+/// Largest SendFile packet header, and the read size when it has to copy
+#define FILEHDRMAX 16
+#define FILEBLOCK (64 * 1024)
+
+///
+/// One resolved address, port already filled in
+///
+struct DnsAddr {
+  struct sockaddr_storage addr;
+  socklen_t len;
+};
+
+///
+/// Socket tuning applied to each new connection. -1 leaves the system
+/// default, options the platform lacks are skipped.
+///
+struct SocketProfile {
+  SocketProfile();
+
+  static SocketProfile Interactive(void);
+  static SocketProfile Bulk(void);
+
+  int noDelay;      /// TCP_NODELAY
+  int quickAck;     /// TCP_QUICKACK, re-armed after every read
+  int sendBuf;      /// SO_SNDBUF (bytes)
+  int recvBuf;      /// SO_RCVBUF (bytes)
+  int keepIdle;     /// TCP_KEEPIDLE (secs)
+  int keepIntvl;    /// TCP_KEEPINTVL (secs)
+  int keepCnt;      /// TCP_KEEPCNT
+  int busyPoll;     /// SO_BUSY_POLL (usecs)
+  int notSentLowat; /// TCP_NOTSENT_LOWAT (bytes)
+  int zeroCopy;     /// MSG_ZEROCOPY for writes of at least this (bytes)
+  int rxStamps;     /// SO_TIMESTAMPING software receive timestamps
+};
+
+///
+/// Health of one connection. The TCP figures are the kernel's (TCP_INFO),
+/// the reply figures time each Talk from request to the first bytes back,
+/// smoothed as TCP smooths its RTT. Times are usecs, -1 until measured.
+///
+struct ConnHealth {
+  ConnHealth();
+
+  long rtt;              /// smoothed TCP round trip
+  long rttVar;           /// and its variance
+  long retransmits;      /// segments retransmitted so far
+  long backoff;          /// retransmit timeouts in a row
+  long cwnd;             /// congestion window (segments)
+  long unacked;          /// segments in flight
+  int caState;           /// congestion state, 0 when all is well
+  long replyRtt;         /// smoothed request to reply time
+  long replyRttVar;      /// and its variance
+  long replyLast;        /// the latest one
+  unsigned long replies; /// replies timed
+  long long sampled;     /// when TCP_INFO was last read (ms), 0 never
+};
+
 class NetworkOps {
 
 public:
@@ -62,8 +194,15 @@ public:
   NetworkOps(const std::string *, const std::string *);
   NetworkOps(const char *);
   NetworkOps(const std::string *);
-  NetworkOps(const NetworkOps &);
-  ~NetworkOps();
+  NetworkOps(NetworkOps &&) noexcept;
+  virtual ~NetworkOps();
+
+  ///
+  /// Move only - a connection has exactly one owner, which closes it.
+  /// Nothing else may be using either object during a move.
+  ///
+  NetworkOps(const NetworkOps &) = delete;
+  NetworkOps &operator=(const NetworkOps &) = delete;
 
   inline const std::string *GetHostName() { return &m_HostName; }
   inline const std::string *GetService() { return &m_Service; }
@@ -85,10 +224,33 @@ public:
 
   inline void SetNonBlocking(bool val) { m_NonBlocking = val; }
 
+  /// TCP Fast Open - a connect sends the first write in its SYN, a server
+  /// takes data in the SYN. Only for protocols where the client speaks
+  /// first, as the SYN waits for that write. Connects to a host with more
+  /// than one address do not use it, so they keep their fallback.
+  inline void SetFastOpen(bool val) { m_FastOpen = val; }
+  inline bool const IsFastOpen() { return m_FastOpen; }
+
+  inline const SocketProfile *GetProfile() { return &m_Profile; }
+  void SetProfile(const SocketProfile &);
+
   inline void SetBlock(bool val) { m_Block = val; }
   inline const bool GetBlock() { return m_Block; }
 
+  /// How long a non-blocking read waits for data (ms)
+  inline void SetReadWait(int millisecs) { m_ReadWait = millisecs; }
+  inline const int GetReadWait() { return m_ReadWait; }
+
+  /// Overall connect deadline (ms)
+  inline void SetConnectWait(int millisecs) { m_ConnectWait = millisecs; }
+  inline const int GetConnectWait() { return m_ConnectWait; }
+
+  inline const int GetTransport() { return m_Transport; }
+  static bool CreatePair(NetworkOps &, NetworkOps &);
+
   inline bool IsConnected() { return (m_SocketId != -1); };
+  inline bool IsConnecting() { return !m_ConnAttempts.empty(); }
+  inline bool IsPeerClosed() { return m_PeerClosed; }
 
   inline bool const IsDebug() { return m_Debug; }
   inline void SetDebug(bool val) { m_Debug = val; }
@@ -96,9 +258,15 @@ public:
   /// Network server routines
   bool StartServer(int);
   bool AcceptSingleConnection(void);
+  NetworkOps *Accept(void);
+
+  /// Let several listeners bind the same port (SO_REUSEPORT)
+  inline void SetReusePort(bool val) { m_ReusePort = val; }
 
   /// Client access network routines
   bool Connect(void);
+  bool BeginConnect(void);
+  int PollConnect(int);
   bool Disconnect(void);
   bool Talk(const std::string *, std::string *, bool bforce = false);
   bool Talk(const char *, std::string *, bool bforce = false);
@@ -108,8 +276,77 @@ public:
   bool SetSocketTimeOut(int);
   bool GetBinMsg(int *, std::string &);
   bool GetBinMsg(int *, char **);
+  bool GetFrames(FRAMELENFUNCPTR, std::vector<std::string> &,
+                 bool bWait = true, std::vector<long long> *stamps = 0);
+  bool GetFrames(FRAMELENFUNCPTR, std::vector<BufSlice> &, bool bWait = true,
+                 std::vector<long long> *stamps = 0);
   bool SendBinMsg(void *, int, bool bforce = false);
+  long long SendFile(int, long long, long long, int packetsz = 0,
+                     FILEHDRFUNCPTR hdrFunc = 0);
+
+  /// Outbound queue - PostMsg queues, FlushMsgs writes in one writev
+  bool PostMsg(const std::string &);
+  bool PostMsg(const char *, int);
+  int FlushMsgs(bool bWait = false);
+  bool WaitSend(int);
+
+  inline bool HasQueuedMsgs() {
+    return (m_SendQueued > 0 || GetTransportQueued() > 0);
+  }
+  inline bool WantsWrite() { return (HasQueuedMsgs() || ReadWantsWrite()); }
+  inline size_t GetQueuedBytes() { return m_SendQueued; }
+  inline bool IsThrottled() { return m_Throttled; }
+  bool IsHungUp(void);
+  inline void SetWatermarks(size_t low, size_t high) {
+    m_LowWater = low;
+    m_HighWater = high;
+  }
+
+  /// Bytes written without and with a copy into the kernel
+  inline unsigned long long GetZeroCopyBytes() { return m_ZcBytes; }
+  inline unsigned long long GetCopiedBytes() { return m_CopyBytes; }
+
+  /// Connection health - sampling is rate limited to HEALTHSAMPLE
+  inline const ConnHealth *GetHealth() { return &m_Health; }
+  bool SampleHealth(bool bForce = false);
+  bool IsDegraded(void);
+  void ReportHealth(void);
+  int GetReplyWait(void);
+
+  ///
+  /// What a stalled read or write is waiting for. Plain sockets read when
+  /// readable and write when writable, TLS can need the other (during a
+  /// handshake, or a key update), so pollers wait on both then.
+  ///
+  virtual bool ReadWantsWrite(void) { return false; }
+  virtual bool WriteWantsRead(void) { return false; }
+
   bool PollMsg(int);
+  bool WaitMsg(int);
+  bool WaitMsgUntil(long long);
+
+  ///
+  /// Loop owned I/O - the event loop receives for the connection and sends
+  /// its outbound queue. Reads take what it delivered, waits are on
+  /// GetWaitId, and queued messages are handed over through the hook.
+  ///
+  bool StartDelivery(SENDSUBMITFUNCPTR, void *);
+  void StopDelivery(void);
+  inline bool IsDelivered() { return m_Delivered; }
+  inline int GetWaitId() { return (m_Delivered) ? m_WaitId : m_SocketId; }
+  void Deliver(const char *, int);
+  void DeliverEnd(int);
+  size_t TakeQueued(std::deque<std::string> &, size_t &);
+  void SendDone(size_t);
+
+  /// Wait on several connections at once
+  static int WaitMsgs(std::vector<NetworkOps *> &, std::vector<NetworkOps *> &,
+                      int);
+  static int WaitMsgs(NetworkOps *const *, size_t, NetworkOps **, int);
+
+  /// Monotonic clock used for deadlines (ms)
+  static long long GetTimeMs(void);
+  static long long GetTimeUs(void);
 
   std::string &GetHostIPAddr(std::string &);
   std::string &GetPeerIPAddr(std::string &);
@@ -125,7 +362,7 @@ public:
   bool operator!=(const NetworkOps &other) const;
 
   /// Overloading the = operator
-  NetworkOps &operator=(const NetworkOps &other);
+  NetworkOps &operator=(NetworkOps &&other) noexcept;
 
   /// Overloading the > operator
   bool operator>(const NetworkOps &other) const;
@@ -138,20 +375,169 @@ protected:
   virtual void init();
   virtual void clear();
 
-private:
+  /// Receive side hooks, overridden by transports that do their own reads
+  virtual int FillBuffer(void);
+  virtual bool IsPending(void) { return false; }
+
+  /// Send side hook, returns bytes written or -1 (errNo EAGAIN if full)
+  virtual int WriteVec(struct iovec *, int);
+
+  /// Bytes a transport has taken but not yet written to the socket, which
+  /// a WriteVec with no buffers pushes on. Here, those the event loop is
+  /// sending.
+  virtual size_t GetTransportQueued(void) { return m_LoopQueued; }
+
+  /// Whether the event loop can read and write the socket for us
+  virtual bool CanDeliver(void) { return !m_RxStamps; }
+
+  /// Whether file data can go from the page cache straight to the socket,
+  /// in headed packets or unheaded
+  virtual bool CanSendFile(bool bHeaded) {
+    (void)bHeaded;
+    return true;
+  }
+
+  /// Send file data from the page cache, as sendfile does
+  virtual long long SendFileData(int, long long *, long long);
+
+  /// Whether written buffers go to the socket as they are
+  virtual bool CanZeroCopy(void) { return true; }
+
+  inline RingBuffer *GetRecvBuffer() { return &m_RecvBuf; }
+  inline void SetPeerClosed(bool val) { m_PeerClosed = val; }
+
   int ReadMsg(int, std::string *);
   int ReadMsg(std::string &);
   virtual int ReadMsg(char **);
   virtual int SendMsg(void *, int);
 
+private:
+  /// One in flight connect attempt
+  struct ConnectAttempt {
+    int sockId;
+    long long deadline;
+  };
+
+  inline int GetWait() { return (m_Block) ? -1 : m_ReadWait; }
+
+  int FillMsg(int);
+  int TakeDelivered(void);
+  bool IsStaged(void);
+  bool AddWaiter(void);
+  bool DropWaiter(void);
+  void Signal(void);
+  int SendQueued(void);
+  void QueueMsg(const char *, int);
+  bool TakeFrames(FRAMELENFUNCPTR, std::vector<std::string> &,
+                  std::vector<long long> *);
+  bool TakeFrames(FRAMELENFUNCPTR, std::vector<BufSlice> &,
+                  std::vector<long long> *);
+  void BadFrame(void);
+  long long GetArrival(void);
+  bool WriteAll(struct iovec *, int, bool bZeroCopy = false);
+  int SendVec(struct iovec *, int, bool);
+  void RetireBuffer(std::string &);
+  int ReapCompletions(void);
+  long long SendFileDirect(int, long long, long long, int, FILEHDRFUNCPTR);
+  long long SendFileCopy(int, long long, long long, int, FILEHDRFUNCPTR);
+  bool StartAttempt(void);
+  int FinishConnect(size_t);
+  void CancelConnect(void);
+  void ApplyProfile(int);
+  void ReportProfile(int);
+  void SetConnectError(int);
+  void Take(NetworkOps &) noexcept;
+  void AddReplyTime(long long);
+  bool IsUnixHost(void);
+  bool GetUnixAddr(DnsAddr &);
+
   std::string m_HostName;
   std::string m_Service;
 
   std::string m_ErrorStr;
+  int m_Transport;
   bool m_NonBlocking;
+  bool m_FastOpen;
+  bool m_ReusePort;
   bool m_Block;
+  int m_ReadWait;
   int m_SocketId;
   bool m_Debug;
+  bool m_PeerClosed;
+  SocketProfile m_Profile;
+  ConnHealth m_Health;
+
+  /// Connect in progress - addresses still to try and attempts in flight
+  std::vector<DnsAddr> m_ConnAddrs;
+  size_t m_ConnNext;
+  std::vector<ConnectAttempt> m_ConnAttempts;
+  long long m_ConnDeadline;
+  long long m_ConnNextStart;
+  int m_ConnectWait;
+  int m_ConnErr;
+
+  /// Receive buffer, reused for the life of the connection
+  RingBuffer m_RecvBuf;
+
+  ///
+  /// Kernel receive timestamps, guarded by m_RecvMutex. Each read's stamp
+  /// is kept against the stream offset it ended at, so a frame can be
+  /// given the arrival time of the read that completed it.
+  ///
+  bool m_RxStamps;
+  unsigned long long m_RecvTotal;
+  std::deque<std::pair<unsigned long long, long long> > m_RecvStamps;
+
+  /// Outbound queue, guarded by m_SendMutex
+  std::deque<std::string> m_SendQueue;
+  size_t m_SendOffset;
+  size_t m_SendQueued;
+  size_t m_LowWater;
+  size_t m_HighWater;
+  bool m_Throttled;
+
+  ///
+  /// MSG_ZEROCOPY, guarded by m_SendMutex. Each zero copy write gets the
+  /// next sequence number and the kernel reports ranges of them done on
+  /// the error queue. Buffers written while any were outstanding are held
+  /// until everything up to the last write has completed.
+  ///
+  bool m_ZcEnabled;
+  bool m_ZcUsed;
+  unsigned m_ZcNext;
+  unsigned m_ZcDone;
+  std::map<unsigned, unsigned> m_ZcRanges;
+  std::deque<std::pair<unsigned, std::string> > m_ZcHeld;
+  std::string m_ZcSpare;
+  unsigned long long m_ZcBytes;
+  unsigned long long m_CopyBytes;
+
+  ///
+  /// Loop owned I/O. What the event loop received is staged under
+  /// m_DeliverMutex until a read takes it, and m_WaitId (an eventfd) is
+  /// signalled when more arrives while anyone is waiting. m_LoopQueued
+  /// counts bytes handed to the loop that it hasn't finished sending.
+  ///
+  std::atomic<bool> m_Delivered;
+  int m_WaitId;
+  int m_Waiters;
+  bool m_Signalled;
+  RingBuffer m_Staged;
+  bool m_StagedEnd;
+  int m_StagedErr;
+  SENDSUBMITFUNCPTR m_Submit;
+  void *m_SubmitParam;
+  std::atomic<size_t> m_LoopQueued;
+
+  ///
+  /// Per-connection serialisation. Writers only take m_SendMutex so a
+  /// reader blocked on this socket never stalls a send, and no connection
+  /// ever waits on another. Lock order is always receive then send, and
+  /// m_DeliverMutex is only ever taken last.
+  ///
+  Mutex m_SendMutex;
+  Mutex m_RecvMutex;
+  Mutex m_DeliverMutex;
 
 #ifdef _WIN32
   bool m_Started;
@@ -7,31 +7,13 @@
 /// @file
 
 #include "NetworkOpsSSL.h"
+#include "SslCtxCache.h"
+#include "SslSessionCache.h"
+#include "UtilityFuncs.h"
 
-static char *shslmm = 0;
-
-namespace {
-///
-//----------------------------------------------------------------------------
-//   FUNCTION SPECIFICATION
-//   Name:
-///   pem_passwd_cb
-//   Description:
-///   Password cllback for PEM processing
-//   Parameters:
-//   Return:
-//   Notes:
-//----------------------------------------------------------------------------
-///
-static int pem_passwd_cb(char *buf, int size, int rwflag, void *password) {
-  if (size < (int)strlen(shslmm) + 1)
-    return (0);
-
-  strcpy(buf, shslmm);
-  return (strlen(shslmm));
-}
-
-} // namespace
+#include <algorithm>
+#include <fcntl.h>
+#include <mutex>
 
 ///
 //----------------------------------------------------------------------------
@@ -66,6 +48,32 @@ NetworkOpsSSL::NetworkOpsSSL(const char *host) {
   SetHostName(host);
 }
 
+NetworkOpsSSL::NetworkOpsSSL(NetworkOpsSSL &&val) noexcept
+    : NetworkOps(std::move(val)) {
+  m_Ctx = 0;
+  m_Ssl = 0;
+  m_Sbio = 0;
+  m_Handshaking = false;
+  m_Ktls = false;
+  m_KtlsSend = false;
+  m_KtlsRecv = false;
+  m_MemoryBio = true;
+  m_OnRings = false;
+  m_CipherEof = false;
+  TakeSSL(val);
+}
+
+// Overloading the = operator
+NetworkOpsSSL &NetworkOpsSSL::operator=(NetworkOpsSSL &&val) noexcept {
+  if (this == &val)
+    return *this;
+
+  clearCTX();
+  NetworkOps::operator=(std::move(val));
+  TakeSSL(val);
+  return *this;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -118,6 +126,9 @@ void NetworkOpsSSL::clear() {
 void NetworkOpsSSL::clearCTX(void) {
   if (GetSSL()) {
     (void)SSL_shutdown(GetSSL());
+    /// Best effort with the close notify, the socket is going anyway
+    if (m_OnRings && IsConnected())
+      (void)FlushCipher();
     SSL_free(GetSSL());
     SetSSL(0);
   }
@@ -125,6 +136,15 @@ void NetworkOpsSSL::clearCTX(void) {
     SSL_CTX_free(GetCTX());
     SetCTX(0);
   }
+  m_Handshaking = false;
+  m_ReadWantsWrite = false;
+  m_WriteWantsRead = false;
+  m_KtlsSend = false;
+  m_KtlsRecv = false;
+  m_OnRings = false;
+  m_CipherIn.clear();
+  m_CipherOut.clear();
+  m_CipherEof = false;
   return;
 }
 
@@ -146,6 +166,58 @@ bool NetworkOpsSSL::Disconnect(void) {
   return NetworkOps::Disconnect();
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   TakeSSL
+//   Description:
+///   Take over another object's SSL session and context
+//   Parameters:
+///   @param NetworkOpsSSL &val
+//   Return:
+//   Notes:
+///   The other object is left holding nothing, so only one of us frees them.
+///   A ring BIO is pointed at its new owner.
+//----------------------------------------------------------------------------
+///
+
+void NetworkOpsSSL::TakeSSL(NetworkOpsSSL &val) noexcept {
+  m_Ctx = val.m_Ctx;
+  m_Ssl = val.m_Ssl;
+  m_Sbio = val.m_Sbio;
+  m_Passwd.swap(val.m_Passwd);
+  m_Handshaking = val.m_Handshaking;
+  m_HandshakeStart = val.m_HandshakeStart;
+  m_HandshakeDeadline = val.m_HandshakeDeadline;
+  m_ReadWantsWrite = val.m_ReadWantsWrite;
+  m_WriteWantsRead = val.m_WriteWantsRead;
+  m_Ktls = val.m_Ktls;
+  m_KtlsSend = val.m_KtlsSend;
+  m_KtlsRecv = val.m_KtlsRecv;
+  m_MemoryBio = val.m_MemoryBio;
+  m_OnRings = val.m_OnRings;
+  m_CipherIn.swap(val.m_CipherIn);
+  m_CipherOut.swap(val.m_CipherOut);
+  m_CipherEof = val.m_CipherEof;
+  if (m_Ssl && m_OnRings)
+    BIO_set_data(SSL_get_rbio(m_Ssl), this);
+  val.m_Ctx = 0;
+  val.m_Ssl = 0;
+  val.m_Sbio = 0;
+  val.m_Passwd.clear();
+  val.m_Handshaking = false;
+  val.m_ReadWantsWrite = false;
+  val.m_WriteWantsRead = false;
+  val.m_KtlsSend = false;
+  val.m_KtlsRecv = false;
+  val.m_OnRings = false;
+  val.m_CipherIn.clear();
+  val.m_CipherOut.clear();
+  val.m_CipherEof = false;
+  return;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
@@ -164,6 +236,17 @@ void NetworkOpsSSL::init() {
   m_Ctx = 0;
   m_Ssl = 0;
   m_Sbio = 0;
+  m_Handshaking = false;
+  m_HandshakeStart = 0;
+  m_HandshakeDeadline = 0;
+  m_ReadWantsWrite = false;
+  m_WriteWantsRead = false;
+  m_Ktls = false;
+  m_KtlsSend = false;
+  m_KtlsRecv = false;
+  m_MemoryBio = true;
+  m_OnRings = false;
+  m_CipherEof = false;
   return;
 }
 
@@ -177,60 +260,24 @@ void NetworkOpsSSL::init() {
 //   Parameters:
 //   Return:
 //   Notes:
+///   The context comes from the process wide cache, so only the first
+///   connection with a given certificate chain reads and parses it
 //----------------------------------------------------------------------------
 ///
 
 bool NetworkOpsSSL::initCTX(const std::string *chainFile,
                             const std::string *passwd) {
-  SSL_CTX *ctx = 0;
-
-  //
-  // Load the SSL libraries etc
-  //
-  if (!GetBIO()) {
-    SSL_library_init();
-    SSL_load_error_strings();
-
-    // Setup the error stream errors
-    BIO *err = BIO_new_fp(stderr, BIO_NOCLOSE);
-    SetBIO(err);
-  }
-
-  // Create the SSL context
-  const SSL_METHOD *ctxMethod = SSLv23_method();
-  ctx = SSL_CTX_new(ctxMethod);
-  SetCTX(ctx);
-
-  // Load the chain file
-  if (!SSL_CTX_use_certificate_chain_file(ctx, chainFile->c_str())) {
-    std::string errMsg = "- Unable to read the certificate file \"";
-    errMsg += *chainFile;
-    errMsg += "\"";
-    SetError(&errMsg);
-    return false;
-  }
+  std::string errMsg;
 
   SetPasswd(passwd);
-  shslmm = (char *)passwd->c_str();
-
-  SSL_CTX_set_default_passwd_cb(ctx, pem_passwd_cb);
-
-  if (!SSL_CTX_use_PrivateKey_file(ctx, chainFile->c_str(), SSL_FILETYPE_PEM)) {
-    std::string errMsg = "- Unable to read the certificate file(1) \"";
-    errMsg += *chainFile;
-    errMsg += "\"";
-    SetError(&errMsg);
-    return false;
-  }
-
-  if (!SSL_CTX_load_verify_locations(ctx, CAROOTFILE, 0)) {
-    std::string errMsg = "- Unable to read the certificate file(2) \"";
-    errMsg += CAROOTFILE;
-    errMsg += "\"";
+  SSL_CTX *ctx = SslCtxCache::Get(*chainFile, *passwd, CAROOTFILE,
+                                  SSLv23_method(), errMsg);
+  if (!ctx) {
     SetError(&errMsg);
     return false;
   }
 
+  SetCTX(ctx);
   return true;
 }
 
@@ -244,6 +291,8 @@ bool NetworkOpsSSL::initCTX(const std::string *chainFile,
 //   Parameters:
 //   Return:
 //   Notes:
+///   Waits for the handshake, but no longer than the connect wait, so a
+///   stalled server cannot hold the caller for ever
 //----------------------------------------------------------------------------
 ///
 
@@ -253,57 +302,339 @@ bool NetworkOpsSSL::Connect(const std::string *chainFile,
   if (!NetworkOps::Connect())
     return false;
 
+  if (!StartHandshake(chainFile, passwd))
+    return false;
+
+  return (PollHandshake(-1) > 0);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   StartHandshake
+//   Description:
+///   \brief Set up TLS on the connected socket and start the handshake
+//   Parameters:
+///   @param const std::string *chainFile
+///   @param const std::string *passwd
+//   Return:
+///   @return bool - false if TLS could not be set up
+//   Notes:
+///   The socket is made non-blocking, TLS never waits inside OpenSSL.
+///   Records go through the cipher rings unless kernel TLS is wanted.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOpsSSL::StartHandshake(const std::string *chainFile,
+                                   const std::string *passwd) {
+  if (!IsConnected())
+    return false;
+
   // Setup my SSL context...
   if (!initCTX(chainFile, passwd))
     return false;
 
+#ifndef _WIN32
+  int options = fcntl(GetSockId(), F_GETFL, 0);
+  if (options != -1)
+    (void)fcntl(GetSockId(), F_SETFL, options | O_NONBLOCK);
+#else
+  u_long nBlock = 1;
+  (void)ioctlsocket(GetSockId(), FIONBIO, &nBlock);
+#endif
+
   // Setup my SSL connection...
   SSL *ssl = SSL_new(GetCTX());
-  BIO *sslbio = BIO_new_socket(GetSockId(), BIO_NOCLOSE);
+  if (!ssl) {
+    SetError(" - Unable to create an SSL connection");
+    return false;
+  }
+  bool bRings = (IsMemoryBio() && !IsKtls());
+  BIO *sslbio = (bRings) ? BIO_new(GetRingMethod())
+                         : BIO_new_socket(GetSockId(), BIO_NOCLOSE);
+  if (!sslbio) {
+    SSL_free(ssl);
+    SetError(" - Unable to create an SSL connection");
+    return false;
+  }
+  if (bRings)
+    BIO_set_data(sslbio, this);
   SSL_set_bio(ssl, sslbio, sslbio);
+  /// Writes are retried from the outbound queue, which may have moved
+  SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                        SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+  SSL_set_connect_state(ssl);
+#ifdef SSL_OP_ENABLE_KTLS
+  if (IsKtls())
+    SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
+
+  // Offer the last session with this host, if there is one
+  SslSessionCache::Resume(ssl, *GetHostName() + ":" + *GetService());
+
+  m_SslMutex.Lock();
   SetSSL(ssl);
+  m_OnRings = bRings;
+  m_CipherIn.clear();
+  m_CipherOut.clear();
+  m_CipherEof = false;
+  m_Handshaking = true;
+  m_HandshakeStart = GetTimeUs();
+  m_HandshakeDeadline = GetTimeMs() + GetConnectWait();
+  m_SslMutex.Unlock();
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   PollHandshake
+//   Description:
+///   \brief Drive the handshake
+//   Parameters:
+///   @param int millisecs - how long to wait, -1 for the connect wait
+//   Return:
+///   @return int - 1 done, 0 still in progress, -1 failed
+//   Notes:
+///   Waits for whichever of readable or writable OpenSSL asked for, and
+///   for writable too while records are waiting for the socket
+//----------------------------------------------------------------------------
+///
+
+int NetworkOpsSSL::PollHandshake(int millisecs) {
+  long long until = (millisecs < 0) ? m_HandshakeDeadline
+                                    : GetTimeMs() + millisecs;
+
+  for (;;) {
+    m_SslMutex.Lock();
+    int iRet = DoHandshake();
+    bool bWrite = m_ReadWantsWrite;
+    bool bBacklog = !m_CipherOut.empty();
+    m_SslMutex.Unlock();
+    if (iRet != 0)
+      return iRet;
+
+    long long now = GetTimeMs();
+    if (now >= m_HandshakeDeadline) {
+      SetError(" - Timed out setting up an SSL connection to remote host");
+      return -1;
+    }
+    if (now >= until)
+      return 0;
+
+    long long wake = std::min(until, m_HandshakeDeadline);
+    int wait = (int)(wake - now);
+#ifndef _WIN32
+    struct pollfd pfd = {0};
+    pfd.fd = GetSockId();
+    pfd.events = (bWrite) ? POLLOUT : POLLIN;
+    if (bBacklog)
+      pfd.events |= POLLOUT;
+    if (poll(&pfd, 1, wait) < 0 && errNo != EINTR) {
+      SetError(" - Failed waiting on an SSL connection to remote host");
+      return -1;
+    }
+#else
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(GetSockId(), &fds);
+    struct timeval timeout = {0};
+    timeout.tv_sec = wait / 1000;
+    timeout.tv_usec = (wait % 1000) * 1000;
+    fd_set wfds = fds;
+    (void)select(0, (bWrite) ? 0 : &fds, (bWrite || bBacklog) ? &wfds : 0, 0,
+                 &timeout);
+#endif
+  }
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   DoHandshake
+//   Description:
+///   \brief Take the handshake as far as the socket allows
+//   Parameters:
+//   Return:
+///   @return int - 1 done, 0 waiting on the socket, -1 failed
+//   Notes:
+///   Must be called with m_SslMutex held. On the cipher rings the whole
+///   flight OpenSSL makes goes out in one write.
+//----------------------------------------------------------------------------
+///
 
-  if (SSL_connect(ssl) <= 0) {
+int NetworkOpsSSL::DoHandshake(void) {
+  if (!m_Handshaking)
+    return (GetSSL()) ? 1 : -1;
+
+  if (m_OnRings && ReadCipher() < 0)
+    m_CipherEof = true;
+  int iRet = SSL_do_handshake(GetSSL());
+  int err = SSL_get_error(GetSSL(), iRet);
+  if (m_OnRings && FlushCipher() < 0)
+    err = SSL_ERROR_SYSCALL;
+  if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+    SetWant(err, true);
+    SetWant(err, false);
+    return 0;
+  }
+
+  m_Handshaking = false;
+  m_ReadWantsWrite = false;
+  m_WriteWantsRead = false;
+  if (iRet <= 0 || err != SSL_ERROR_NONE) {
     SetError(" - Failed to setup a valid SSL connection to remote host");
-    return false;
+    return -1;
   }
 
-  return true;
+  long long elapsed = GetTimeUs() - m_HandshakeStart;
+  SslSessionCache::Finished(GetSSL(), elapsed);
+
+#ifdef SSL_OP_ENABLE_KTLS
+  /// OpenSSL has handed the keys to the kernel if it could
+  m_KtlsSend = (IsKtls() && BIO_get_ktls_send(SSL_get_wbio(GetSSL())));
+  m_KtlsRecv = (IsKtls() && BIO_get_ktls_recv(SSL_get_rbio(GetSSL())));
+  if (IsKtls() && IsDebug())
+    (void)DebugUtils::LogMessage(
+        MSGINFO, "Debug: [%s,%d] Kernel TLS with %s (%s): send %s, receive %s",
+        __FILE__, __LINE__, GetHostName()->c_str(),
+        SSL_get_cipher_name(GetSSL()), (m_KtlsSend) ? "on" : "off",
+        (m_KtlsRecv) ? "on" : "off");
+#endif
+  if (IsDebug())
+    (void)DebugUtils::LogMessage(
+        MSGINFO,
+        "Debug: [%s,%d] TLS handshake with %s:%s %s in %lldus (%lu resumed, "
+        "%lu full, %lldms saved)",
+        __FILE__, __LINE__, GetHostName()->c_str(), GetService()->c_str(),
+        (SSL_session_reused(GetSSL())) ? "resumed" : "full", elapsed,
+        SslSessionCache::GetHits(), SslSessionCache::GetMisses(),
+        SslSessionCache::GetSavedUs() / 1000);
+  return 1;
 }
 
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   SendMsg
+///   SetWant
 //   Description:
-///   Send a message to the remote host
+///   \brief Note what a read or write is waiting for
 //   Parameters:
+///   @param int err - SSL_get_error's answer
+///   @param bool bRead - for the read side, else the write side
 //   Return:
 //   Notes:
+///   Must be called with m_SslMutex held
 //----------------------------------------------------------------------------
 ///
 
-int NetworkOpsSSL::SendMsg(void *pczMessage, int iMsgLen) {
-  int writen = 0;
-  char *tmp = 0;
+void NetworkOpsSSL::SetWant(int err, bool bRead) {
+  if (bRead)
+    m_ReadWantsWrite = (err == SSL_ERROR_WANT_WRITE);
+  else
+    m_WriteWantsRead = (err == SSL_ERROR_WANT_READ);
+  return;
+}
 
-  if (pczMessage == 0)
-    return 0;
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WriteVec
+//   Description:
+///   Encrypt and send a set of queued messages
+//   Parameters:
+//   Return:
+///   @return int - bytes written or -1
+//   Notes:
+///   Several buffers are joined first so they go out as one SSL record.
+///   While the handshake is still going the write waits (EAGAIN) and the
+///   handshake is moved on instead. On the cipher rings, records left
+///   over from the last call go first and nothing new is taken until they
+///   have, and no buffers at all just pushes them on.
+//----------------------------------------------------------------------------
+///
 
-  tmp = (char *)pczMessage;
+int NetworkOpsSSL::WriteVec(struct iovec *vec, int count) {
+  const char *tmp = 0;
+  int iMsgLen = 0;
+  std::string joined;
 
-  writen = SSL_write(GetSSL(), tmp, iMsgLen);
-  switch (SSL_get_error(GetSSL(), writen)) {
-  case SSL_ERROR_NONE:
-    if (iMsgLen != writen) {
-      SetError(" - An incomplete SSL message was written ");
-      return 0;
+  /// No buffers (vec may be NULL) just pushes queued records on
+  if (count == 1) {
+    tmp = (const char *)vec[0].iov_base;
+    iMsgLen = (int)vec[0].iov_len;
+  } else if (count > 1) {
+    for (int i = 0; i < count && joined.length() < TLSWRITEBATCH; i++)
+      joined.append((const char *)vec[i].iov_base, vec[i].iov_len);
+    tmp = joined.c_str();
+    iMsgLen = (int)joined.length();
+  }
+
+  m_SslMutex.Lock();
+  int iRet = DoHandshake();
+  int err = SSL_ERROR_WANT_WRITE;
+  int writen = -1;
+  if (iRet > 0 && m_OnRings) {
+    int left = FlushCipher();
+    if (left < 0)
+      err = SSL_ERROR_SYSCALL;
+    else if (left > 0)
+      err = SSL_ERROR_WANT_WRITE;
+    else if (iMsgLen == 0) {
+      err = SSL_ERROR_NONE;
+      writen = 0;
+    } else {
+      /// Partial writes stop at each record, so encrypt the whole batch
+      /// and send its records together
+      int want = std::min(iMsgLen, TLSWRITEBATCH);
+      int done = 0;
+      while (done < want) {
+        writen = SSL_write(GetSSL(), tmp + done, want - done);
+        err = SSL_get_error(GetSSL(), writen);
+        if (err != SSL_ERROR_NONE)
+          break;
+        done += writen;
+      }
+      if (done > 0) {
+        writen = done;
+        err = SSL_ERROR_NONE;
+      }
+      /// The records made are on their way, whatever the socket takes now
+      if (err == SSL_ERROR_NONE && FlushCipher() < 0)
+        err = SSL_ERROR_SYSCALL;
     }
+  } else if (iRet > 0 && iMsgLen == 0) {
+    err = SSL_ERROR_NONE;
+    writen = 0;
+  } else if (iRet > 0) {
+    writen = SSL_write(GetSSL(), tmp, iMsgLen);
+    err = SSL_get_error(GetSSL(), writen);
+    SetWant(err, false);
+  }
+  m_SslMutex.Unlock();
+
+  if (iRet < 0)
+    return (-1);
+
+  switch (err) {
+  case SSL_ERROR_NONE:
     break;
+  case SSL_ERROR_WANT_READ:
+  case SSL_ERROR_WANT_WRITE:
+#ifndef _WIN32
+    errno = EAGAIN;
+#else
+    WSASetLastError(WSAEWOULDBLOCK);
+#endif
+    return (-1);
   default: {
     SetError(" - A general SSL write error was detected ");
-    return 0;
+    return (-1);
   } break;
   }
   return (writen);
@@ -313,54 +644,368 @@ int NetworkOpsSSL::SendMsg(void *pczMessage, int iMsgLen) {
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
 //   Name:
-///   ReadMsg
+///   CanSendFile
+//   Description:
+///   \brief Whether file data can skip user space
+//   Parameters:
+///   @param bool bHeaded - data is split into packets with headers
+//   Return:
+///   @return bool
+//   Notes:
+///   Only once the kernel has the send keys. Headed packets are copied,
+///   as each header would go out as a record of its own.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOpsSSL::CanSendFile(bool bHeaded) {
+#ifdef SSLSENDFILE
+  return (!bHeaded && IsKtlsSend());
+#else
+  (void)bHeaded;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SendFileData
+//   Description:
+///   \brief Send file data with SSL_sendfile, the kernel encrypting it
+//   Parameters:
+///   @param int fileNo
+///   @param long long *pos - file offset, moved on by what was sent
+///   @param long long count
+//   Return:
+///   @return long long - bytes sent, or -1 with errNo set
+//   Notes:
+///   Only called when CanSendFile says so
+//----------------------------------------------------------------------------
+///
+
+long long NetworkOpsSSL::SendFileData(int fileNo, long long *pos,
+                                      long long count) {
+#ifdef SSLSENDFILE
+  m_SslMutex.Lock();
+  ossl_ssize_t writen =
+      SSL_sendfile(GetSSL(), fileNo, (off_t)*pos, (size_t)count, 0);
+  int err = (writen < 0) ? SSL_get_error(GetSSL(), (int)writen)
+                         : SSL_ERROR_NONE;
+  if (writen < 0)
+    SetWant(err, false);
+  m_SslMutex.Unlock();
+
+  if (writen >= 0) {
+    *pos += writen;
+    return (long long)writen;
+  }
+  if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ)
+    errno = EAGAIN;
+  else if (err != SSL_ERROR_SYSCALL || errno == 0)
+    errno = EIO;
+  return (-1);
+#else
+  (void)fileNo;
+  (void)pos;
+  (void)count;
+  errno = ENOSYS;
+  return (-1);
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetTransportQueued
+//   Description:
+///   \brief Encrypted records still waiting for the socket
+//   Parameters:
+//   Return:
+///   @return size_t - bytes
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+size_t NetworkOpsSSL::GetTransportQueued(void) {
+  m_SslMutex.Lock();
+  size_t queued = m_CipherOut.size();
+  m_SslMutex.Unlock();
+  return queued;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReadCipher
 //   Description:
-///   Read a message from the remote host
+///   \brief Read what the socket has into the inbound cipher ring
 //   Parameters:
 //   Return:
+///   @return int - bytes read, -1 on error
 //   Notes:
+///   Must be called with m_SslMutex held. Stops at TLSREADBATCH, so one
+///   busy connection cannot starve the rest. The peer closing is noted
+///   for the ring BIO, which reports it once the ring is empty.
 //----------------------------------------------------------------------------
 ///
 
-int NetworkOpsSSL::ReadMsg(char **ptrMessage) {
-  char *ptr = 0;
-  char *tmp = 0;
+int NetworkOpsSSL::ReadCipher(void) {
   int total_read = 0;
-  int num_read = 1;
-  int msgblk = 0;
-  int nleft = 0;
-  int rsize = 0;
-  bool bErr = false;
-
-  // Wait for something to read...
-  (void)PollMsg(-1);
-
-  msgblk = DBLOCK;
-  ptr = (char *)calloc(msgblk + 1, sizeof(char));
-  nleft = msgblk;
-  rsize = msgblk;
-  tmp = ptr;
-  bool bCont = true;
-
-  while (bCont) {
-    num_read = SSL_read(GetSSL(), tmp, msgblk);
-    if (num_read < 1) {
-      bCont = false;
-      bErr = true;
+
+  while (!m_CipherEof && total_read < TLSREADBATCH) {
+    struct iovec vec[2];
+    m_CipherIn.Reserve(DBLOCK);
+    (void)m_CipherIn.GetFreeVec(vec);
+
+    int num_read;
+    do
+      num_read = recv(GetSockId(), (char *)vec[0].iov_base,
+                      (int)vec[0].iov_len, 0);
+    while (num_read < 0 && errNo == EINTR);
+
+    if (num_read < 0)
+      return (errNo == EAGAIN || errNo == EWOULDBLOCK) ? total_read : -1;
+    if (num_read == 0) {
+      m_CipherEof = true;
+      break;
+    }
+    m_CipherIn.Commit(num_read);
+    total_read += num_read;
+    if ((size_t)num_read < vec[0].iov_len)
+      break;
+  }
+  return total_read;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   FlushCipher
+//   Description:
+///   \brief Write the outbound cipher ring to the socket
+//   Parameters:
+//   Return:
+///   @return int - bytes the socket would not take yet, -1 on error
+//   Notes:
+///   Must be called with m_SslMutex held. Everything OpenSSL has made
+///   since the last flush goes in one gather write.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOpsSSL::FlushCipher(void) {
+  while (!m_CipherOut.empty()) {
+    struct iovec vec[2];
+    int count = m_CipherOut.GetDataVec(vec);
+    int writen = NetworkOps::WriteVec(vec, count);
+    if (writen < 0) {
+      if (errNo == EAGAIN || errNo == EWOULDBLOCK)
+        break;
+      return (-1);
     }
+    m_CipherOut.Consume(writen);
+  }
+  return (int)m_CipherOut.size();
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   HasCipherRecord
+//   Description:
+///   \brief Check the inbound cipher ring for a whole record
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   Must be called with m_SslMutex held. A record read in while the write
+///   side moved a handshake on never shows up as the socket being
+///   readable.
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOpsSSL::HasCipherRecord(void) {
+  struct iovec vec[2];
+  unsigned char header[5];
+  size_t have = 0;
+
+  int count = m_CipherIn.GetDataVec(vec);
+  for (int i = 0; i < count && have < sizeof(header); i++) {
+    size_t part = std::min(sizeof(header) - have, vec[i].iov_len);
+    memcpy(header + have, vec[i].iov_base, part);
+    have += part;
+  }
+  if (have < sizeof(header))
+    return false;
+
+  /// Type, version, then the length of what follows
+  size_t length = ((size_t)header[3] << 8) | header[4];
+  return (m_CipherIn.size() >= sizeof(header) + length);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetRingMethod
+//   Description:
+///   \brief The BIO method reading and writing the cipher rings
+//   Parameters:
+//   Return:
+///   @return BIO_METHOD * - made on first use, kept for the process
+//   Notes:
+///   One BIO serves both directions, its data is the connection
+//----------------------------------------------------------------------------
+///
+
+BIO_METHOD *NetworkOpsSSL::GetRingMethod(void) {
+  static BIO_METHOD *method = 0;
+  static std::once_flag methodOnce;
+
+  std::call_once(methodOnce, []() {
+    method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK,
+                          "connection cipher rings");
+    if (!method)
+      return;
+    (void)BIO_meth_set_create(method, RingCreate);
+    (void)BIO_meth_set_read(method, RingRead);
+    (void)BIO_meth_set_write(method, RingWrite);
+    (void)BIO_meth_set_ctrl(method, RingCtrl);
+  });
+  return method;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Ring BIO callbacks
+//   Description:
+///   \brief OpenSSL's view of the cipher rings
+//   Parameters:
+//   Return:
+//   Notes:
+///   Only ever called from inside an SSL call, so with m_SslMutex held. An
+///   empty inbound ring is a retry, like a non-blocking socket, until the
+///   peer has closed. Writes always succeed, the ring grows.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOpsSSL::RingCreate(BIO *bio) {
+  BIO_set_init(bio, 1);
+  return 1;
+}
+
+int NetworkOpsSSL::RingRead(BIO *bio, char *buf, int len) {
+  NetworkOpsSSL *ops = (NetworkOpsSSL *)BIO_get_data(bio);
+  RingBuffer *ring = &ops->m_CipherIn;
+
+  BIO_clear_retry_flags(bio);
+  if (ring->empty()) {
+    if (ops->m_CipherEof)
+      return 0;
+    BIO_set_retry_read(bio);
+    return (-1);
+  }
+
+  int done = 0;
+  while (done < len && !ring->empty()) {
+    const char *ptr = 0;
+    size_t part = std::min(ring->Peek(&ptr), (size_t)(len - done));
+    memcpy(buf + done, ptr, part);
+    ring->Consume(part);
+    done += (int)part;
+  }
+  return done;
+}
+
+int NetworkOpsSSL::RingWrite(BIO *bio, const char *buf, int len) {
+  NetworkOpsSSL *ops = (NetworkOpsSSL *)BIO_get_data(bio);
+
+  BIO_clear_retry_flags(bio);
+  ops->m_CipherOut.Append(buf, len);
+  return len;
+}
+
+long NetworkOpsSSL::RingCtrl(BIO *bio, int cmd, long num, void *ptr) {
+  NetworkOpsSSL *ops = (NetworkOpsSSL *)BIO_get_data(bio);
+
+  switch (cmd) {
+  case BIO_CTRL_FLUSH:
+    return 1;
+  case BIO_CTRL_PENDING:
+    return (long)ops->m_CipherIn.size();
+  case BIO_CTRL_WPENDING:
+    return (long)ops->m_CipherOut.size();
+  case BIO_CTRL_EOF:
+    return (ops->m_CipherEof && ops->m_CipherIn.empty()) ? 1 : 0;
+  default:
+    return 0;
+  }
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   FillBuffer
+//   Description:
+///   Decrypt whatever is pending into the receive buffer
+//   Parameters:
+//   Return:
+///   @return int - bytes read, 0 if none, -1 on error or close
+//   Notes:
+///   Never blocks - half a record, or a handshake still going, is 0.
+///   Reads straight into the receive ring, which lives as long as the
+///   connection. On the cipher rings one batch is read from the socket
+///   and all of it decrypted, and anything OpenSSL has to answer (a key
+///   update, an alert) is written after.
+//----------------------------------------------------------------------------
+///
+
+int NetworkOpsSSL::FillBuffer(void) {
+  RingBuffer *ring = GetRecvBuffer();
+  int total_read = 0;
+
+  m_SslMutex.Lock();
+  int iRet = DoHandshake();
+  if (iRet > 0 && m_OnRings && ReadCipher() < 0)
+    m_CipherEof = true;
+  m_SslMutex.Unlock();
+  if (iRet <= 0)
+    return iRet;
+
+  for (;;) {
+    struct iovec vec[2];
+    ring->Reserve(DBLOCK);
+    (void)ring->GetFreeVec(vec);
+
+    m_SslMutex.Lock();
+    int num_read = SSL_read(GetSSL(), vec[0].iov_base, (int)vec[0].iov_len);
     int err = SSL_get_error(GetSSL(), num_read);
+    SetWant(err, true);
+    bool bPending = (err == SSL_ERROR_NONE &&
+                     (m_OnRings || SSL_pending(GetSSL()) > 0));
+    if (m_OnRings && err != SSL_ERROR_NONE && !m_CipherOut.empty() &&
+        FlushCipher() < 0)
+      err = SSL_ERROR_SYSCALL;
+    m_SslMutex.Unlock();
+
     if (err == SSL_ERROR_NONE) {
-      if (SSL_pending(GetSSL()) < 1)
-        bCont = false;
-    } else if (err == SSL_ERROR_WANT_READ) {
-      bCont = true;
+      ring->Commit(num_read);
+      total_read += num_read;
+      if (!bPending)
+        break;
+    } else if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+      break;
     } else if (err == SSL_ERROR_ZERO_RETURN) {
       // Socket has been closed on us cleanly
-      bCont = false;
-    } else if (err == SSL_ERROR_SYSCALL) {
-      bErr = true;
-      bCont = false;
-      break;
+      SetPeerClosed(true);
+      return (total_read > 0) ? total_read : -1;
     } else {
       int errCode = ERR_peek_last_error();
       std::string errLine;
@@ -381,39 +1026,33 @@ int NetworkOpsSSL::ReadMsg(char **ptrMessage) {
                                : " - general SSL read error detected ";
       errOut += errLine;
       SetError(&errOut);
-      bErr = true;
-      bCont = false;
-      break;
+      return (total_read > 0) ? total_read : -1;
     }
-    total_read += num_read;
-    if (bCont == false)
-      break;
-    rsize += num_read;
-    nleft -= num_read;
-    if (nleft <= 0) {
-      /// Realloc memory on the fly///
-      ptr = (char *)realloc((char *)ptr, rsize + 1);
-      nleft = num_read;
-      tmp = ptr;
-    }
-    tmp = (char *)(tmp + total_read);
-    ///
-    /// If data read on pipe is less than msgblk then
-    /// we have (hopefully) we have finished reading
-    /// so break from loop ^_^
-    ///
-    ///
-    if (num_read < msgblk)
-      break;
   }
+  return total_read;
+}
 
-  if (total_read == 0 || bErr) {
-    free(ptr);
-    *ptrMessage = 0;
-    /// EOF error///
-    return (-1);
-  } else {
-    *ptrMessage = ptr;
-    return (1);
-  }
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   IsPending
+//   Description:
+///   Check for decrypted data already held by the SSL layer
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   Such data never shows up as the socket being readable, nor does a
+///   whole record already in the inbound cipher ring
+//----------------------------------------------------------------------------
+///
+
+bool NetworkOpsSSL::IsPending(void) {
+  m_SslMutex.Lock();
+  bool bPending = (GetSSL() && !m_Handshaking &&
+                   (SSL_pending(GetSSL()) > 0 ||
+                    (m_OnRings && HasCipherRecord())));
+  m_SslMutex.Unlock();
+  return bPending;
 }
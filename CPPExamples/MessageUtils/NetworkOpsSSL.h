@@ -16,7 +16,16 @@
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
+/// SSL_sendfile came with OpenSSL 3, for builds with kernel TLS
+#if defined(__linux__) && OPENSSL_VERSION_NUMBER >= 0x30000000L &&           \
+    !defined(OPENSSL_NO_KTLS)
+#define SSLSENDFILE 1
+#endif
+
 #define CAROOTFILE "calist.pem"
+/// Most ciphertext read from the socket, and plaintext encrypted, at once
+#define TLSREADBATCH 65536
+#define TLSWRITEBATCH 65536
 
 class NetworkOpsSSL : public NetworkOps {
 public:
@@ -27,8 +36,11 @@ public:
   NetworkOpsSSL(const std::string *, const std::string *);
   NetworkOpsSSL(const char *);
   NetworkOpsSSL(const std::string *);
+  NetworkOpsSSL(NetworkOpsSSL &&) noexcept;
   ~NetworkOpsSSL();
 
+  NetworkOpsSSL &operator=(NetworkOpsSSL &&) noexcept;
+
   inline SSL_CTX *GetCTX() { return m_Ctx; }
   inline SSL *GetSSL() { return m_Ssl; }
   inline BIO *GetBIO() { return m_Sbio; }
@@ -43,20 +55,95 @@ public:
   bool Connect(const std::string *, const std::string *);
   bool Disconnect(void);
 
+  ///
+  /// Non-blocking handshake over a connected socket - StartHandshake sets
+  /// it going, PollHandshake (or simply reading and writing, e.g. from an
+  /// event loop) drives it. It has to finish within the connect wait.
+  ///
+  bool StartHandshake(const std::string *, const std::string *);
+  int PollHandshake(int);
+  inline bool IsHandshaking() { return m_Handshaking; }
+
+  bool ReadWantsWrite(void) { return m_ReadWantsWrite; }
+  bool WriteWantsRead(void) { return m_WriteWantsRead; }
+
+  ///
+  /// Kernel TLS - asked for before the handshake, the kernel then does
+  /// the record encryption once it is done. Writes still go through
+  /// SSL_write, which OpenSSL hands to the kernel, and unheaded file data
+  /// goes with SSL_sendfile (OpenSSL 3). Plain user space TLS is kept
+  /// when the kernel, the OpenSSL build or the negotiated cipher can't do
+  /// it. Not offered in the config until tried on a kernel with the tls
+  /// ULP.
+  ///
+  inline void SetKtls(bool val) { m_Ktls = val; }
+  inline bool const IsKtls() { return m_Ktls; }
+  inline bool const IsKtlsSend() { return m_KtlsSend; }
+  inline bool const IsKtlsRecv() { return m_KtlsRecv; }
+
+  ///
+  /// Memory BIOs - OpenSSL reads and writes records in rings kept here,
+  /// not the socket. Ciphertext is read in as large a batch as the socket
+  /// has, and records made by a handshake flight or a flush go out in one
+  /// gather write. On by default, set before the handshake. Kernel TLS
+  /// needs the socket, so it takes precedence.
+  ///
+  inline void SetMemoryBio(bool val) { m_MemoryBio = val; }
+  inline bool const IsMemoryBio() { return m_MemoryBio; }
+
 protected:
   void init();
   void clear();
   bool initCTX(const std::string *, const std::string *);
   void clearCTX(void);
+  void TakeSSL(NetworkOpsSSL &) noexcept;
+  int DoHandshake(void);
+  void SetWant(int, bool);
 
-private:
-  int ReadMsg(char **);
-  int SendMsg(void *, int);
+  int FillBuffer(void);
+  bool IsPending(void);
+  int WriteVec(struct iovec *, int);
+  bool CanSendFile(bool);
+  long long SendFileData(int, long long *, long long);
+  bool CanZeroCopy(void) { return false; }
+  bool CanDeliver(void) { return false; }
+  size_t GetTransportQueued(void);
 
+  int ReadCipher(void);
+  int FlushCipher(void);
+  bool HasCipherRecord(void);
+
+  /// OpenSSL BIO over the cipher rings
+  static BIO_METHOD *GetRingMethod(void);
+  static int RingCreate(BIO *);
+  static int RingRead(BIO *, char *, int);
+  static int RingWrite(BIO *, const char *, int);
+  static long RingCtrl(BIO *, int, long, void *);
+
+private:
   SSL_CTX *m_Ctx;
   SSL *m_Ssl;
   BIO *m_Sbio;
   std::string m_Passwd;
+
+  /// The SSL object is used from both the read and the write side, which
+  /// OpenSSL does not allow at once. Calls never block, so neither side
+  /// holds this for long.
+  Mutex m_SslMutex;
+  bool m_Handshaking;
+  long long m_HandshakeStart;
+  long long m_HandshakeDeadline;
+  bool m_ReadWantsWrite;
+  bool m_WriteWantsRead;
+  bool m_Ktls;
+  bool m_KtlsSend;
+  bool m_KtlsRecv;
+  bool m_MemoryBio;
+  /// Whether this connection's SSL object is on the cipher rings
+  bool m_OnRings;
+  RingBuffer m_CipherIn;
+  RingBuffer m_CipherOut;
+  bool m_CipherEof;
 };
 
 #endif
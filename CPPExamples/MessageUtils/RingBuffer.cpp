@@ -0,0 +1,292 @@
+///
+///   RingBuffer.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "RingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Constructors
+//   Description:
+///   \brief Constructor routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+RingBuffer::RingBuffer() : m_Buffer(RINGBLOCK) { clear(); }
+
+RingBuffer::RingBuffer(size_t size) : m_Buffer((size) ? size : RINGBLOCK) {
+  clear();
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Destructors
+//   Description:
+///   \brief Destructors routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+RingBuffer::~RingBuffer() {}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   clear
+//   Description:
+///   \brief Drop everything held, keeping the storage
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void RingBuffer::clear() {
+  m_Head = 0;
+  m_Used = 0;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   swap
+//   Description:
+///   \brief Exchange contents with another ring, without copying
+//   Parameters:
+///   @param RingBuffer &other
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void RingBuffer::swap(RingBuffer &other) noexcept {
+  m_Buffer.swap(other.m_Buffer);
+  std::swap(m_Head, other.m_Head);
+  std::swap(m_Used, other.m_Used);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Reserve
+//   Description:
+///   \brief Make sure at least this much free space is available
+//   Parameters:
+///   @param size_t bytes
+//   Return:
+//   Notes:
+///   The only place the ring allocates. Capacity at least doubles.
+//----------------------------------------------------------------------------
+///
+
+void RingBuffer::Reserve(size_t bytes) {
+  if (GetFree() >= bytes)
+    return;
+
+  size_t size = std::max(m_Buffer.size() * 2, m_Used + bytes);
+  (void)Linearize();
+  m_Buffer.resize(size);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetFreeVec
+//   Description:
+///   \brief Describe the free space for a scatter read
+//   Parameters:
+///   @param struct iovec *vec - at least two entries
+//   Return:
+///   @return int - entries used
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int RingBuffer::GetFreeVec(struct iovec *vec) {
+  size_t cap = m_Buffer.size();
+  size_t tail = (m_Head + m_Used) % cap;
+  size_t free = GetFree();
+
+  if (free == 0)
+    return 0;
+
+  char *base = &m_Buffer[0];
+  size_t first = std::min(free, cap - tail);
+  vec[0].iov_base = base + tail;
+  vec[0].iov_len = first;
+  if (first == free)
+    return 1;
+
+  vec[1].iov_base = base;
+  vec[1].iov_len = free - first;
+  return 2;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Commit
+//   Description:
+///   \brief Account for bytes written into the free space
+//   Parameters:
+///   @param size_t bytes
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void RingBuffer::Commit(size_t bytes) {
+  m_Used += std::min(bytes, GetFree());
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Append
+//   Description:
+///   \brief Copy data into the ring
+//   Parameters:
+///   @param const char *data
+///   @param size_t len
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void RingBuffer::Append(const char *data, size_t len) {
+  struct iovec vec[2];
+
+  Reserve(len);
+  int count = GetFreeVec(vec);
+  size_t done = 0;
+  for (int i = 0; i < count && done < len; i++) {
+    size_t part = std::min(len - done, vec[i].iov_len);
+    memcpy(vec[i].iov_base, data + done, part);
+    done += part;
+  }
+  Commit(done);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Peek
+//   Description:
+///   \brief View the first contiguous run of held data
+//   Parameters:
+///   @param const char **ptr
+//   Return:
+///   @return size_t - bytes in the run
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+size_t RingBuffer::Peek(const char **ptr) {
+  *ptr = &m_Buffer[0] + m_Head;
+  return std::min(m_Used, m_Buffer.size() - m_Head);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetDataVec
+//   Description:
+///   \brief Describe the held data for a gather write
+//   Parameters:
+///   @param struct iovec *vec - at least two entries
+//   Return:
+///   @return int - entries used
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int RingBuffer::GetDataVec(struct iovec *vec) {
+  if (m_Used == 0)
+    return 0;
+
+  const char *ptr = 0;
+  size_t first = Peek(&ptr);
+  vec[0].iov_base = (void *)ptr;
+  vec[0].iov_len = first;
+  if (first == m_Used)
+    return 1;
+
+  vec[1].iov_base = &m_Buffer[0];
+  vec[1].iov_len = m_Used - first;
+  return 2;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Linearize
+//   Description:
+///   \brief Make all held data contiguous
+//   Parameters:
+//   Return:
+///   @return const char * - start of the data, valid for size() bytes
+//   Notes:
+///   Only wrapped data is moved, rotating in place, so it never allocates.
+//----------------------------------------------------------------------------
+///
+
+const char *RingBuffer::Linearize(void) {
+  if (m_Head + m_Used > m_Buffer.size()) {
+    std::rotate(m_Buffer.begin(), m_Buffer.begin() + m_Head, m_Buffer.end());
+    m_Head = 0;
+  }
+  return &m_Buffer[0] + m_Head;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Consume
+//   Description:
+///   \brief Drop bytes from the front of the ring
+//   Parameters:
+///   @param size_t bytes
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void RingBuffer::Consume(size_t bytes) {
+  bytes = std::min(bytes, m_Used);
+  m_Head = (m_Head + bytes) % m_Buffer.size();
+  m_Used -= bytes;
+  if (m_Used == 0)
+    m_Head = 0;
+  return;
+}
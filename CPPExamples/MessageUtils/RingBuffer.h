@@ -0,0 +1,67 @@
+///
+///   RingBuffer.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __ringbuffer_h_
+#define __ringbuffer_h_
+
+#include <cstddef>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#else
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+#endif
+
+/// Default ring size, grown on demand
+#define RINGBLOCK 4096
+
+///
+/// Growable byte ring used as a connection's receive buffer. Data is
+/// written straight into the free space (GetFreeVec/Commit) and read back
+/// in place (Peek/Linearize/Consume), so steady state reads allocate
+/// nothing.
+///
+class RingBuffer {
+
+public:
+  ///
+  /// Public interface
+  ///
+  RingBuffer();
+  RingBuffer(size_t);
+  ~RingBuffer();
+
+  inline size_t size() const { return m_Used; }
+  inline bool empty() const { return (m_Used == 0); }
+  inline size_t capacity() const { return m_Buffer.size(); }
+  inline size_t GetFree() const { return m_Buffer.size() - m_Used; }
+
+  void Reserve(size_t);
+  int GetFreeVec(struct iovec *);
+  void Commit(size_t);
+  void Append(const char *, size_t);
+
+  size_t Peek(const char **);
+  int GetDataVec(struct iovec *);
+  const char *Linearize(void);
+  void Consume(size_t);
+
+  void clear();
+  void swap(RingBuffer &) noexcept;
+
+private:
+  std::vector<char> m_Buffer;
+  size_t m_Head;
+  size_t m_Used;
+};
+
+#endif
@@ -0,0 +1,313 @@
+///
+///   SslCtxCache.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "SslCtxCache.h"
+#include "SslSessionCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <openssl/err.h>
+
+std::map<std::string, SslCtxCache::CtxEntry> SslCtxCache::m_Entries;
+Mutex SslCtxCache::m_Mutex;
+unsigned long SslCtxCache::m_Hits = 0;
+unsigned long SslCtxCache::m_Loads = 0;
+
+namespace {
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   pem_passwd_cb
+//   Description:
+///   Password callback for PEM processing
+//   Parameters:
+//   Return:
+//   Notes:
+///   The password is handed over as the callback data, so loads on
+///   different threads cannot see each other's
+//----------------------------------------------------------------------------
+///
+static int pem_passwd_cb(char *buf, int size, int rwflag, void *password) {
+  const std::string *passwd = (const std::string *)password;
+  if (!passwd || size < (int)passwd->length() + 1)
+    return (0);
+
+  strcpy(buf, passwd->c_str());
+  return ((int)passwd->length());
+}
+
+static void LoadLibraries(void) {
+  SSL_library_init();
+  SSL_load_error_strings();
+}
+
+std::once_flag LibraryOnce;
+} // namespace
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   InitLibrary
+//   Description:
+///   \brief Load the SSL libraries and error strings
+//   Parameters:
+//   Return:
+//   Notes:
+///   Only the first call does anything
+//----------------------------------------------------------------------------
+///
+
+void SslCtxCache::InitLibrary(void) {
+  std::call_once(LibraryOnce, LoadLibraries);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Get
+//   Description:
+///   \brief Context for a certificate chain, from the cache where possible
+//   Parameters:
+///   @param const std::string &chainFile - certificate chain and key
+///   @param const std::string &passwd - for the private key
+///   @param const std::string &caFile - trusted CA list
+///   @param const SSL_METHOD *method
+///   @param std::string &errMsg - set if no context could be built
+//   Return:
+///   @return SSL_CTX * - a reference the caller frees with SSL_CTX_free,
+///   0 on error
+//   Notes:
+///   Checking the files costs two stat calls, nothing is read unless one
+///   of them has changed. A replaced context lives on until the last
+///   connection using it lets go.
+//----------------------------------------------------------------------------
+///
+
+SSL_CTX *SslCtxCache::Get(const std::string &chainFile,
+                          const std::string &passwd, const std::string &caFile,
+                          const SSL_METHOD *method, std::string &errMsg) {
+  InitLibrary();
+
+  std::string key = Key(chainFile, caFile, method);
+  FileStamp chain = Stamp(chainFile);
+  FileStamp ca = Stamp(caFile);
+
+  m_Mutex.Lock();
+  std::map<std::string, CtxEntry>::iterator it = m_Entries.find(key);
+  if (it != m_Entries.end() && it->second.chain == chain &&
+      it->second.ca == ca && it->second.passwd == passwd) {
+    SSL_CTX *ctx = it->second.ctx;
+    SSL_CTX_up_ref(ctx);
+    m_Hits++;
+    m_Mutex.Unlock();
+    return ctx;
+  }
+  m_Mutex.Unlock();
+
+  SSL_CTX *ctx = Load(chainFile, passwd, caFile, method, errMsg);
+  if (!ctx)
+    return 0;
+
+  CtxEntry entry;
+  entry.ctx = ctx;
+  entry.chain = chain;
+  entry.ca = ca;
+  entry.passwd = passwd;
+  SSL_CTX_up_ref(ctx);
+
+  m_Mutex.Lock();
+  m_Loads++;
+  it = m_Entries.find(key);
+  if (it != m_Entries.end()) {
+    SSL_CTX_free(it->second.ctx);
+    it->second = entry;
+  } else
+    m_Entries[key] = entry;
+  m_Mutex.Unlock();
+  return ctx;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Load
+//   Description:
+///   \brief Build a context from the PEM files
+//   Parameters:
+///   @param const std::string &chainFile
+///   @param const std::string &passwd
+///   @param const std::string &caFile
+///   @param const SSL_METHOD *method
+///   @param std::string &errMsg
+//   Return:
+///   @return SSL_CTX * - 0 on error
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+SSL_CTX *SslCtxCache::Load(const std::string &chainFile,
+                           const std::string &passwd,
+                           const std::string &caFile, const SSL_METHOD *method,
+                           std::string &errMsg) {
+  SSL_CTX *ctx = SSL_CTX_new(method);
+  if (!ctx) {
+    errMsg = "- Unable to create an SSL context";
+    return 0;
+  }
+
+  // Load the chain file
+  if (!SSL_CTX_use_certificate_chain_file(ctx, chainFile.c_str())) {
+    errMsg = "- Unable to read the certificate file \"";
+    errMsg += chainFile;
+    errMsg += "\"";
+    SSL_CTX_free(ctx);
+    return 0;
+  }
+
+  SSL_CTX_set_default_passwd_cb(ctx, pem_passwd_cb);
+  SSL_CTX_set_default_passwd_cb_userdata(ctx, (void *)&passwd);
+  bool bKey =
+      SSL_CTX_use_PrivateKey_file(ctx, chainFile.c_str(), SSL_FILETYPE_PEM);
+  SSL_CTX_set_default_passwd_cb_userdata(ctx, 0);
+  if (!bKey) {
+    errMsg = "- Unable to read the certificate file(1) \"";
+    errMsg += chainFile;
+    errMsg += "\"";
+    SSL_CTX_free(ctx);
+    return 0;
+  }
+
+  if (!SSL_CTX_load_verify_locations(ctx, caFile.c_str(), 0)) {
+    errMsg = "- Unable to read the certificate file(2) \"";
+    errMsg += caFile;
+    errMsg += "\"";
+    SSL_CTX_free(ctx);
+    return 0;
+  }
+
+  // Client sessions go to the session cache as the server hands them over
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                          SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, SslSessionCache::NewSession);
+  return ctx;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Stamp
+//   Description:
+///   \brief Modification time and size of a file
+//   Parameters:
+///   @param const std::string &fileName
+//   Return:
+///   @return FileStamp - not valid if the file cannot be seen, which never
+///   matches, so the next Get goes to the file and reports the error
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+SslCtxCache::FileStamp SslCtxCache::Stamp(const std::string &fileName) {
+  FileStamp stamp;
+  struct stat info;
+
+  memset(&stamp, 0, sizeof(stamp));
+  if (stat(fileName.c_str(), &info) == 0) {
+    stamp.valid = true;
+    stamp.mtime = info.st_mtime;
+    stamp.size = info.st_size;
+  }
+  return stamp;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Key
+//   Description:
+///   \brief Cache key for a chain file, CA file and method
+//   Parameters:
+//   Return:
+///   @return std::string
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+std::string SslCtxCache::Key(const std::string &chainFile,
+                             const std::string &caFile,
+                             const SSL_METHOD *method) {
+  char methodId[32];
+  (void)snprintf(methodId, sizeof(methodId), "%p", (const void *)method);
+
+  std::string key = chainFile;
+  key += '\0';
+  key += caFile;
+  key += '\0';
+  key += methodId;
+  return key;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Flush
+//   Description:
+///   \brief Forget every cached context
+//   Parameters:
+//   Return:
+//   Notes:
+///   Connections already holding one keep it
+//----------------------------------------------------------------------------
+///
+
+void SslCtxCache::Flush(void) {
+  m_Mutex.Lock();
+  for (std::map<std::string, CtxEntry>::iterator it = m_Entries.begin();
+       it != m_Entries.end(); ++it)
+    SSL_CTX_free(it->second.ctx);
+  m_Entries.clear();
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Counters
+//   Description:
+///   \brief Cache statistics
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+unsigned long SslCtxCache::GetHits(void) {
+  m_Mutex.Lock();
+  unsigned long hits = m_Hits;
+  m_Mutex.Unlock();
+  return hits;
+}
+
+unsigned long SslCtxCache::GetLoads(void) {
+  m_Mutex.Lock();
+  unsigned long loads = m_Loads;
+  m_Mutex.Unlock();
+  return loads;
+}
@@ -0,0 +1,73 @@
+///
+///   SslCtxCache.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __sslctxcache_h_
+#define __sslctxcache_h_
+
+#include <map>
+#include <string>
+#include <sys/stat.h>
+
+#include "Mutex.h"
+#include <openssl/ssl.h>
+
+///
+/// Process wide cache of loaded SSL contexts, keyed by certificate chain
+/// file, CA file and method. A context is built once, with the PEM files
+/// read and parsed then, and is never changed afterwards, so any number
+/// of connections can share it. It is rebuilt when either file's
+/// modification time or size changes. The files are never read with the
+/// cache lock held.
+///
+class SslCtxCache {
+
+public:
+  ///
+  /// Public interface
+  ///
+  static SSL_CTX *Get(const std::string &, const std::string &,
+                      const std::string &, const SSL_METHOD *, std::string &);
+  static void Flush(void);
+  static void InitLibrary(void);
+
+  /// Counters - contexts handed out from the cache and built from files
+  static unsigned long GetHits(void);
+  static unsigned long GetLoads(void);
+
+private:
+  struct FileStamp {
+    bool valid;
+    time_t mtime;
+    off_t size;
+
+    bool operator==(const FileStamp &val) const {
+      return (valid && val.valid && mtime == val.mtime && size == val.size);
+    }
+  };
+
+  struct CtxEntry {
+    SSL_CTX *ctx;
+    FileStamp chain;
+    FileStamp ca;
+    std::string passwd;
+  };
+
+  static FileStamp Stamp(const std::string &);
+  static SSL_CTX *Load(const std::string &, const std::string &,
+                       const std::string &, const SSL_METHOD *,
+                       std::string &);
+  static std::string Key(const std::string &, const std::string &,
+                         const SSL_METHOD *);
+
+  static std::map<std::string, CtxEntry> m_Entries;
+  static Mutex m_Mutex;
+  static unsigned long m_Hits;
+  static unsigned long m_Loads;
+};
+
+#endif
@@ -0,0 +1,455 @@
+///
+///   SslSessionCache.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "SslSessionCache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+std::map<std::string, SSL_SESSION *> SslSessionCache::m_Sessions;
+Mutex SslSessionCache::m_Mutex;
+Mutex SslSessionCache::m_SaveMutex;
+std::string SslSessionCache::m_File;
+bool SslSessionCache::m_Dirty = false;
+time_t SslSessionCache::m_LastSave = 0;
+unsigned long SslSessionCache::m_Hits = 0;
+unsigned long SslSessionCache::m_Misses = 0;
+long long SslSessionCache::m_ResumedUs = 0;
+long long SslSessionCache::m_FullUs = 0;
+
+namespace {
+/// Longest session line accepted from the file
+#define SSLSESSIONLINE 16384
+
+static void FreeKey(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx,
+                    long argl, void *argp) {
+  delete (std::string *)ptr;
+}
+
+/// SSL extra data slot holding the cache key of a connection
+static int KeyIndex(void) {
+  static int index = SSL_get_ex_new_index(0, 0, 0, 0, FreeKey);
+  return index;
+}
+
+static bool IsLive(SSL_SESSION *sess) {
+  return (SSL_SESSION_get_time(sess) + SSL_SESSION_get_timeout(sess) >
+          (long)time(0));
+}
+} // namespace
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Resume
+//   Description:
+///   \brief Offer the cached session for a host on a new connection
+//   Parameters:
+///   @param SSL *ssl - not yet connected
+///   @param const std::string &key - host and service
+//   Return:
+//   Notes:
+///   Also tags the connection with the key, so whatever session the
+///   server hands back is filed under it
+//----------------------------------------------------------------------------
+///
+
+void SslSessionCache::Resume(SSL *ssl, const std::string &key) {
+  (void)SSL_set_ex_data(ssl, KeyIndex(), new std::string(key));
+
+  m_Mutex.Lock();
+  std::map<std::string, SSL_SESSION *>::iterator it = m_Sessions.find(key);
+  if (it != m_Sessions.end()) {
+    if (IsLive(it->second))
+      (void)SSL_set_session(ssl, it->second);
+    else {
+      SSL_SESSION_free(it->second);
+      m_Sessions.erase(it);
+    }
+  }
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Finished
+//   Description:
+///   \brief Count a completed handshake
+//   Parameters:
+///   @param SSL *ssl
+///   @param long long elapsed - handshake time (us)
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void SslSessionCache::Finished(SSL *ssl, long long elapsed) {
+  m_Mutex.Lock();
+  if (SSL_session_reused(ssl)) {
+    m_Hits++;
+    m_ResumedUs += elapsed;
+  } else {
+    m_Misses++;
+    m_FullUs += elapsed;
+  }
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   NewSession
+//   Description:
+///   \brief OpenSSL new session callback
+//   Parameters:
+///   @param SSL *ssl
+///   @param SSL_SESSION *sess
+//   Return:
+///   @return int - 1 if the cache kept the reference, 0 if OpenSSL should
+///   drop it
+//   Notes:
+///   Connections without a key (not set up by Resume) are ignored
+//----------------------------------------------------------------------------
+///
+
+int SslSessionCache::NewSession(SSL *ssl, SSL_SESSION *sess) {
+  std::string *key = (std::string *)SSL_get_ex_data(ssl, KeyIndex());
+  if (!key || !SSL_SESSION_is_resumable(sess))
+    return 0;
+
+  Store(*key, sess);
+  return 1;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Store
+//   Description:
+///   \brief File a session under a key, replacing the one there
+//   Parameters:
+///   @param const std::string &key
+///   @param SSL_SESSION *sess - the cache takes over this reference
+//   Return:
+//   Notes:
+///   Only marks the file out of date, the next Sync writes it
+//----------------------------------------------------------------------------
+///
+
+void SslSessionCache::Store(const std::string &key, SSL_SESSION *sess) {
+  m_Mutex.Lock();
+  std::map<std::string, SSL_SESSION *>::iterator it = m_Sessions.find(key);
+  if (it != m_Sessions.end()) {
+    SSL_SESSION_free(it->second);
+    it->second = sess;
+  } else
+    m_Sessions[key] = sess;
+  m_Dirty = true;
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Sync
+//   Description:
+///   \brief Write the sessions file if sessions have changed
+//   Parameters:
+///   @param bool bForce - write now, else not within SSLSESSIONSAVE of
+///          the last write
+//   Return:
+///   @return bool - false if the file could not be written
+//   Notes:
+///   Called from outside any handshake, e.g. after a login, on the
+///   nexus's idle timeout and at shutdown
+//----------------------------------------------------------------------------
+///
+
+bool SslSessionCache::Sync(bool bForce) {
+  time_t now = time(0);
+
+  m_Mutex.Lock();
+  bool bSave = m_Dirty && !m_File.empty() &&
+               (bForce || now - m_LastSave >= SSLSESSIONSAVE);
+  if (bSave) {
+    m_Dirty = false;
+    m_LastSave = now;
+  }
+  m_Mutex.Unlock();
+
+  if (!bSave || Save())
+    return true;
+
+  /// Try again next time
+  m_Mutex.Lock();
+  m_Dirty = true;
+  m_Mutex.Unlock();
+  return false;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SetFile
+//   Description:
+///   \brief Keep the sessions in a file
+//   Parameters:
+///   @param const std::string &fileName - empty stops saving
+//   Return:
+///   @return bool - false if an existing file could not be read
+//   Notes:
+///   The file holds session secrets, so it is created readable only by
+///   its owner. Sessions already cached are kept, the file's are added.
+///   Changes not yet written go to the old file first.
+//----------------------------------------------------------------------------
+///
+
+bool SslSessionCache::SetFile(const std::string &fileName) {
+  (void)Sync(true);
+
+  m_Mutex.Lock();
+  m_File = fileName;
+  m_Dirty = !m_Sessions.empty();
+  m_Mutex.Unlock();
+
+  return (fileName.empty() || Load());
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Load
+//   Description:
+///   \brief Read the sessions file
+//   Parameters:
+//   Return:
+///   @return bool - true if there is no file yet
+//   Notes:
+///   One session a line, "<key> <hex DER>". Expired or unreadable
+///   sessions are skipped.
+//----------------------------------------------------------------------------
+///
+
+bool SslSessionCache::Load(void) {
+  m_Mutex.Lock();
+  std::string fileName = m_File;
+  m_Mutex.Unlock();
+
+  FILE *in = fopen(fileName.c_str(), "r");
+  if (!in)
+    return (errno == ENOENT);
+
+  std::vector<char> line(SSLSESSIONLINE);
+  std::vector<unsigned char> der;
+  while (fgets(&line[0], (int)line.size(), in)) {
+    char *space = strchr(&line[0], ' ');
+    if (!space)
+      continue;
+    std::string key(&line[0], space - &line[0]);
+
+    der.clear();
+    unsigned int byte = 0;
+    for (char *hex = space + 1; sscanf(hex, "%2x", &byte) == 1; hex += 2)
+      der.push_back((unsigned char)byte);
+
+    const unsigned char *ptr = (der.empty()) ? 0 : &der[0];
+    SSL_SESSION *sess = (ptr) ? d2i_SSL_SESSION(0, &ptr, (long)der.size()) : 0;
+    if (!sess)
+      continue;
+    if (!IsLive(sess)) {
+      SSL_SESSION_free(sess);
+      continue;
+    }
+
+    m_Mutex.Lock();
+    std::map<std::string, SSL_SESSION *>::iterator it = m_Sessions.find(key);
+    if (it == m_Sessions.end())
+      m_Sessions[key] = sess;
+    else
+      SSL_SESSION_free(sess);
+    m_Mutex.Unlock();
+  }
+  fclose(in);
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Save
+//   Description:
+///   \brief Write the sessions file
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+///   Written to a temporary file and renamed over the old one, so a crash
+///   never leaves half a file. The file is written without the cache
+///   lock, so handshakes are not held up by it.
+//----------------------------------------------------------------------------
+///
+
+bool SslSessionCache::Save(void) {
+  static const char hexDigits[] = "0123456789abcdef";
+  std::string contents;
+
+  m_SaveMutex.Lock();
+  m_Mutex.Lock();
+  std::string fileName = m_File;
+  for (std::map<std::string, SSL_SESSION *>::iterator it = m_Sessions.begin();
+       it != m_Sessions.end(); ++it) {
+    if (!IsLive(it->second))
+      continue;
+    int len = i2d_SSL_SESSION(it->second, 0);
+    if (len <= 0 || len * 2 + (int)it->first.length() + 2 > SSLSESSIONLINE)
+      continue;
+    std::vector<unsigned char> der(len);
+    unsigned char *ptr = &der[0];
+    (void)i2d_SSL_SESSION(it->second, &ptr);
+
+    contents += it->first;
+    contents += ' ';
+    for (int i = 0; i < len; i++) {
+      contents += hexDigits[der[i] >> 4];
+      contents += hexDigits[der[i] & 0x0f];
+    }
+    contents += '\n';
+  }
+  m_Mutex.Unlock();
+
+  if (fileName.empty()) {
+    m_SaveMutex.Unlock();
+    return true;
+  }
+
+  std::string tmpName = fileName + ".tmp";
+#ifndef _WIN32
+  int fileId = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  FILE *out = (fileId < 0) ? 0 : fdopen(fileId, "w");
+  if (!out && fileId >= 0)
+    (void)close(fileId);
+#else
+  FILE *out = fopen(tmpName.c_str(), "w");
+#endif
+  if (!out) {
+    m_SaveMutex.Unlock();
+    return false;
+  }
+
+  bool bOk = (fwrite(contents.data(), 1, contents.length(), out) ==
+              contents.length());
+  bOk = (fclose(out) == 0) && bOk;
+#ifdef _WIN32
+  (void)remove(fileName.c_str());
+#endif
+  if (!bOk || rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    (void)remove(tmpName.c_str());
+    bOk = false;
+  }
+  m_SaveMutex.Unlock();
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Flush
+//   Description:
+///   \brief Forget every cached session
+//   Parameters:
+//   Return:
+//   Notes:
+///   The file, if any, is left alone
+//----------------------------------------------------------------------------
+///
+
+void SslSessionCache::Flush(void) {
+  m_Mutex.Lock();
+  for (std::map<std::string, SSL_SESSION *>::iterator it = m_Sessions.begin();
+       it != m_Sessions.end(); ++it)
+    SSL_SESSION_free(it->second);
+  m_Sessions.clear();
+  m_Mutex.Unlock();
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Counters
+//   Description:
+///   \brief Cache statistics
+//   Parameters:
+//   Return:
+//   Notes:
+///   Saved time assumes each resumed handshake would otherwise have cost
+///   an average full one
+//----------------------------------------------------------------------------
+///
+
+unsigned long SslSessionCache::GetHits(void) {
+  m_Mutex.Lock();
+  unsigned long hits = m_Hits;
+  m_Mutex.Unlock();
+  return hits;
+}
+
+unsigned long SslSessionCache::GetMisses(void) {
+  m_Mutex.Lock();
+  unsigned long misses = m_Misses;
+  m_Mutex.Unlock();
+  return misses;
+}
+
+long long SslSessionCache::GetResumedUs(void) {
+  m_Mutex.Lock();
+  long long resumedUs = m_ResumedUs;
+  m_Mutex.Unlock();
+  return resumedUs;
+}
+
+long long SslSessionCache::GetFullUs(void) {
+  m_Mutex.Lock();
+  long long fullUs = m_FullUs;
+  m_Mutex.Unlock();
+  return fullUs;
+}
+
+long long SslSessionCache::GetSavedUs(void) {
+  m_Mutex.Lock();
+  long long saved = 0;
+  if (m_Misses > 0 && m_Hits > 0) {
+    saved = (m_FullUs / (long long)m_Misses) * (long long)m_Hits - m_ResumedUs;
+    if (saved < 0)
+      saved = 0;
+  }
+  m_Mutex.Unlock();
+  return saved;
+}
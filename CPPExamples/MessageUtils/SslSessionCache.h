@@ -0,0 +1,72 @@
+///
+///   SslSessionCache.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __sslsessioncache_h_
+#define __sslsessioncache_h_
+
+#include <map>
+#include <string>
+
+#include "Mutex.h"
+#include <openssl/ssl.h>
+
+/// Least time (seconds) between unforced writes of the sessions file
+#define SSLSESSIONSAVE 60
+
+///
+/// Process wide cache of TLS client sessions, one per host and service,
+/// so a reconnect resumes the last session (session ID or ticket) instead
+/// of doing a full handshake. Sessions are stored as the server hands
+/// them over, which for TLS 1.3 is after the handshake, through the new
+/// session callback the cached contexts are built with. Optionally kept
+/// in a file, readable only by its owner, so a restart can resume too.
+/// The file is never written from the callback, which runs inside a
+/// handshake or read, only by Sync.
+///
+class SslSessionCache {
+
+public:
+  ///
+  /// Public interface
+  ///
+  static void Resume(SSL *, const std::string &);
+  static void Finished(SSL *, long long);
+  static int NewSession(SSL *, SSL_SESSION *);
+  static void Flush(void);
+
+  static bool SetFile(const std::string &);
+  static bool Sync(bool bForce = false);
+
+  /// Counters - handshakes that resumed a session, full handshakes, and
+  /// the total time (us) spent in each
+  static unsigned long GetHits(void);
+  static unsigned long GetMisses(void);
+  static long long GetResumedUs(void);
+  static long long GetFullUs(void);
+  static long long GetSavedUs(void);
+
+private:
+  static void Store(const std::string &, SSL_SESSION *);
+  static bool Save(void);
+  static bool Load(void);
+
+  static std::map<std::string, SSL_SESSION *> m_Sessions;
+  static Mutex m_Mutex;
+  /// Held over a whole Save, so writers never share the temporary file
+  static Mutex m_SaveMutex;
+  static std::string m_File;
+  /// Sessions changed since the file was last written
+  static bool m_Dirty;
+  static time_t m_LastSave;
+  static unsigned long m_Hits;
+  static unsigned long m_Misses;
+  static long long m_ResumedUs;
+  static long long m_FullUs;
+};
+
+#endif
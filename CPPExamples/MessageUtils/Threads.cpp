@@ -31,44 +31,10 @@ Threads::Threads(CALLBACKFUNCPTR func, void *param) {
   SetParam(param);
 }
 
-Threads::Threads(const Threads &val) {
+Threads::Threads(Threads &&val) noexcept {
   init();
-
-  m_ThreadId = val.m_ThreadId;
-  m_ThreadHandle = val.m_ThreadHandle;
-  m_Callback = val.m_Callback;
-#ifdef _WIN32
-  m_Pta = val.m_Pta;
-#else
-  int ins = 0;
-  (void)pthread_attr_getinheritsched(&val.m_Pta, &ins);
-  (void)pthread_attr_setinheritsched(&m_Pta, ins);
-  struct sched_param param = {0};
-  (void)pthread_attr_getschedparam(&val.m_Pta, &param);
-  (void)pthread_attr_setschedparam(&m_Pta, &param);
-  int policy = 0;
-  (void)pthread_attr_getschedpolicy(&val.m_Pta, &policy);
-  (void)pthread_attr_setschedpolicy(&m_Pta, policy);
-  int scope = 0;
-  (void)pthread_attr_getscope(&val.m_Pta, &scope);
-  (void)pthread_attr_setscope(&m_Pta, scope);
-  size_t stack = 0;
-  (void)pthread_attr_getstacksize(&val.m_Pta, &stack);
-  (void)pthread_attr_setstacksize(&m_Pta, stack);
-
-  void *stackAddrx = 0;
-  size_t v = 0;
-  (void)pthread_attr_getstack(&val.m_Pta, &stackAddrx, &v);
-  (void)pthread_attr_setstack(&m_Pta, stackAddrx, v);
-  //(void)pthread_attr_getstackaddr(&val.m_Pta, &stackAddrx);
-  //(void)pthread_attr_setstackaddr(&m_Pta, stackAddrx);
-
-  int detached = 0;
-  (void)pthread_attr_getdetachstate(&val.m_Pta, &detached);
-  (void)pthread_attr_setdetachstate(&m_Pta, detached);
-#endif
-  m_Param = val.m_Param;
-  m_Started = val.m_Started;
+  m_Param = 0;
+  Take(val);
 }
 
 ///
@@ -123,44 +89,13 @@ bool Threads::operator!=(const Threads &other) const {
 }
 
 /// Overloading the = operator
-Threads &Threads::operator=(const Threads &val) {
+Threads &Threads::operator=(Threads &&val) noexcept {
   if (this == &val)
     return *this;
 
-  m_ThreadId = val.m_ThreadId;
-  m_ThreadHandle = val.m_ThreadHandle;
-  m_Callback = val.m_Callback;
-#ifdef _WIN32
-  m_Pta = val.m_Pta;
-#else
-  int ins = 0;
-  (void)pthread_attr_getinheritsched(&val.m_Pta, &ins);
-  (void)pthread_attr_setinheritsched(&m_Pta, ins);
-  struct sched_param param = {0};
-  (void)pthread_attr_getschedparam(&val.m_Pta, &param);
-  (void)pthread_attr_setschedparam(&m_Pta, &param);
-  int policy = 0;
-  (void)pthread_attr_getschedpolicy(&val.m_Pta, &policy);
-  (void)pthread_attr_setschedpolicy(&m_Pta, policy);
-  int scope = 0;
-  (void)pthread_attr_getscope(&val.m_Pta, &scope);
-  (void)pthread_attr_setscope(&m_Pta, scope);
-  size_t stack = 0;
-  (void)pthread_attr_getstacksize(&val.m_Pta, &stack);
-  (void)pthread_attr_setstacksize(&m_Pta, stack);
-  void *stackAddrx = 0;
-  size_t v = 0;
-  (void)pthread_attr_getstack(&val.m_Pta, &stackAddrx, &v);
-  (void)pthread_attr_setstack(&m_Pta, stackAddrx, v);
-  //(void)pthread_attr_getstackaddr(&val.m_Pta, &stackAddrx);
-  //(void)pthread_attr_setstackaddr(&m_Pta, stackAddrx);
-  int detached = 0;
-  (void)pthread_attr_getdetachstate(&val.m_Pta, &detached);
-  (void)pthread_attr_setdetachstate(&m_Pta, detached);
-#endif
-  m_Param = val.m_Param;
-  m_Started = val.m_Started;
-
+  (void)Stop();
+  m_Started = false;
+  Take(val);
   return *this;
 }
 
@@ -174,6 +109,44 @@ bool Threads::operator<(const Threads &other) const {
   return (m_ThreadId < other.m_ThreadId);
 }
 
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Take
+//   Description:
+///   \brief Take over another object's thread and attributes
+//   Parameters:
+///   @param Threads &val
+//   Return:
+///   @return void
+//   Notes:
+///   The attributes are swapped, so each object still destroys exactly one
+///   set. The other object is left not started, so its destructor leaves
+///   the thread alone.
+//----------------------------------------------------------------------------
+///
+
+void Threads::Take(Threads &val) noexcept {
+#ifndef _WIN32
+  std::swap(m_Pta, val.m_Pta);
+#else
+  m_Pta = val.m_Pta;
+#endif
+  m_ThreadId = val.m_ThreadId;
+  m_ThreadHandle = val.m_ThreadHandle;
+  m_Callback = val.m_Callback;
+  m_Param = val.m_Param;
+  m_Started = val.m_Started;
+
+  val.m_ThreadId = 0;
+  val.m_ThreadHandle = 0;
+  val.m_Callback = 0;
+  val.m_Param = 0;
+  val.m_Started = false;
+  return;
+}
+
 ///
 //----------------------------------------------------------------------------
 //   FUNCTION SPECIFICATION
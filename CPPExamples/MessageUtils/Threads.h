@@ -40,10 +40,17 @@ public:
   ///
   Threads();
   Threads(CALLBACKFUNCPTR, void *);
-  Threads(const Threads &);
+  Threads(Threads &&) noexcept;
 
   ~Threads();
 
+  ///
+  /// Move only - a running thread is cancelled by the one object that
+  /// owns it
+  ///
+  Threads(const Threads &) = delete;
+  Threads &operator=(const Threads &) = delete;
+
   inline const THREADTYPE GetThreadId() { return m_ThreadId; }
   inline const THREADHANDLE GetThreadHandle() { return m_ThreadHandle; }
 
@@ -72,7 +79,7 @@ public:
   bool operator!=(const Threads &other) const;
 
   /// Overloading the = operator
-  Threads &operator=(const Threads &other);
+  Threads &operator=(Threads &&other) noexcept;
 
   /// Overloading the > operator
   bool operator>(const Threads &other) const;
@@ -86,6 +93,8 @@ protected:
   ///
 
 private:
+  void Take(Threads &) noexcept;
+
   THREADTYPE m_ThreadId;
   THREADHANDLE m_ThreadHandle;
   CALLBACKFUNCPTR m_Callback;
@@ -0,0 +1,794 @@
+///
+///   UringPoller.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#include "UringPoller.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Constructors
+//   Description:
+///   \brief Constructor routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+UringPoller::UringPoller() {
+  m_RingId = -1;
+  m_SqRing = 0;
+  m_CqRing = 0;
+  m_Sqes = 0;
+  m_SqRingSz = 0;
+  m_CqRingSz = 0;
+  m_SqesSz = 0;
+  m_SqHead = 0;
+  m_SqTail = 0;
+  m_SqMask = 0;
+  m_SqArray = 0;
+  m_SqEntries = 0;
+  m_CqHead = 0;
+  m_CqTail = 0;
+  m_CqMask = 0;
+  m_Cqes = 0;
+  m_SqPending = 0;
+  m_BufRing = 0;
+  m_BufRingSz = 0;
+  m_Bufs = 0;
+  m_BufCount = 0;
+  m_BufSize = 0;
+  m_BufTail = 0;
+  m_Enters = 0;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Destructors
+//   Description:
+///   \brief Destructors routines
+//   Parameters:
+//   Return:
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+UringPoller::~UringPoller() { Close(); }
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Open
+//   Description:
+///   \brief Create the ring and map it in
+//   Parameters:
+///   @param unsigned entries - submission queue size
+//   Return:
+///   @return bool - false if io_uring is missing, disabled or too old
+//   Notes:
+///   Waits need IORING_FEAT_EXT_ARG (5.11) for their timeout. Callers
+///   fall back to another poller when this fails.
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::Open(unsigned entries) {
+#ifdef __linux__
+  if (IsOpen())
+    return true;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  params.cq_entries = entries * 2;
+
+  int ringId = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ringId < 0)
+    return false;
+
+  if (!(params.features & IORING_FEAT_EXT_ARG) ||
+      !(params.features & IORING_FEAT_NODROP)) {
+    (void)close(ringId);
+    return false;
+  }
+  m_RingId = ringId;
+
+  m_SqRingSz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_CqRingSz =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (m_CqRingSz > m_SqRingSz)
+      m_SqRingSz = m_CqRingSz;
+    m_CqRingSz = 0;
+  }
+  m_SqesSz = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  m_SqRing = mmap(0, m_SqRingSz, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, m_RingId, IORING_OFF_SQ_RING);
+  if (m_SqRing == MAP_FAILED) {
+    m_SqRing = 0;
+    Close();
+    return false;
+  }
+  if (m_CqRingSz == 0)
+    m_CqRing = m_SqRing;
+  else {
+    m_CqRing = mmap(0, m_CqRingSz, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_RingId, IORING_OFF_CQ_RING);
+    if (m_CqRing == MAP_FAILED) {
+      m_CqRing = 0;
+      Close();
+      return false;
+    }
+  }
+  m_Sqes = mmap(0, m_SqesSz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                m_RingId, IORING_OFF_SQES);
+  if (m_Sqes == MAP_FAILED) {
+    m_Sqes = 0;
+    Close();
+    return false;
+  }
+
+  char *sq = (char *)m_SqRing;
+  m_SqHead = (unsigned *)(sq + params.sq_off.head);
+  m_SqTail = (unsigned *)(sq + params.sq_off.tail);
+  m_SqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+  m_SqArray = (unsigned *)(sq + params.sq_off.array);
+  m_SqEntries = *(unsigned *)(sq + params.sq_off.ring_entries);
+
+  char *cq = (char *)m_CqRing;
+  m_CqHead = (unsigned *)(cq + params.cq_off.head);
+  m_CqTail = (unsigned *)(cq + params.cq_off.tail);
+  m_CqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+  m_Cqes = cq + params.cq_off.cqes;
+  return true;
+#else
+  (void)entries;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Close
+//   Description:
+///   \brief Unmap and close the ring
+//   Parameters:
+//   Return:
+//   Notes:
+///   Outstanding requests are cancelled by the kernel with the ring, which
+///   also lets go of the provided buffers before they are unmapped
+//----------------------------------------------------------------------------
+///
+
+void UringPoller::Close(void) {
+#ifdef __linux__
+  if (m_Sqes)
+    (void)munmap(m_Sqes, m_SqesSz);
+  if (m_CqRing && m_CqRing != m_SqRing)
+    (void)munmap(m_CqRing, m_CqRingSz);
+  if (m_SqRing)
+    (void)munmap(m_SqRing, m_SqRingSz);
+  if (m_RingId != -1)
+    (void)close(m_RingId);
+  if (m_BufRing)
+    (void)munmap(m_BufRing, m_BufRingSz);
+#endif
+  m_RingId = -1;
+  m_SqRing = 0;
+  m_CqRing = 0;
+  m_Sqes = 0;
+  m_SqPending = 0;
+  m_BufRing = 0;
+  m_Bufs = 0;
+  m_BufCount = 0;
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   OpenRecvBuffers
+//   Description:
+///   \brief Register the ring of buffers multishot receives fill
+//   Parameters:
+///   @param unsigned count - buffers, a power of 2
+///   @param unsigned size - bytes in each
+//   Return:
+///   @return bool - false if the kernel can't provide buffers (before 5.19)
+//   Notes:
+///   The ring and the buffers are one anonymous mapping, the ring first so
+///   it starts on a page as the kernel requires
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::OpenRecvBuffers(unsigned count, unsigned size) {
+#ifdef URINGRECVMULTI
+  if (!IsOpen() || count == 0 || (count & (count - 1)) != 0 || count > 32768)
+    return false;
+  if (HasRecvBuffers())
+    return true;
+
+  size_t ringSz = count * sizeof(struct io_uring_buf);
+  size_t mapSz = ringSz + (size_t)count * size;
+  void *mem = mmap(0, mapSz, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (mem == MAP_FAILED)
+    return false;
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (unsigned long long)(uintptr_t)mem;
+  reg.ring_entries = count;
+  reg.bgid = URINGRECVGROUP;
+  if (syscall(__NR_io_uring_register, m_RingId, IORING_REGISTER_PBUF_RING,
+              &reg, 1) < 0) {
+    (void)munmap(mem, mapSz);
+    return false;
+  }
+
+  m_BufMutex.Lock();
+  m_BufRing = mem;
+  m_BufRingSz = mapSz;
+  m_Bufs = (char *)mem + ringSz;
+  m_BufCount = count;
+  m_BufSize = size;
+  m_BufTail = 0;
+  m_BufMutex.Unlock();
+
+  UringEvent ev;
+  ev.userData = 0;
+  ev.result = 0;
+  for (unsigned i = 0; i < count; i++) {
+    ev.flags = IORING_CQE_F_BUFFER | (i << IORING_CQE_BUFFER_SHIFT);
+    ReturnRecvBuffer(ev);
+  }
+  return true;
+#else
+  (void)count;
+  (void)size;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   PollAdd
+//   Description:
+///   \brief Queue a one-shot readiness poll on a descriptor
+//   Parameters:
+///   @param int sockId
+///   @param unsigned mask - POLLIN, POLLOUT, POLLRDHUP...
+///   @param unsigned long long userData - handed back by Wait
+///   @param bool bSubmit - hand it to the kernel now rather than with the
+///   next wait
+//   Return:
+///   @return bool
+//   Notes:
+///   The poll checks readiness when it is submitted, so nothing that
+///   arrived in between is missed
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::PollAdd(int sockId, unsigned mask,
+                          unsigned long long userData, bool bSubmit) {
+#ifdef __linux__
+  struct io_uring_sqe sqe;
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = IORING_OP_POLL_ADD;
+  sqe.fd = sockId;
+  /// The kernel swaps the halves of the 32 bit mask on big endian machines
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  mask = (mask << 16) | (mask >> 16);
+#endif
+  sqe.poll32_events = mask;
+  sqe.user_data = userData;
+
+  m_SqMutex.Lock();
+  bool bRet = Queue(sqe);
+  m_SqMutex.Unlock();
+  return (bRet && bSubmit) ? Submit() : bRet;
+#else
+  (void)sockId;
+  (void)mask;
+  (void)userData;
+  (void)bSubmit;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   PollRemove
+//   Description:
+///   \brief Cancel an outstanding poll
+//   Parameters:
+///   @param unsigned long long userData - as given to PollAdd
+///   @param bool bSubmit
+//   Return:
+///   @return bool
+//   Notes:
+///   A pending poll holds a reference on the socket, so removals should be
+///   submitted straight away. The cancelled poll completes with -ECANCELED,
+///   unless it had already fired.
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::PollRemove(unsigned long long userData, bool bSubmit) {
+#ifdef __linux__
+  struct io_uring_sqe sqe;
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = IORING_OP_POLL_REMOVE;
+  sqe.fd = -1;
+  sqe.addr = userData;
+  sqe.user_data = URINGIGNORE;
+
+  m_SqMutex.Lock();
+  bool bRet = Queue(sqe);
+  m_SqMutex.Unlock();
+  return (bRet && bSubmit) ? Submit() : bRet;
+#else
+  (void)userData;
+  (void)bSubmit;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Cancel
+//   Description:
+///   \brief Cancel an outstanding receive or send
+//   Parameters:
+///   @param unsigned long long userData - as given when it was queued
+///   @param bool bSubmit
+//   Return:
+///   @return bool
+//   Notes:
+///   As with PollRemove, the request completes with -ECANCELED unless it
+///   had finished already
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::Cancel(unsigned long long userData, bool bSubmit) {
+#ifdef __linux__
+  struct io_uring_sqe sqe;
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = userData;
+  sqe.user_data = URINGIGNORE;
+
+  m_SqMutex.Lock();
+  bool bRet = Queue(sqe);
+  m_SqMutex.Unlock();
+  return (bRet && bSubmit) ? Submit() : bRet;
+#else
+  (void)userData;
+  (void)bSubmit;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RecvMulti
+//   Description:
+///   \brief Queue a multishot receive into the provided buffers
+//   Parameters:
+///   @param int sockId
+///   @param unsigned long long userData - handed back with each completion
+///   @param bool bSubmit
+//   Return:
+///   @return bool
+//   Notes:
+///   Every read the kernel makes completes with IORING_CQE_F_MORE set while
+///   the receive stays armed. One without it is the last - end of file,
+///   an error, or -ENOBUFS when every buffer is in use, after which it has
+///   to be queued again.
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::RecvMulti(int sockId, unsigned long long userData,
+                            bool bSubmit) {
+#ifdef URINGRECVMULTI
+  if (!HasRecvBuffers())
+    return false;
+
+  struct io_uring_sqe sqe;
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = IORING_OP_RECV;
+  sqe.fd = sockId;
+  sqe.flags = IOSQE_BUFFER_SELECT;
+  sqe.buf_group = URINGRECVGROUP;
+  sqe.ioprio = IORING_RECV_MULTISHOT;
+  sqe.user_data = userData;
+
+  m_SqMutex.Lock();
+  bool bRet = Queue(sqe);
+  m_SqMutex.Unlock();
+  return (bRet && bSubmit) ? Submit() : bRet;
+#else
+  (void)sockId;
+  (void)userData;
+  (void)bSubmit;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   SendMsg
+//   Description:
+///   \brief Queue a gather send
+//   Parameters:
+///   @param int sockId
+///   @param struct msghdr *msg - it and its buffers must stay put until
+///   the send completes
+///   @param unsigned long long userData
+///   @param bool bSubmit
+//   Return:
+///   @return bool
+//   Notes:
+///   MSG_WAITALL has the kernel carry on after a short send, so the
+///   completion is for everything or an error
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::SendMsg(int sockId, struct msghdr *msg,
+                          unsigned long long userData, bool bSubmit) {
+#ifdef __linux__
+  struct io_uring_sqe sqe;
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = IORING_OP_SENDMSG;
+  sqe.fd = sockId;
+  sqe.addr = (unsigned long long)(uintptr_t)msg;
+  sqe.len = 1;
+  sqe.msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+  sqe.user_data = userData;
+
+  m_SqMutex.Lock();
+  bool bRet = Queue(sqe);
+  m_SqMutex.Unlock();
+  return (bRet && bSubmit) ? Submit() : bRet;
+#else
+  (void)sockId;
+  (void)msg;
+  (void)userData;
+  (void)bSubmit;
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   GetRecvBuffer
+//   Description:
+///   \brief The provided buffer a receive completion filled
+//   Parameters:
+///   @param const UringEvent &ev
+//   Return:
+///   @return const char * - 0 if it used none
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+const char *UringPoller::GetRecvBuffer(const UringEvent &ev) {
+#ifdef URINGRECVMULTI
+  if (!(ev.flags & IORING_CQE_F_BUFFER) || !HasRecvBuffers())
+    return 0;
+  unsigned bufId = ev.flags >> IORING_CQE_BUFFER_SHIFT;
+  return (bufId < m_BufCount) ? m_Bufs + (size_t)bufId * m_BufSize : 0;
+#else
+  (void)ev;
+  return 0;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ReturnRecvBuffer
+//   Description:
+///   \brief Give a receive completion's buffer back to the kernel
+//   Parameters:
+///   @param const UringEvent &ev
+//   Return:
+//   Notes:
+///   Must be done for every completion that used one, stale or not, or the
+///   ring runs dry. The tail is published after the entry.
+//----------------------------------------------------------------------------
+///
+
+void UringPoller::ReturnRecvBuffer(const UringEvent &ev) {
+#ifdef URINGRECVMULTI
+  if (!(ev.flags & IORING_CQE_F_BUFFER) || !HasRecvBuffers())
+    return;
+  unsigned bufId = ev.flags >> IORING_CQE_BUFFER_SHIFT;
+  if (bufId >= m_BufCount)
+    return;
+
+  m_BufMutex.Lock();
+  struct io_uring_buf_ring *ring = (struct io_uring_buf_ring *)m_BufRing;
+  struct io_uring_buf *buf =
+      &((struct io_uring_buf *)m_BufRing)[m_BufTail & (m_BufCount - 1)];
+  buf->addr =
+      (unsigned long long)(uintptr_t)(m_Bufs + (size_t)bufId * m_BufSize);
+  buf->len = m_BufSize;
+  buf->bid = (unsigned short)bufId;
+  m_BufTail++;
+  __atomic_store_n(&ring->tail, m_BufTail, __ATOMIC_RELEASE);
+  m_BufMutex.Unlock();
+#else
+  (void)ev;
+#endif
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Submit
+//   Description:
+///   \brief Hand everything queued so far to the kernel
+//   Parameters:
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::Submit(void) {
+#ifdef __linux__
+  m_SqMutex.Lock();
+  unsigned toSubmit = m_SqPending;
+  m_SqPending = 0;
+  if (toSubmit > 0)
+    m_Enters++;
+  m_SqMutex.Unlock();
+
+  if (toSubmit == 0)
+    return true;
+
+  if (Enter(toSubmit, 0, 0, -1) < 0 && errno != EINTR) {
+    m_SqMutex.Lock();
+    m_SqPending += toSubmit;
+    m_SqMutex.Unlock();
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Wait
+//   Description:
+///   \brief Submit anything queued and wait for completions
+//   Parameters:
+///   @param UringEvent *events - filled in
+///   @param int maxEvents
+///   @param int waitMs - longest time to wait, -1 for ever
+//   Return:
+///   @return int - completions returned, -1 on error
+//   Notes:
+///   Submitting and waiting is a single system call. Several threads may
+///   wait at once, each completion goes to exactly one of them.
+//----------------------------------------------------------------------------
+///
+
+int UringPoller::Wait(UringEvent *events, int maxEvents, int waitMs) {
+#ifdef __linux__
+  if (!IsOpen())
+    return -1;
+
+  m_SqMutex.Lock();
+  unsigned toSubmit = m_SqPending;
+  m_SqPending = 0;
+  m_Enters++;
+  m_SqMutex.Unlock();
+
+  if (Enter(toSubmit, 1, IORING_ENTER_GETEVENTS, waitMs) < 0) {
+    int errCode = errno;
+    if (toSubmit > 0) {
+      m_SqMutex.Lock();
+      m_SqPending += toSubmit;
+      m_SqMutex.Unlock();
+    }
+    if (errCode != ETIME && errCode != EINTR && errCode != EBUSY &&
+        errCode != EAGAIN)
+      return -1;
+  }
+  return Reap(events, maxEvents);
+#else
+  (void)events;
+  (void)maxEvents;
+  (void)waitMs;
+  return -1;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Peek
+//   Description:
+///   \brief Take any completions already posted, without waiting
+//   Parameters:
+///   @param UringEvent *events - filled in
+///   @param int maxEvents
+//   Return:
+///   @return int - completions returned, -1 on error
+//   Notes:
+///   Reads the shared ring directly, so costs no system call unless poll
+///   requests are queued. Used to busy poll.
+//----------------------------------------------------------------------------
+///
+
+int UringPoller::Peek(UringEvent *events, int maxEvents) {
+#ifdef __linux__
+  if (!IsOpen() || !Submit())
+    return -1;
+  return Reap(events, maxEvents);
+#else
+  (void)events;
+  (void)maxEvents;
+  return -1;
+#endif
+}
+
+#ifdef __linux__
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Queue
+//   Description:
+///   \brief Copy a request into the submission ring
+//   Parameters:
+///   @param const struct io_uring_sqe &sqe
+//   Return:
+///   @return bool
+//   Notes:
+///   Must be called with m_SqMutex held. A full ring is flushed first.
+///   The tail is published after the entry, the kernel may be reading
+///   the ring from another thread's submit.
+//----------------------------------------------------------------------------
+///
+
+bool UringPoller::Queue(const struct io_uring_sqe &sqe) {
+  unsigned tail = *m_SqTail;
+  if (tail - __atomic_load_n(m_SqHead, __ATOMIC_ACQUIRE) >= m_SqEntries) {
+    unsigned toSubmit = m_SqPending;
+    m_SqPending = 0;
+    m_Enters++;
+    if (Enter(toSubmit, 0, 0, -1) < 0)
+      m_SqPending = toSubmit;
+    if (tail - __atomic_load_n(m_SqHead, __ATOMIC_ACQUIRE) >= m_SqEntries)
+      return false;
+  }
+
+  unsigned index = tail & *m_SqMask;
+  memcpy(&((struct io_uring_sqe *)m_Sqes)[index], &sqe, sizeof(sqe));
+  m_SqArray[index] = index;
+  __atomic_store_n(m_SqTail, tail + 1, __ATOMIC_RELEASE);
+  m_SqPending++;
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Enter
+//   Description:
+///   \brief io_uring_enter with an optional timeout
+//   Parameters:
+///   @param unsigned toSubmit
+///   @param unsigned minComplete
+///   @param unsigned flags
+///   @param int waitMs - -1 for no timeout
+//   Return:
+///   @return int - as the system call, errno set on failure
+//   Notes:
+///   Asking for more submissions than are queued is harmless, the kernel
+///   takes what is there. Racing submitters rely on this.
+//----------------------------------------------------------------------------
+///
+
+int UringPoller::Enter(unsigned toSubmit, unsigned minComplete,
+                       unsigned flags, int waitMs) {
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+
+  memset(&arg, 0, sizeof(arg));
+  if ((flags & IORING_ENTER_GETEVENTS) && waitMs >= 0) {
+    ts.tv_sec = waitMs / 1000;
+    ts.tv_nsec = (long long)(waitMs % 1000) * 1000000;
+    arg.ts = (unsigned long long)(uintptr_t)&ts;
+  }
+  return (int)syscall(__NR_io_uring_enter, m_RingId, toSubmit, minComplete,
+                      flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Reap
+//   Description:
+///   \brief Take completions off the ring
+//   Parameters:
+///   @param UringEvent *events
+///   @param int maxEvents
+//   Return:
+///   @return int - completions returned
+//   Notes:
+///   Poll removal and cancel completions are consumed here and never
+///   returned
+//----------------------------------------------------------------------------
+///
+
+int UringPoller::Reap(UringEvent *events, int maxEvents) {
+  int count = 0;
+
+  m_CqMutex.Lock();
+  unsigned head = *m_CqHead;
+  unsigned tail = __atomic_load_n(m_CqTail, __ATOMIC_ACQUIRE);
+  while (head != tail && count < maxEvents) {
+    struct io_uring_cqe *cqe =
+        &((struct io_uring_cqe *)m_Cqes)[head & *m_CqMask];
+    head++;
+    if (cqe->user_data == URINGIGNORE)
+      continue;
+    events[count].userData = cqe->user_data;
+    events[count].result = cqe->res;
+    events[count].flags = cqe->flags;
+    count++;
+  }
+  __atomic_store_n(m_CqHead, head, __ATOMIC_RELEASE);
+  m_CqMutex.Unlock();
+  return count;
+}
+#endif
@@ -0,0 +1,132 @@
+///
+///   UringPoller.h
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2008 __MyCompanyName__. All rights reserved.
+///
+/// @file
+
+#ifndef __uringpoller_h_
+#define __uringpoller_h_
+
+#include "Mutex.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+/// Submission queue size, the completion queue is twice this
+#define URINGENTRIES 256
+
+/// user_data for requests whose completions nobody wants (poll removals)
+#define URINGIGNORE (~0ULL)
+
+/// Provided receive buffers - how many (a power of 2), the size of each
+/// and the group they are registered as
+#define URINGRECVBUFS 256
+#define URINGRECVBUFSZ 4096
+#define URINGRECVGROUP 0
+
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+/// Multishot receive into provided buffers (5.19 headers, 6.0 kernel)
+#define URINGRECVMULTI 1
+#endif
+
+///
+/// One completion handed back by Wait
+///
+struct UringEvent {
+  unsigned long long userData;
+  int result;
+  unsigned flags; /// IORING_CQE_F_*, e.g. the provided buffer used
+};
+
+///
+/// Minimal io_uring poller, driven with the raw system calls. Requests
+/// are only queued when made, and go to the kernel in one batch with the
+/// next wait, so re-arming a connection costs no system call of its own.
+/// Any number of threads may queue and wait at once.
+///
+/// Besides readiness polls it can receive and send for a connection.
+/// Receives are multishot into a ring of provided buffers shared by all
+/// connections, each buffer is handed back once its data is copied out.
+///
+class UringPoller {
+
+public:
+  ///
+  /// Public interface
+  ///
+  UringPoller();
+  ~UringPoller();
+
+  inline bool const IsOpen() { return (m_RingId != -1); }
+
+  bool Open(unsigned entries = URINGENTRIES);
+  void Close(void);
+
+  bool PollAdd(int, unsigned, unsigned long long, bool bSubmit = false);
+  bool PollRemove(unsigned long long, bool bSubmit = false);
+  bool Cancel(unsigned long long, bool bSubmit = false);
+  bool Submit(void);
+  int Wait(UringEvent *, int, int);
+  int Peek(UringEvent *, int);
+
+  /// Receiving and sending for a connection
+  bool OpenRecvBuffers(unsigned count = URINGRECVBUFS,
+                       unsigned size = URINGRECVBUFSZ);
+  inline bool const HasRecvBuffers() { return (m_BufRing != 0); }
+  bool RecvMulti(int, unsigned long long, bool bSubmit = false);
+  bool SendMsg(int, struct msghdr *, unsigned long long, bool bSubmit = false);
+  const char *GetRecvBuffer(const UringEvent &);
+  void ReturnRecvBuffer(const UringEvent &);
+
+  inline unsigned long GetEnters() { return m_Enters; }
+
+private:
+#ifdef __linux__
+  bool Queue(const struct io_uring_sqe &);
+  int Enter(unsigned, unsigned, unsigned, int);
+  int Reap(UringEvent *, int);
+#endif
+
+  int m_RingId;
+
+  /// Ring mappings
+  void *m_SqRing;
+  void *m_CqRing;
+  void *m_Sqes;
+  size_t m_SqRingSz;
+  size_t m_CqRingSz;
+  size_t m_SqesSz;
+
+  /// Pointers into the shared rings
+  unsigned *m_SqHead;
+  unsigned *m_SqTail;
+  unsigned *m_SqMask;
+  unsigned *m_SqArray;
+  unsigned m_SqEntries;
+  unsigned *m_CqHead;
+  unsigned *m_CqTail;
+  unsigned *m_CqMask;
+  void *m_Cqes;
+
+  /// Queued but not yet handed to the kernel, guarded by m_SqMutex
+  unsigned m_SqPending;
+
+  /// Provided buffer ring and the buffers behind it, one mapping. The
+  /// tail is ours, guarded by m_BufMutex.
+  void *m_BufRing;
+  size_t m_BufRingSz;
+  char *m_Bufs;
+  unsigned m_BufCount;
+  unsigned m_BufSize;
+  unsigned short m_BufTail;
+
+  Mutex m_SqMutex;
+  Mutex m_CqMutex;
+  Mutex m_BufMutex;
+  unsigned long m_Enters;
+};
+
+#endif
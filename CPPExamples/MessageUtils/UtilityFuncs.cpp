@@ -6,6 +6,8 @@
 ///
 /// @file
 
+#include <algorithm>
+#include <cerrno>
 #include <fstream>
 #include <iostream>
 #include <stdarg.h>
@@ -26,7 +28,8 @@
 #include <io.h>
 #include <process.h>
 #include <time.h>
-#include <winsock.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #endif
 
 #include "UtilityFuncs.h"
@@ -625,6 +628,7 @@ bool runCommand(const std::string &cmdLine, std::string &result) {
 
 /// \namespace NetUtils
 /// Addition network functions
+#include "DnsCache.h"
 #include "NetworkOps.h"
 
 namespace NetUtils {
@@ -694,38 +698,14 @@ std::string &GetIpAddr(std::string &hostName, std::string &addr) {
     hostName = lhostName;
   }
 
-  struct hostent *host = 0;
-  struct sockaddr_in sin = {0};
+  std::vector<DnsAddr> addrs;
+  char ciddr[NI_MAXHOST + 1];
 
-  if ((host = gethostbyname(hostName.c_str())) == (struct hostent *)0) {
-    /// Can't find a hostname, so assume it is an inetaddr...
-#ifndef _WIN32
-    struct in_addr iAddr = {0};
-    inet_aton(hostName.c_str(), &iAddr);
-#else
-    unsigned int iAddr = 0;
-    iAddr = inet_addr(hostName.c_str());
-#endif
-
-    if ((host = gethostbyaddr((const char *)&iAddr, sizeof(iAddr), AF_INET)) ==
-        (struct hostent *)0) {
-      addr = "";
-      return addr;
-    }
-  }
-
-  sin.sin_family = host->h_addrtype;
-  memcpy((char *)&(sin.sin_addr), host->h_addr, host->h_length);
-
-#ifndef _WIN32
-  char ciddr[128];
-  if (inet_ntop(sin.sin_family, &sin.sin_addr, ciddr, sizeof(ciddr)) == NULL)
-    addr = "";
-  else
+  addr = "";
+  if (DnsCache::Lookup(hostName, "", addrs) == 0 &&
+      getnameinfo((struct sockaddr *)&addrs[0].addr, addrs[0].len, ciddr,
+                  sizeof(ciddr), 0, 0, NI_NUMERICHOST) == 0)
     addr = ciddr;
-#else
-  addr = inet_ntoa(sin.sin_addr);
-#endif
 
   return addr;
 }
@@ -864,30 +844,111 @@ void MSNParseChatLine(std::string &ptrMessage, std::string &reply,
 //   Parameters:
 ///   @param std::string &message
 //   Return:
-///	  @return int
+///	  @return int - header line and payload length, -1 if there is none
+///   or it is over MSNMAXFRAME
 //   Notes:
 //----------------------------------------------------------------------------
 ///
 
 int MSNGetPayload(std::string &message) {
-  if (message.empty())
+  size_t eol = message.find('\n');
+  if (eol == std::string::npos)
+    return -1;
+
+  ///   The payload length is the last token on the header line
+  std::string header = StrUtils::SubStr(message, 0, eol);
+  StrUtils::Trim(header);
+  size_t pos = header.find_last_of(' ');
+  if (pos == std::string::npos)
+    return -1;
+
+  char *stop = 0;
+  errno = 0;
+  long payLoad = strtol(header.c_str() + pos + 1, &stop, 10);
+  if (*stop != '\0' || payLoad < 0 || errno == ERANGE ||
+      payLoad > MSNMAXFRAME - (long)(eol + 1))
+    return -1;
+
+  ///   The payload follows the whole line, whatever ends it
+  return (int)(eol + 1 + payLoad);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   MSNFrameLen
+//   Description:
+///   \brief Frame the MSN stream - a command line, or a MSG plus payload
+//   Parameters:
+///   @param const char *buffer - buffered data
+///   @param int len - bytes held
+//   Return:
+///	  @return int - length of the first complete frame, 0 if incomplete,
+///   -1 if the frame is larger than MSNMAXFRAME or the line than
+///   MSNMAXLINE
+//   Notes:
+///   Matches the FRAMELENFUNCPTR signature used by NetworkOps::GetFrames.
+///   The length is the peer's, so it is range checked before it is used.
+//----------------------------------------------------------------------------
+///
+
+int MSNFrameLen(const char *buffer, int len) {
+  const char *eol =
+      (const char *)memchr(buffer, '\n', std::min(len, MSNMAXLINE));
+  if (eol == 0)
+    return (len >= MSNMAXLINE) ? -1 : 0;
+
+  int lineLen = (int)(eol - buffer) + 1;
+  if (len < 4 || strncmp(buffer, "MSG ", 4) != 0)
+    return lineLen;
+
+  ///   As MSNGetPayload, but read in place as this runs for every frame
+  const char *end = eol;
+  while (end > buffer && (end[-1] == '\r' || end[-1] == ' '))
+    end--;
+  const char *token = end;
+  while (token > buffer && token[-1] != ' ')
+    token--;
+  if (token == buffer || token == end || *token < '0' || *token > '9')
+    return lineLen;
+
+  ///   The payload follows the whole line, whatever ends it
+  char *stop = 0;
+  errno = 0;
+  long payLoad = strtol(token, &stop, 10);
+  if (stop != end)
+    return lineLen;
+  if (errno == ERANGE || payLoad > MSNMAXFRAME - lineLen)
     return -1;
 
-  char tmpCmd[10];
-  char tmpUsr[100];
-  char tmpAlias[100];
-  int payLoad;
-  const char *tmpStr = NULL;
-
-  ///   Look for the '\r' and clobber it to give me a useable std::string
-  tmpStr = message.c_str();
-  char *tmpa = (char *)strchr(tmpStr, '\r');
-  if (tmpa)
-    *tmpa = '\0';
-
-  (void)sscanf(tmpStr, "%s %s %s %d", tmpCmd, tmpUsr, tmpAlias, &payLoad);
-  payLoad = payLoad + strlen(tmpStr) + 2;
-  return payLoad;
+  int frameLen = lineLen + (int)payLoad;
+  return (frameLen <= len) ? frameLen : 0;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   MSNFTPHeader
+//   Description:
+///   \brief Build the header for one MSNFTP data packet
+//   Parameters:
+///   @param char *header - at least 3 bytes
+///   @param int packetsz - data bytes that follow
+//   Return:
+///	  @return int - header length
+//   Notes:
+///   Matches the FILEHDRFUNCPTR signature used by NetworkOps::SendFile.
+///   Byte 0 is 0, then the size low byte first.
+//----------------------------------------------------------------------------
+///
+
+int MSNFTPHeader(char *header, int packetsz) {
+  header[0] = (char)0x00;
+  header[1] = (char)(packetsz & 0x00FF);
+  header[2] = (char)((packetsz & 0xff00) >> 8);
+  return 3;
 }
 
 ///
@@ -35,6 +35,10 @@ extern bool TestTagFile(void);
 #define CLIENTAPP "MSNMESSAPP"
 #define CLIENTAPPVRS "1.0"
 
+/// Largest MSN frame (command line and payload) and command line accepted
+#define MSNMAXFRAME (1024 * 1024)
+#define MSNMAXLINE 8192
+
 namespace ArgUtils {
 extern void freeArgs(int, char **);
 extern void tokenCmd(int *, char ***, const std::string *);
@@ -72,6 +76,8 @@ namespace MsnUtils {
 extern void MSNParseChatLine(std::string &, std::string &,
                              bool peekOnly = false, bool bTrim = true);
 extern int MSNGetPayload(std::string &);
+extern int MSNFrameLen(const char *, int);
+extern int MSNFTPHeader(char *, int);
 extern int MSNGetCookieId(const std::string *);
 } // namespace MsnUtils
 
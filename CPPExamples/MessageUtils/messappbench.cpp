@@ -0,0 +1,1688 @@
+///
+///   messappbench.cpp
+///   MessengerUtils
+///   Created by Tim Payne on 16/10/2026.
+///   Copyright 2026 __MyCompanyName__. All rights reserved.
+///
+/// @file
+///
+/// Loopback benchmarks for the network classes. Each one runs its own
+/// peer in process, so "MessengerBench <name>" is all it takes to get
+/// figures that can be compared against an earlier build.
+///
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#endif
+
+/// Local includes
+#include "EventLoop.h"
+#include "Listener.h"
+#include "MsnChatSessions.h"
+#include "NetworkOps.h"
+#include "NetworkOpsSSL.h"
+#include "UtilityFuncs.h"
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+///
+/// Allocation counting - with glibc, malloc, calloc and realloc are
+/// interposed and counted on any thread that turns counting on. new
+/// goes through malloc, so it is counted too.
+///
+#ifdef __GLIBC__
+#define BENCHALLOCS 1
+
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+
+static thread_local bool benchCounting = false;
+static thread_local unsigned long benchAllocs = 0;
+
+extern "C" void *malloc(size_t len) {
+  if (benchCounting)
+    benchAllocs++;
+  return __libc_malloc(len);
+}
+
+extern "C" void *calloc(size_t num, size_t len) {
+  if (benchCounting)
+    benchAllocs++;
+  return __libc_calloc(num, len);
+}
+
+extern "C" void *realloc(void *ptr, size_t len) {
+  if (benchCounting)
+    benchAllocs++;
+  return __libc_realloc(ptr, len);
+}
+#endif
+
+///
+/// System call counting - on glibc Linux the calls the network classes
+/// do their I/O and polling with are interposed and counted process wide.
+/// syscall() covers io_uring, whose calls go through it.
+///
+#if defined(__GLIBC__) && defined(__linux__)
+#define BENCHCALLS 1
+
+static std::atomic<unsigned long> benchCalls(0);
+
+#define BENCHCALL(ret, name, params, args, spec)                              \
+  extern "C" ret name params spec {                                           \
+    static ret(*real) params = 0;                                             \
+    if (real == 0)                                                            \
+      real = (ret(*) params)dlsym(RTLD_NEXT, #name);                          \
+    benchCalls++;                                                             \
+    return real args;                                                         \
+  }
+
+BENCHCALL(ssize_t, read, (int fd, void *buf, size_t len), (fd, buf, len), )
+BENCHCALL(ssize_t, write, (int fd, const void *buf, size_t len),
+          (fd, buf, len), )
+BENCHCALL(ssize_t, readv, (int fd, const struct iovec *vec, int count),
+          (fd, vec, count), )
+BENCHCALL(ssize_t, writev, (int fd, const struct iovec *vec, int count),
+          (fd, vec, count), )
+BENCHCALL(ssize_t, recv, (int fd, void *buf, size_t len, int flags),
+          (fd, buf, len, flags), )
+BENCHCALL(ssize_t, send, (int fd, const void *buf, size_t len, int flags),
+          (fd, buf, len, flags), )
+BENCHCALL(ssize_t, recvmsg, (int fd, struct msghdr *msg, int flags),
+          (fd, msg, flags), )
+BENCHCALL(ssize_t, sendmsg, (int fd, const struct msghdr *msg, int flags),
+          (fd, msg, flags), )
+BENCHCALL(int, poll, (struct pollfd * fds, nfds_t count, int millisecs),
+          (fds, count, millisecs), )
+BENCHCALL(int, epoll_wait,
+          (int fd, struct epoll_event *evs, int count, int millisecs),
+          (fd, evs, count, millisecs), )
+BENCHCALL(int, epoll_ctl, (int fd, int op, int sockId, struct epoll_event *ev),
+          (fd, op, sockId, ev), noexcept)
+
+extern "C" long syscall(long sysno, ...) noexcept {
+  static long (*real)(long, ...) = 0;
+  if (real == 0)
+    real = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+
+  ///   Six is as many arguments as any system call takes
+  long arg[6];
+  va_list ap;
+  va_start(ap, sysno);
+  for (int i = 0; i < 6; i++)
+    arg[i] = va_arg(ap, long);
+  va_end(ap);
+
+  benchCalls++;
+  return real(sysno, arg[0], arg[1], arg[2], arg[3], arg[4], arg[5]);
+}
+#endif
+
+namespace {
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   CountAllocs
+//   Description:
+///   \brief Start or stop counting this thread's allocations
+//   Parameters:
+///   @param bool bOn - true to reset the count and start
+//   Return:
+///   @return long - allocations since counting started, -1 if they can't
+///   be counted
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+long CountAllocs(bool bOn) {
+#ifdef BENCHALLOCS
+  if (bOn)
+    benchAllocs = 0;
+  benchCounting = bOn;
+  return (long)benchAllocs;
+#else
+  (void)bOn;
+  return -1;
+#endif
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ListenLoopback
+//   Description:
+///   \brief Listen on an ephemeral 127.0.0.1 port
+//   Parameters:
+///   @param int *port - set to the port chosen
+//   Return:
+///   @return int - listening socket, -1 on failure
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int ListenLoopback(int *port) {
+  int sockId = socket(AF_INET, SOCK_STREAM, 0);
+  if (sockId < 0)
+    return -1;
+
+  int one = 1;
+  (void)setsockopt(sockId, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (bind(sockId, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(sockId, 128) < 0 ||
+      getsockname(sockId, (struct sockaddr *)&addr, &len) < 0) {
+    (void)close(sockId);
+    return -1;
+  }
+
+  *port = ntohs(addr.sin_port);
+  return sockId;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   CountCalls
+//   Description:
+///   \brief System calls the process has made so far
+//   Parameters:
+//   Return:
+///   @return long - calls, -1 if they can't be counted
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+long CountCalls(void) {
+#ifdef BENCHCALLS
+  return (long)benchCalls.load();
+#else
+  return -1;
+#endif
+}
+
+///
+/// Seconds since a start point
+///
+inline double SecsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+///
+/// A thread per connection echo server on an ephemeral loopback port,
+/// optionally holding each reply back to play a slow peer
+///
+class EchoServer {
+public:
+  EchoServer() : m_SockId(-1), m_Port(0), m_DelayUs(0) {}
+  ~EchoServer() { Stop(); }
+
+  bool Start(int delayUs = 0);
+  void Stop(void);
+  inline int GetPort(void) { return m_Port; }
+  std::string GetService(void) { return std::to_string(m_Port); }
+
+private:
+  void AcceptLoop(void);
+  void Echo(int);
+
+  int m_SockId;
+  int m_Port;
+  int m_DelayUs;
+  std::thread m_Accept;
+  std::vector<std::thread> m_Conns;
+};
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   EchoServer::Start
+//   Description:
+///   \brief Listen on 127.0.0.1 and start accepting
+//   Parameters:
+///   @param int delayUs - how long to hold each reply back
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool EchoServer::Start(int delayUs) {
+  m_DelayUs = delayUs;
+  m_SockId = ListenLoopback(&m_Port);
+  if (m_SockId < 0)
+    return false;
+
+  m_Accept = std::thread(&EchoServer::AcceptLoop, this);
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   EchoServer::Stop
+//   Description:
+///   \brief Stop accepting and wait for the connections to finish
+//   Parameters:
+//   Return:
+//   Notes:
+///   The clients must have disconnected, a connection only ends when its
+///   peer does
+//----------------------------------------------------------------------------
+///
+
+void EchoServer::Stop(void) {
+  if (m_SockId == -1)
+    return;
+
+  (void)shutdown(m_SockId, SHUT_RDWR);
+  m_Accept.join();
+  (void)close(m_SockId);
+  m_SockId = -1;
+
+  for (size_t i = 0; i < m_Conns.size(); i++)
+    m_Conns[i].join();
+  m_Conns.clear();
+  return;
+}
+
+void EchoServer::AcceptLoop(void) {
+  for (;;) {
+    int sockId = accept(m_SockId, 0, 0);
+    if (sockId < 0)
+      break;
+    m_Conns.push_back(std::thread(&EchoServer::Echo, this, sockId));
+  }
+  return;
+}
+
+void EchoServer::Echo(int sockId) {
+  char buf[16384];
+  for (;;) {
+    ssize_t len = recv(sockId, buf, sizeof(buf), 0);
+    if (len <= 0)
+      break;
+    if (m_DelayUs > 0)
+      usleep(m_DelayUs);
+    if (send(sockId, buf, len, MSG_NOSIGNAL) != len)
+      break;
+  }
+  (void)close(sockId);
+  return;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunTalkers
+//   Description:
+///   \brief Round trip "ping" on a number of connections at once
+//   Parameters:
+///   @param const std::string &service - echo server port
+///   @param int sessions - connections, each on its own thread
+///   @param int millisecs - how long to run for
+//   Return:
+///   @return double - round trips a second across all of them, -1 if a
+///   connection could not be made
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+double RunTalkers(const std::string &service, int sessions, int millisecs) {
+  std::atomic<long> total(0);
+  std::atomic<int> failed(0);
+  std::atomic<bool> go(false), stop(false);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < sessions; i++) {
+    threads.push_back(std::thread([&]() {
+      std::string host("127.0.0.1"), msg("ping\n"), resp;
+      NetworkOps conn(&host, &service);
+      if (!conn.Connect()) {
+        failed++;
+        return;
+      }
+      while (!go)
+        std::this_thread::yield();
+
+      long count = 0;
+      while (!stop) {
+        resp.clear();
+        if (!conn.Talk(&msg, &resp))
+          break;
+        count++;
+      }
+      total += count;
+      (void)conn.Disconnect();
+    }));
+  }
+
+  usleep(200000);
+  go = true;
+  usleep(millisecs * 1000);
+  stop = true;
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+
+  return (failed > 0) ? -1.0 : total * 1000.0 / millisecs;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchContend
+//   Description:
+///   \brief Connection lock scaling - many sessions talking at once
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [max sessions] [reply delay ms]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   With a lock per connection the total grows with the session count
+///   against a slow peer. A process wide lock held across Talk keeps it
+///   flat at one session's worth.
+//----------------------------------------------------------------------------
+///
+
+int BenchContend(int argc, const char **argv) {
+  int maxSessions = (argc > 0) ? atoi(argv[0]) : 16;
+  int delayMs = (argc > 1) ? atoi(argv[1]) : 2;
+
+  EchoServer server;
+  if (!server.Start(delayMs * 1000)) {
+    printf("Unable to start the echo server\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("Talk round trips, reply delay %dms\n", delayMs);
+  printf("  sessions  round trips/s\n");
+  for (int sessions = 1; sessions <= maxSessions; sessions *= 2) {
+    double rate = RunTalkers(server.GetService(), sessions, 3000);
+    if (rate < 0) {
+      printf("Unable to connect to the echo server\n");
+      return EXIT_FAILURE;
+    }
+    printf("  %8d  %13.0f\n", sessions, rate);
+  }
+
+  server.Stop();
+  return EXIT_SUCCESS;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunReceive
+//   Description:
+///   \brief Read a stream with GetBinMsg, counting the allocations
+//   Parameters:
+///   @param long long total - bytes the peer sends
+///   @param int sendSz - bytes the peer sends at a time
+//   Return:
+///   @return bool
+//   Notes:
+///   The peer is a thread sending from one buffer, so it makes no
+///   allocations of its own
+//----------------------------------------------------------------------------
+///
+
+bool RunReceive(long long total, int sendSz) {
+  int port = 0;
+  int listenId = ListenLoopback(&port);
+  if (listenId < 0)
+    return false;
+
+  std::thread peer([listenId, total, sendSz]() {
+    int sockId = accept(listenId, 0, 0);
+    if (sockId < 0)
+      return;
+    std::vector<char> buf(sendSz, 'x');
+    for (long long sent = 0; sent < total;) {
+      size_t len = (size_t)std::min<long long>(sendSz, total - sent);
+      ssize_t num = send(sockId, &buf[0], len, MSG_NOSIGNAL);
+      if (num <= 0)
+        break;
+      sent += num;
+    }
+    (void)close(sockId);
+  });
+
+  std::string host("127.0.0.1"), service(std::to_string(port));
+  NetworkOps conn(&host, &service);
+  bool bOk = conn.Connect();
+  if (bOk) {
+    conn.SetBlock(true);
+    std::string msg;
+    msg.reserve(1 << 20);
+    long reads = 0;
+    long long bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    CountAllocs(true);
+    for (;;) {
+      int num = 0;
+      if (!conn.GetBinMsg(&num, msg) || num <= 0 || msg.empty())
+        break;
+      reads++;
+      bytes += msg.size();
+    }
+    long allocs = CountAllocs(false);
+    double secs = SecsSince(start);
+
+    printf("  %6.0f MB/s  %7ld reads  %8.0f B/read", bytes / secs / 1e6,
+           reads, (reads > 0) ? (double)bytes / reads : 0.0);
+    if (allocs >= 0)
+      printf("  %.2f allocs/read", (reads > 0) ? (double)allocs / reads : 0.0);
+    printf("%s\n", (bytes == total) ? "" : "  (short)");
+    (void)conn.Disconnect();
+  }
+
+  peer.join();
+  (void)close(listenId);
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchRecv
+//   Description:
+///   \brief Receive path - throughput and allocations per read
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [message bytes] [count]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   With no arguments runs small and large messages sent one at a time,
+///   then a 256 MB stream. The read path itself should allocate nothing
+///   once the ring has grown, so allocs/read staying near 0 is the check.
+//----------------------------------------------------------------------------
+///
+
+int BenchRecv(int argc, const char **argv) {
+  bool bOk = true;
+
+  if (argc > 0) {
+    int size = atoi(argv[0]);
+    long long count = (argc > 1) ? atoll(argv[1]) : 10000;
+    printf("%d B messages, one per send (%lld):\n", size, count);
+    bOk = RunReceive(size * count, size);
+  } else {
+    printf("400 B messages, one per send (20000):\n");
+    bOk = RunReceive(400LL * 20000, 400);
+    printf("16 KB messages, one per send (5000):\n");
+    bOk = bOk && RunReceive(16384LL * 5000, 16384);
+    printf("256 MB bulk, 64 KB sends:\n");
+    bOk = bOk && RunReceive(256LL << 20, 65536);
+  }
+
+  if (!bOk)
+    printf("Unable to connect to the sender\n");
+  return (bOk) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   StartSink
+//   Description:
+///   \brief Accept one connection and read it until EOF
+//   Parameters:
+///   @param int listenId - listening socket
+///   @param long long *received - set to the bytes read once done
+//   Return:
+///   @return std::thread - join it for the count
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+std::thread StartSink(int listenId, long long *received) {
+  return std::thread([listenId, received]() {
+    *received = 0;
+    int sockId = accept(listenId, 0, 0);
+    if (sockId < 0)
+      return;
+    std::vector<char> buf(1 << 20);
+    ssize_t num;
+    while ((num = recv(sockId, &buf[0], buf.size(), 0)) > 0)
+      *received += num;
+    (void)close(sockId);
+  });
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   MakeFile
+//   Description:
+///   \brief Create an unlinked temporary file to send
+//   Parameters:
+///   @param long long length - bytes to fill it with
+//   Return:
+///   @return int - the open file, -1 on failure
+//   Notes:
+///   The file is read back once, so sends come from a warm cache
+//----------------------------------------------------------------------------
+///
+
+int MakeFile(long long length) {
+  char path[] = "/tmp/MessengerBenchXXXXXX";
+  int fileNo = mkstemp(path);
+  if (fileNo < 0)
+    return -1;
+  (void)unlink(path);
+
+  std::vector<char> block(FILEBLOCK, 'f');
+  for (long long done = 0; done < length; done += block.size()) {
+    size_t len = (size_t)std::min<long long>(block.size(), length - done);
+    if (write(fileNo, &block[0], len) != (ssize_t)len) {
+      (void)close(fileNo);
+      return -1;
+    }
+  }
+  for (long long done = 0; done < length; done += block.size())
+    if (pread(fileNo, &block[0], block.size(), done) <= 0)
+      break;
+  return fileNo;
+}
+
+///
+/// Ways of sending a file in BenchSendFile
+///
+enum SendFileWay { SENDBYPACKET, SENDHEADED, SENDPLAIN };
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunSendFile
+//   Description:
+///   \brief Send a file to a sink one way and report the rate
+//   Parameters:
+///   @param int fileNo - the file
+///   @param long long length - its size
+///   @param int packetsz - file bytes per MSNFTP packet
+///   @param SendFileWay way - how to send it
+///   @param const char *label - what to call it
+//   Return:
+///   @return bool
+//   Notes:
+///   SENDBYPACKET is the loop MSNFTP used before SendFile, a read and a
+///   SendBinMsg for every packet
+//----------------------------------------------------------------------------
+///
+
+bool RunSendFile(int fileNo, long long length, int packetsz, SendFileWay way,
+                 const char *label) {
+  int port = 0;
+  int listenId = ListenLoopback(&port);
+  if (listenId < 0)
+    return false;
+
+  long long received = 0;
+  std::thread sink = StartSink(listenId, &received);
+
+  std::string host("127.0.0.1"), service(std::to_string(port));
+  NetworkOps conn(&host, &service);
+  conn.SetProfile(SocketProfile::Bulk());
+  bool bOk = conn.Connect();
+  long long sent = -1;
+  double secs = 0;
+
+  if (bOk) {
+    auto start = std::chrono::steady_clock::now();
+    if (way == SENDBYPACKET) {
+      std::vector<char> packet(packetsz + 3);
+      for (sent = 0; sent < length;) {
+        int len = (int)std::min<long long>(packetsz, length - sent);
+        int hdrLen = MsnUtils::MSNFTPHeader(&packet[0], len);
+        if (pread(fileNo, &packet[hdrLen], len, sent) != len ||
+            !conn.SendBinMsg(&packet[0], hdrLen + len))
+          break;
+        sent += len;
+      }
+    } else if (way == SENDHEADED)
+      sent = conn.SendFile(fileNo, 0, length, packetsz, MsnUtils::MSNFTPHeader);
+    else
+      sent = conn.SendFile(fileNo, 0, length);
+    (void)conn.Disconnect();
+    secs = SecsSince(start);
+  }
+
+  sink.join();
+  (void)close(listenId);
+
+  ///   Every packet but a plain send carries a 3 byte MSNFTP header
+  long long expect = length;
+  if (way != SENDPLAIN)
+    expect += 3 * ((length + packetsz - 1) / packetsz);
+
+  if (bOk)
+    printf("  %-26s %6.0f MB/s%s\n", label, length / secs / 1e6,
+           (sent == length && received == expect) ? "" : "  (short)");
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchSendFile
+//   Description:
+///   \brief MSNFTP file sending - the old packet loop against SendFile
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [megabytes] [packet bytes]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   The file is read once first so every run sends from a warm cache.
+///   Small headed packets take SendFile's copy path and packets of
+///   FILEBLOCK or more take sendfile, as does unheaded data.
+//----------------------------------------------------------------------------
+///
+
+int BenchSendFile(int argc, const char **argv) {
+  long long length = ((argc > 0) ? atoll(argv[0]) : 300) << 20;
+  int packetsz = (argc > 1) ? atoi(argv[1]) : 2045;
+
+  int fileNo = MakeFile(length);
+  if (fileNo < 0) {
+    printf("Unable to create a file to send\n");
+    return EXIT_FAILURE;
+  }
+
+  std::string headed("SendFile, " + std::to_string(packetsz) + " B packets");
+  std::string big("SendFile, " + std::to_string(FILEBLOCK) + " B packets");
+
+  printf("%lld MB file over loopback:\n", length >> 20);
+  bool bOk = RunSendFile(fileNo, length, packetsz, SENDBYPACKET,
+                         "read + SendBinMsg") &&
+             RunSendFile(fileNo, length, packetsz, SENDHEADED,
+                         headed.c_str()) &&
+             RunSendFile(fileNo, length, FILEBLOCK, SENDHEADED, big.c_str()) &&
+             RunSendFile(fileNo, length, 0, SENDPLAIN, "SendFile, unheaded");
+
+  (void)close(fileNo);
+  if (!bOk)
+    printf("Unable to connect to the sink\n");
+  return (bOk) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///
+/// Message framing for BenchUring - a line at a time
+///
+int LineLen(const char *data, int len) {
+  const char *end = (const char *)memchr(data, '\n', len);
+  return (end != 0) ? (int)(end - data + 1) : 0;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   EchoEvent
+//   Description:
+///   \brief Event loop callback echoing each line back
+//   Parameters:
+///   @param NetworkOps *conn
+///   @param int events
+///   @param void *param
+//   Return:
+///   @return bool - false once the peer has gone
+//   Notes:
+///   Reads, queues and flushes the way MsnChatSessions::ChatEvents does
+//----------------------------------------------------------------------------
+///
+
+bool EchoEvent(NetworkOps *conn, int events, void *) {
+  std::vector<std::string> frames;
+  if (events & EVENTREAD) {
+    while (conn->IsConnected() &&
+           conn->GetFrames(LineLen, frames, false) && !frames.empty()) {
+      for (size_t i = 0; i < frames.size(); i++)
+        (void)conn->PostMsg(frames[i]);
+    }
+  }
+
+  if (conn->HasQueuedMsgs() && conn->FlushMsgs() < 0)
+    events |= EVENTHANGUP;
+
+  if ((events & EVENTHANGUP) || !conn->IsConnected() ||
+      conn->IsPeerClosed()) {
+    (void)conn->Disconnect();
+    return false;
+  }
+  return true;
+}
+
+///
+/// Event loop settings for the accepted connections in BenchUring
+///
+struct EchoLoop {
+  EventLoop *loop;
+  int events;
+};
+
+bool EchoAccept(NetworkOps *conn, void *param) {
+  EchoLoop *echo = (EchoLoop *)param;
+  return echo->loop->Add(conn, EchoEvent, 0, echo->events);
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   EchoClients
+//   Description:
+///   \brief Round trip lines on a set of connections, one at a time
+//   Parameters:
+///   @param int port - echo server
+///   @param int conns - connections
+///   @param int count - lines on each
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   Run in a child process, so the parent's counts are the server's
+///   alone. Prints the latency percentiles. Ends with a pipelined burst
+///   to check nothing is lost or reordered.
+//----------------------------------------------------------------------------
+///
+
+int EchoClients(int port, int conns, int count) {
+  std::vector<int> sockIds(conns, -1);
+  for (int i = 0; i < conns; i++) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sockIds[i] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sockIds[i], (struct sockaddr *)&addr, sizeof(addr)) < 0)
+      return EXIT_FAILURE;
+    int one = 1;
+    (void)setsockopt(sockIds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  std::vector<double> lat;
+  lat.reserve((size_t)conns * count);
+  char msg[64], reply[64];
+  for (int n = 0; n < count; n++) {
+    for (int i = 0; i < conns; i++) {
+      int len = snprintf(msg, sizeof(msg), "msg %6d conn %3d padding\n", n, i);
+      auto start = std::chrono::steady_clock::now();
+      if (send(sockIds[i], msg, len, 0) != len)
+        return EXIT_FAILURE;
+      for (int got = 0; got < len;) {
+        ssize_t num = recv(sockIds[i], reply + got, len - got, 0);
+        if (num <= 0)
+          return EXIT_FAILURE;
+        got += num;
+      }
+      if (memcmp(reply, msg, len) != 0)
+        return EXIT_FAILURE;
+      lat.push_back(SecsSince(start) * 1e6);
+    }
+  }
+
+  std::string burst, back;
+  for (int i = 0; i < 2000; i++)
+    burst += "burst line " + std::to_string(i) + "\n";
+  if (send(sockIds[0], burst.data(), burst.size(), 0) != (ssize_t)burst.size())
+    return EXIT_FAILURE;
+  while (back.size() < burst.size()) {
+    char buf[16384];
+    ssize_t num = recv(sockIds[0], buf, sizeof(buf), 0);
+    if (num <= 0)
+      break;
+    back.append(buf, num);
+  }
+
+  for (int i = 0; i < conns; i++)
+    (void)close(sockIds[i]);
+  if (back != burst)
+    return EXIT_FAILURE;
+
+  std::sort(lat.begin(), lat.end());
+  printf("  p50 %5.1fus  p99 %5.1fus", lat[lat.size() / 2],
+         lat[lat.size() * 99 / 100]);
+  fflush(stdout);
+  return EXIT_SUCCESS;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunEcho
+//   Description:
+///   \brief Serve line echo from an event loop and measure it
+//   Parameters:
+///   @param int backend - EVENTBACKENDEPOLL or EVENTBACKENDURING
+///   @param int events - events to add connections with
+///   @param const char *label - what to call it
+///   @param int conns - connections
+///   @param int count - lines on each
+//   Return:
+///   @return bool
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+bool RunEcho(int backend, int events, const char *label, int conns,
+             int count) {
+  EventLoop loop;
+  loop.SetBackend(backend);
+  if (!loop.Start(1))
+    return false;
+
+  int port = 0;
+  int sockId = ListenLoopback(&port);
+  if (sockId < 0)
+    return false;
+  (void)close(sockId);
+
+  EchoLoop echo = {&loop, events};
+  Listener listener;
+  if (!listener.Start(std::to_string(port), EchoAccept, &echo, &loop, 1)) {
+    (void)loop.Stop();
+    return false;
+  }
+
+  unsigned long polls = loop.GetPollerCalls();
+  long calls = CountCalls();
+  printf("  %-22s", label);
+  fflush(stdout);
+
+  pid_t pid = fork();
+  if (pid == 0)
+    _exit(EchoClients(port, conns, count));
+
+  int status = 0;
+  (void)waitpid(pid, &status, 0);
+  usleep(200000);
+
+  double msgs = (double)conns * count;
+  polls = loop.GetPollerCalls() - polls;
+  bool bOk = (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+  if (!bOk)
+    printf("  echo failed");
+  else {
+    printf("  %.2f poller calls/msg", polls / msgs);
+    if (calls >= 0)
+      printf("  %.2f syscalls/msg", (CountCalls() - calls) / msgs);
+    if (loop.GetBackend() != backend)
+      printf("  (fell back to epoll)");
+  }
+  printf("\n");
+
+  (void)listener.Stop();
+  (void)loop.Stop();
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchUring
+//   Description:
+///   \brief Event loop backends - system calls and latency per message
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [connections] [messages each]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   The server runs in this process and the clients in a child, so the
+///   system call counts are the server's alone. They take in everything
+///   the server does for a message: the wait, the reads and the writes.
+//----------------------------------------------------------------------------
+///
+
+int BenchUring(int argc, const char **argv) {
+  int conns = (argc > 0) ? atoi(argv[0]) : 8;
+  int count = (argc > 1) ? atoi(argv[1]) : 5000;
+
+  printf("Line echo, %d connections x %d messages:\n", conns, count);
+  bool bOk =
+      RunEcho(EVENTBACKENDEPOLL, EVENTREAD, "epoll", conns, count) &&
+      RunEcho(EVENTBACKENDURING, EVENTREAD, "io_uring", conns, count) &&
+      RunEcho(EVENTBACKENDURING, EVENTREAD | EVENTLOOPIO,
+              "io_uring, loop I/O", conns, count);
+  return (bOk) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunConnects
+//   Description:
+///   \brief Time short lived connections, switchboard style
+//   Parameters:
+///   @param const std::string &service - server port
+///   @param bool bFastOpen - connect with TCP Fast Open
+///   @param int count - connections to make
+//   Return:
+///   @return bool
+//   Notes:
+///   Each connection connects, sends an ANS and waits for the reply,
+///   then closes. The last one reports whether its SYN carried data.
+//----------------------------------------------------------------------------
+///
+
+bool RunConnects(const std::string &service, bool bFastOpen, int count) {
+  std::vector<double> lat;
+  bool bSynData = false;
+  std::string ans("ANS 1 bob@example.com 1234.5678 1\r\n");
+
+  for (int i = 0; i < count; i++) {
+    NetworkOps conn;
+    conn.SetHostName("127.0.0.1");
+    conn.SetService(service.c_str());
+    conn.SetNonBlocking(true);
+    conn.SetFastOpen(bFastOpen);
+
+    auto start = std::chrono::steady_clock::now();
+    std::string resp;
+    if (!conn.Connect() || !conn.Talk(&ans, &resp) || resp.empty())
+      return false;
+    lat.push_back(SecsSince(start) * 1e6);
+
+#if defined(__linux__) && defined(TCPI_OPT_SYN_DATA)
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (i == count - 1 &&
+        getsockopt(conn.GetSockId(), IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+      bSynData = ((info.tcpi_options & TCPI_OPT_SYN_DATA) != 0);
+#endif
+    (void)conn.Disconnect();
+  }
+
+  std::sort(lat.begin(), lat.end());
+  double sum = 0;
+  for (size_t i = 0; i < lat.size(); i++)
+    sum += lat[i];
+  printf("  fast open %-3s  avg %5.1fus  p50 %5.1fus  p99 %5.1fus%s\n",
+         (bFastOpen) ? "on" : "off", sum / lat.size(), lat[lat.size() / 2],
+         lat[lat.size() * 99 / 100], (bSynData) ? "  (SYN data)" : "");
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchFastOpen
+//   Description:
+///   \brief Switchboard connects with and without TCP Fast Open
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [connections]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   The server is a fast open listener in this process that answers one
+///   line and closes. net.ipv4.tcp_fastopen needs both the client (1) and
+///   server (2) bits for the SYN to carry the ANS, without them the
+///   kernel quietly connects the ordinary way.
+//----------------------------------------------------------------------------
+///
+
+int BenchFastOpen(int argc, const char **argv) {
+  int count = (argc > 0) ? atoi(argv[0]) : 2000;
+
+  int port = 0;
+  int listenId = ListenLoopback(&port);
+  if (listenId < 0) {
+    printf("Unable to start the server\n");
+    return EXIT_FAILURE;
+  }
+#ifdef TCP_FASTOPEN
+  int qlen = 128;
+  (void)setsockopt(listenId, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen));
+#endif
+
+  std::thread server([listenId]() {
+    for (;;) {
+      int sockId = accept(listenId, 0, 0);
+      if (sockId < 0)
+        break;
+      static const char reply[] = "IRO 1 1 1 bob@example.com Bob\r\n";
+      char buf[256];
+      if (recv(sockId, buf, sizeof(buf), 0) > 0)
+        (void)send(sockId, reply, sizeof(reply) - 1, MSG_NOSIGNAL);
+      (void)close(sockId);
+    }
+  });
+
+  int mode = -1;
+  FILE *fp = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+  if (fp != 0) {
+    if (fscanf(fp, "%d", &mode) != 1)
+      mode = -1;
+    (void)fclose(fp);
+  }
+
+  printf("Connect + ANS + reply + close, %d connections", count);
+  if (mode >= 0)
+    printf(" (tcp_fastopen=%d)", mode);
+  printf(":\n");
+
+  std::string service(std::to_string(port));
+  bool bOk = RunConnects(service, false, count) &&
+             RunConnects(service, true, count);
+
+  (void)shutdown(listenId, SHUT_RDWR);
+  server.join();
+  (void)close(listenId);
+
+  if (!bOk)
+    printf("Unable to talk to the server\n");
+  return (bOk) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///
+/// Chat callbacks for BenchTransport - answer every message
+///
+bool ChatReply(std::string &, std::string &reply, int *) {
+  reply = "ok";
+  return true;
+}
+
+bool ChatSystem(const BufSlice &, std::string &, int *rc, int, void *) {
+  *rc = 0;
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   ConnectChat
+//   Description:
+///   \brief Join a chat session to a peer over a transport
+//   Parameters:
+///   @param MsnChatSessions &chat - session to connect
+///   @param NetworkOps &peer - set to the other end
+///   @param int transport - TRANSPORTTCP, TRANSPORTUNIX or TRANSPORTPAIR
+///   @param const std::string &path - socket path for TRANSPORTUNIX
+//   Return:
+///   @return bool
+//   Notes:
+///   The socket servers take one connection and hand its socket over to
+///   the peer
+//----------------------------------------------------------------------------
+///
+
+bool ConnectChat(MsnChatSessions &chat, NetworkOps &peer, int transport,
+                 const std::string &path) {
+  if (transport == TRANSPORTPAIR)
+    return NetworkOps::CreatePair(*chat.GetNetOps(), peer);
+
+  NetworkOps server;
+  std::string host("127.0.0.1"), service("0");
+  if (transport == TRANSPORTUNIX)
+    host = "unix:" + path;
+  server.SetHostName(&host);
+  server.SetService(&service);
+  server.SetNonBlocking(false);
+  if (!server.StartServer(8))
+    return false;
+
+  if (transport == TRANSPORTTCP) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(server.GetSockId(), (struct sockaddr *)&addr, &len) < 0)
+      return false;
+    service = std::to_string(ntohs(addr.sin_port));
+  }
+
+  chat.GetNetOps()->SetHostName(&host);
+  chat.GetNetOps()->SetService(&service);
+  std::thread accepter([&server]() { (void)server.AcceptSingleConnection(); });
+  bool bOk = chat.GetNetOps()->Connect();
+  accepter.join();
+
+  ///   AcceptSingleConnection leaves the accepted socket in the server
+  peer.SetSockId(server.GetSockId());
+  server.SetSockId(-1);
+  return bOk && peer.GetSockId() != -1;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunChat
+//   Description:
+///   \brief Drive a chat session over one transport
+//   Parameters:
+///   @param int transport - TRANSPORTTCP, TRANSPORTUNIX or TRANSPORTPAIR
+///   @param const char *label - what to call it
+///   @param int count - messages to send
+//   Return:
+///   @return bool
+//   Notes:
+///   The peer writes MSG frames in 16 KB batches from one thread and
+///   counts the replies from another, while this one runs ChatEvents
+//----------------------------------------------------------------------------
+///
+
+bool RunChat(int transport, const char *label, int count) {
+  std::string path("/tmp/MessengerBench." + std::to_string(getpid()) +
+                   ".sock");
+  MsnChatSessions chat;
+  chat.SetFunction(ChatReply);
+  chat.SetSystemFunction(ChatSystem);
+  NetworkOps peer;
+  if (!ConnectChat(chat, peer, transport, path)) {
+    printf("  %-6s unable to connect\n", label);
+    return false;
+  }
+  chat.GetNetOps()->SetBlock(false);
+
+  std::string body("MIME-Version: 1.0\r\n"
+                   "Content-Type: text/plain; charset=UTF-8\r\n"
+                   "X-MMS-IM-Format: FN=Arial\r\n\r\n"
+                   "hello there");
+  std::string frame("MSG bob@example.com Bob " + std::to_string(body.size()) +
+                    "\r\n" + body);
+
+  std::atomic<int> replies(0);
+  std::thread reader([&peer, &replies, count]() {
+    std::vector<BufSlice> frames;
+    while (replies < count && peer.GetFrames(MsnUtils::MSNFrameLen, frames) &&
+           !(frames.empty() && peer.IsPeerClosed()))
+      replies += (int)frames.size();
+  });
+  std::thread writer([&peer, &frame, count]() {
+    std::string batch;
+    for (int i = 0; i < count; i++) {
+      batch += frame;
+      if (batch.size() > 16384 || i == count - 1) {
+        if (!peer.SendBinMsg(&batch[0], (int)batch.size()))
+          break;
+        batch.clear();
+      }
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  while (replies < count && SecsSince(start) < 20.0 &&
+         chat.ChatEvents(EVENTREAD))
+    ;
+  double secs = SecsSince(start);
+
+  writer.join();
+  (void)shutdown(peer.GetSockId(), SHUT_RDWR);
+  reader.join();
+  printf("  %-6s transport %d  %8.0f msgs/s%s\n", label,
+         chat.GetNetOps()->GetTransport(), replies / secs,
+         (replies == count) ? "" : "  (short)");
+
+  (void)chat.GetNetOps()->Disconnect();
+  (void)peer.Disconnect();
+  if (transport == TRANSPORTUNIX)
+    (void)unlink(path.c_str());
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchTransport
+//   Description:
+///   \brief Chat message rate over each NetworkOps transport
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [messages]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   A switchboard session parses, calls back and replies to each MSG,
+///   so this shows what the transport adds to that. The pair needs no
+///   network at all.
+//----------------------------------------------------------------------------
+///
+
+int BenchTransport(int argc, const char **argv) {
+  int count = (argc > 0) ? atoi(argv[0]) : 50000;
+
+  printf("MSG frames through MsnChatSessions, %d messages:\n", count);
+  bool bOk = RunChat(TRANSPORTPAIR, "pair", count) &&
+             RunChat(TRANSPORTUNIX, "unix", count) &&
+             RunChat(TRANSPORTTCP, "tcp", count);
+  return (bOk) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///
+/// View callback for BenchSlices - answers without copying the text
+///
+bool ChatViewReply(const BufSlice &, std::string &reply, int *rc) {
+  *rc = 0;
+  reply = "ok";
+  return true;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunSlices
+//   Description:
+///   \brief Count what handing chat text to a callback costs
+//   Parameters:
+///   @param bool bView - use a view callback rather than a string one
+///   @param int count - messages, sent ten to a batch
+//   Return:
+///   @return bool
+//   Notes:
+///   Only ChatEvents is counted, the peer's writes and reads are not
+//----------------------------------------------------------------------------
+///
+
+bool RunSlices(bool bView, int count) {
+  MsnChatSessions chat;
+  NetworkOps peer;
+  if (!NetworkOps::CreatePair(*chat.GetNetOps(), peer))
+    return false;
+  chat.GetNetOps()->SetNonBlocking(true);
+  chat.SetSystemFunction(ChatSystem);
+  if (bView)
+    chat.SetViewFunction(ChatViewReply);
+  else
+    chat.SetFunction(ChatReply);
+
+  std::string body("MIME-Version: 1.0\r\n"
+                   "Content-Type: text/plain; charset=UTF-8\r\n"
+                   "X-MMS-IM-Format: FN=Arial; EF=; CO=0; CS=0; PF=22\r\n"
+                   "\r\n"
+                   "Hello there, this is a chat message of moderate length");
+  std::string frame("MSG bob@example.com Bob " + std::to_string(body.size()) +
+                    "\r\n" + body);
+  std::string batch;
+  for (int i = 0; i < 10; i++)
+    batch += frame;
+
+  BufSlice::ResetStats();
+  long allocs = 0;
+  int done = 0;
+  std::vector<char> sink(65536);
+  for (; done < count; done += 10) {
+    if (write(peer.GetSockId(), batch.data(), batch.size()) !=
+        (ssize_t)batch.size())
+      break;
+    CountAllocs(true);
+    (void)chat.ChatEvents(EVENTREAD);
+    allocs += CountAllocs(false);
+    while (recv(peer.GetSockId(), &sink[0], sink.size(), MSG_DONTWAIT) > 0)
+      ;
+  }
+
+  printf("  %-6s callback", (bView) ? "view" : "string");
+  if (allocs >= 0 && done > 0)
+    printf("  %5.1f allocs/msg", (double)allocs / done);
+  printf("  %lu chunks  %lu copies  %llu bytes copied\n", BufSlice::GetAllocs(),
+         BufSlice::GetCopies(), BufSlice::GetCopyBytes());
+
+  (void)chat.GetNetOps()->Disconnect();
+  (void)peer.Disconnect();
+  return done >= count;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchSlices
+//   Description:
+///   \brief Allocations and copies per received chat message
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [messages]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   Each batch of frames should cost one chunk, and a view callback
+///   should see no copies of the text, only of the short header lines
+//----------------------------------------------------------------------------
+///
+
+int BenchSlices(int argc, const char **argv) {
+  int count = (argc > 0) ? atoi(argv[0]) : 1000;
+
+  printf("MSG frames over a pair, %d messages in batches of 10:\n", count);
+  bool bOk = RunSlices(false, count) && RunSlices(true, count);
+  if (!bOk)
+    printf("Unable to deliver the messages\n");
+  return (bOk) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   WriteSelfSigned
+//   Description:
+///   \brief Write a throwaway key and certificate for TLS
+//   Parameters:
+///   @param const std::string &chainFile - gets the certificate and key
+///   @param const std::string &caFile - gets the certificate alone
+//   Return:
+///   @return bool
+//   Notes:
+///   NetworkOpsSSL reads both from its chain file and wants a CA list,
+///   so a self-signed certificate serves as all three
+//----------------------------------------------------------------------------
+///
+
+bool WriteSelfSigned(const std::string &chainFile, const std::string &caFile) {
+  EVP_PKEY *key = 0;
+  EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, 0);
+  if (kctx == 0 || EVP_PKEY_keygen_init(kctx) <= 0 ||
+      EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1) <=
+          0 ||
+      EVP_PKEY_keygen(kctx, &key) <= 0) {
+    EVP_PKEY_CTX_free(kctx);
+    return false;
+  }
+  EVP_PKEY_CTX_free(kctx);
+
+  X509 *cert = X509_new();
+  X509_NAME *name = X509_get_subject_name(cert);
+  (void)X509_set_version(cert, 2);
+  (void)ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  (void)X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  (void)X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+  (void)X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   (const unsigned char *)"localhost", -1, -1,
+                                   0);
+  (void)X509_set_issuer_name(cert, name);
+  bool bOk = (X509_set_pubkey(cert, key) && X509_sign(cert, key, EVP_sha256()));
+
+  FILE *fp = (bOk) ? fopen(chainFile.c_str(), "w") : 0;
+  bOk = (fp != 0 && PEM_write_X509(fp, cert) &&
+         PEM_write_PrivateKey(fp, key, 0, 0, 0, 0, 0));
+  if (fp != 0)
+    (void)fclose(fp);
+  fp = (bOk) ? fopen(caFile.c_str(), "w") : 0;
+  bOk = (fp != 0 && PEM_write_X509(fp, cert));
+  if (fp != 0)
+    (void)fclose(fp);
+
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   RunTlsSend
+//   Description:
+///   \brief Send a file over TLS to a sink and report the rate
+//   Parameters:
+///   @param int fileNo - the file
+///   @param long long length - its size
+///   @param const std::string &chainFile - certificate and key
+///   @param bool bKtls - ask for kernel TLS
+//   Return:
+///   @return bool
+//   Notes:
+///   The sink is a plain OpenSSL server in a thread, reading until the
+///   client closes
+//----------------------------------------------------------------------------
+///
+
+bool RunTlsSend(int fileNo, long long length, const std::string &chainFile,
+                bool bKtls) {
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  if (ctx == 0 ||
+      SSL_CTX_use_certificate_chain_file(ctx, chainFile.c_str()) <= 0 ||
+      SSL_CTX_use_PrivateKey_file(ctx, chainFile.c_str(), SSL_FILETYPE_PEM) <=
+          0) {
+    SSL_CTX_free(ctx);
+    return false;
+  }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  ///   The client only writes, so session tickets would sit unread and its
+  ///   close would reset the connection, losing the tail of the file
+  (void)SSL_CTX_set_num_tickets(ctx, 0);
+#endif
+
+  int port = 0;
+  int listenId = ListenLoopback(&port);
+  if (listenId < 0) {
+    SSL_CTX_free(ctx);
+    return false;
+  }
+
+  long long received = 0;
+  std::thread sink([ctx, listenId, &received]() {
+    int sockId = accept(listenId, 0, 0);
+    if (sockId < 0)
+      return;
+    SSL *ssl = SSL_new(ctx);
+    (void)SSL_set_fd(ssl, sockId);
+    if (SSL_accept(ssl) > 0) {
+      std::vector<char> buf(1 << 16);
+      int num;
+      while ((num = SSL_read(ssl, &buf[0], (int)buf.size())) > 0)
+        received += num;
+    }
+    SSL_free(ssl);
+    (void)close(sockId);
+  });
+
+  std::string hostPort("127.0.0.1:" + std::to_string(port)), passwd;
+  NetworkOpsSSL conn(hostPort.c_str());
+  conn.SetKtls(bKtls);
+  bool bOk = conn.Connect(&chainFile, &passwd);
+  if (!bOk)
+    printf("  %s\n", conn.GetError()->c_str());
+  else {
+    auto start = std::chrono::steady_clock::now();
+    long long sent = conn.SendFile(fileNo, 0, length);
+    bool bSend = conn.IsKtlsSend();
+    (void)conn.Disconnect();
+    double secs = SecsSince(start);
+    sink.join();
+
+    printf("  kTLS %-3s  %6.0f MB/s  kernel send %s%s\n",
+           (bKtls) ? "on" : "off", length / secs / 1e6, (bSend) ? "yes" : "no",
+           (sent == length && received == length) ? "" : "  (short)");
+  }
+
+  if (sink.joinable()) {
+    (void)shutdown(listenId, SHUT_RDWR);
+    sink.join();
+  }
+  (void)close(listenId);
+  SSL_CTX_free(ctx);
+  return bOk;
+}
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   BenchTls
+//   Description:
+///   \brief TLS file sending with and without kernel TLS
+//   Parameters:
+///   @param int argc - arguments after the benchmark name
+///   @param const char **argv - [megabytes]
+//   Return:
+///   @return int - exit status
+//   Notes:
+///   Runs in a scratch directory, as NetworkOpsSSL reads its CA list from
+///   the working directory. Kernel TLS needs the tls module, without it
+///   both runs take the user space path and "kernel send" says no.
+//----------------------------------------------------------------------------
+///
+
+int BenchTls(int argc, const char **argv) {
+  long long length = ((argc > 0) ? atoll(argv[0]) : 64) << 20;
+
+  char dir[] = "/tmp/MessengerBenchXXXXXX";
+  char cwd[4096];
+  if (mkdtemp(dir) == 0 || getcwd(cwd, sizeof(cwd)) == 0 || chdir(dir) < 0) {
+    printf("Unable to set up a scratch directory\n");
+    return EXIT_FAILURE;
+  }
+
+  std::string chainFile(std::string(dir) + "/bench.pem");
+  std::string caFile(std::string(dir) + "/" + CAROOTFILE);
+  int fileNo = -1;
+  bool bOk = WriteSelfSigned(chainFile, caFile);
+  if (bOk)
+    bOk = ((fileNo = MakeFile(length)) >= 0);
+
+  if (!bOk)
+    printf("Unable to write the certificate or the file to send\n");
+  else {
+    printf("%lld MB file over TLS on loopback:\n", length >> 20);
+    bOk = RunTlsSend(fileNo, length, chainFile, false) &&
+          RunTlsSend(fileNo, length, chainFile, true);
+    (void)close(fileNo);
+  }
+
+  (void)unlink(chainFile.c_str());
+  (void)unlink(caFile.c_str());
+  (void)chdir(cwd);
+  (void)rmdir(dir);
+  return (bOk) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///
+/// The benchmarks, by name
+///
+struct BenchCmd {
+  const char *name;
+  int (*func)(int, const char **);
+  const char *args;
+  const char *desc;
+};
+
+const BenchCmd benchCmds[] = {
+    {"contend", BenchContend, "[max sessions] [reply delay ms]",
+     "Talk round trips as sessions are added"},
+    {"recv", BenchRecv, "[message bytes] [count]",
+     "GetBinMsg throughput and allocations per read"},
+    {"sendfile", BenchSendFile, "[megabytes] [packet bytes]",
+     "MSNFTP file sending, packet loop against SendFile"},
+    {"uring", BenchUring, "[connections] [messages each]",
+     "Event loop backends, system calls and latency per message"},
+    {"fastopen", BenchFastOpen, "[connections]",
+     "Switchboard style connects with and without TCP Fast Open"},
+    {"transport", BenchTransport, "[messages]",
+     "Chat message rate over TCP, Unix socket and in-process pair"},
+    {"slices", BenchSlices, "[messages]",
+     "Allocations and copies handing chat text to callbacks"},
+    {"tls", BenchTls, "[megabytes]",
+     "TLS file sending with and without kernel TLS"},
+};
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   Usage
+//   Description:
+///   \brief List the benchmarks
+//   Parameters:
+///   @param const char *prog - program name
+//   Return:
+///   @return void
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+void Usage(const char *prog) {
+  printf("Usage: %s <benchmark> [args]\n\n", prog);
+  for (size_t i = 0; i < sizeof(benchCmds) / sizeof(benchCmds[0]); i++)
+    printf("  %-9s %s\n  %9s %s\n", benchCmds[i].name, benchCmds[i].args, "",
+           benchCmds[i].desc);
+  return;
+}
+
+} // namespace
+
+///
+//----------------------------------------------------------------------------
+//   FUNCTION SPECIFICATION
+//   Name:
+///   main
+//   Description:
+///   \brief Run the benchmark named on the command line
+//   Parameters:
+///   @param const int argc - arguments
+///   @param const char **argv - arguments to process
+//   Return:
+///   @return int - exit status
+//   Notes:
+//----------------------------------------------------------------------------
+///
+
+int main(const int argc, const char **argv) {
+#ifdef SIGPIPE
+  (void)signal(SIGPIPE, SIG_IGN);
+#endif ///    SIGPIPE///
+
+  if (argc > 1) {
+    for (size_t i = 0; i < sizeof(benchCmds) / sizeof(benchCmds[0]); i++) {
+      if (!strcasecmp(argv[1], benchCmds[i].name))
+        return benchCmds[i].func(argc - 2, argv + 2);
+    }
+  }
+
+  Usage(argv[0]);
+  return EXIT_FAILURE;
+}
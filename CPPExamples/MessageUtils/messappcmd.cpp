@@ -97,6 +97,9 @@ void initSignalHandlers() {
 #ifdef SIGXFSZ
   (void)signal(SIGXFSZ, signalHandler);
 #endif ///    SIGXFSZ///
+#ifdef SIGPIPE
+  (void)signal(SIGPIPE, SIG_IGN);
+#endif ///    SIGPIPE - sendfile has no MSG_NOSIGNAL///
 #ifdef SIGALRM
   (void)signal(SIGALRM, SIG_IGN);
 #endif ///    SIGALRM///